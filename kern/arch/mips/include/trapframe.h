@@ -104,5 +104,17 @@ __DEAD void mips_usermode(struct trapframe *tf);
 extern vaddr_t cpustacks[];
 extern vaddr_t cputhreads[];
 
+/*
+ * Per-cpu state used by the user TLB refill handler. The layout is
+ * known to exception-mips1.S.
+ */
+struct cputlb {
+	vaddr_t ct_pagetable;		/* page directory to walk, or 0 */
+	uint32_t ct_misses;		/* user TLB misses taken */
+	uint32_t ct_faults;		/* entries loaded by vm_fault */
+	uint32_t ct_pid;		/* address space ID in use */
+};
+extern struct cputlb cputlbs[];
+
 
 #endif /* _MIPS_TRAPFRAME_H_ */
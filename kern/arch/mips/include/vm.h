@@ -68,6 +68,17 @@
 #define PADDR_TO_KVADDR(paddr) ((paddr)+MIPS_KSEG0)
 #define KVADDR_TO_PADDR(vaddr) ((vaddr)-MIPS_KSEG0)
 
+/*
+ * The kernel virtual-address arena. Large kernel allocations are
+ * backed by individual (not necessarily contiguous) physical frames
+ * that are mapped through the TLB at addresses in this range of
+ * kseg2. See arch/mips/vm/kva.c.
+ */
+#define KVA_ARENA_BASE   MIPS_KSEG2
+#define KVA_ARENA_SIZE   (16*1024*1024)
+#define KVA_ARENA_TOP    (KVA_ARENA_BASE + KVA_ARENA_SIZE)
+#define KVA_OWNS(vaddr)  ((vaddr) >= KVA_ARENA_BASE && (vaddr) < KVA_ARENA_TOP)
+
 /*
  * The top of user space. (Actually, the address immediately above the
  * last valid user address.)
@@ -118,10 +129,9 @@ paddr_t ram_getfirstfree(void);
  */
 
 struct tlbshootdown {
-	/*
-	 * Change this to what you need for your VM design.
-	 */
-	int ts_placeholder;
+	vaddr_t ts_vaddr;		/* first page to invalidate */
+	unsigned ts_npages;		/* number of pages */
+	uint32_t ts_pid;		/* address space ID (user pages) */
 };
 
 #define TLBSHOOTDOWN_MAX 16
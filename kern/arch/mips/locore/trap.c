@@ -28,6 +28,7 @@
  */
 
 #include <types.h>
+#include <kern/wait.h>
 #include <signal.h>
 #include <lib.h>
 #include <mips/specialreg.h>
@@ -36,6 +37,7 @@
 #include <spl.h>
 #include <thread.h>
 #include <current.h>
+#include <proc.h>
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
@@ -108,13 +110,11 @@ kill_curthread(vaddr_t epc, unsigned code, vaddr_t vaddr)
 		break;
 	}
 
-	/*
-	 * You will probably want to change this.
-	 */
-
 	kprintf("Fatal user mode trap %u sig %d (%s, epc 0x%x, vaddr 0x%x)\n",
 		code, sig, trapcodenames[code], epc, vaddr);
-	panic("I don't know how to handle this\n");
+
+	/* There are no signal handlers, so the signal kills the process. */
+	proc_exit(_MKWAIT_SIG(sig));
 }
 
 /*
@@ -195,6 +195,14 @@ mips_trap(struct trapframe *tf)
 		}
 
 		curthread->t_in_interrupt = old_in;
+
+		/*
+		 * The timer is how a thread that never traps otherwise
+		 * finds out it should exit; see proc_singlethread.
+		 */
+		if (!iskern) {
+			proc_checkkilled();
+		}
 		goto done2;
 	}
 
@@ -315,6 +323,14 @@ mips_trap(struct trapframe *tf)
 	panic("I can't handle this... I think I'll just die now...\n");
 
  done:
+	/*
+	 * If another thread is exiting or execing the process, this
+	 * one goes away instead of going back to user mode.
+	 */
+	if (!iskern) {
+		proc_checkkilled();
+	}
+
 	/*
 	 * Turn interrupts off on the processor, without affecting the
 	 * stored interrupt state.
@@ -363,6 +379,7 @@ mips_trap(struct trapframe *tf)
  * following places:
  *    - enter_new_process, for use by exec and equivalent.
  *    - enter_forked_process, in syscall.c, for use by fork.
+ *    - enter_new_thread, in syscall.c, for a new user thread.
  */
 void
 mips_usermode(struct trapframe *tf)
@@ -31,12 +31,36 @@
 #include <kern/errno.h>
 #include <kern/syscall.h>
 #include <lib.h>
+#include <cpu.h>
+#include <copyinout.h>
 #include <mips/trapframe.h>
 #include <thread.h>
 #include <current.h>
 #include <syscall.h>
+#include <syscalltab.h>
 
 
+/*
+ * Fetch the first NWORDS argument words: a0-a3, and then the rest
+ * from the user stack.
+ */
+static
+int
+syscall_getargs(struct trapframe *tf, unsigned nwords, uint32_t *args)
+{
+	KASSERT(nwords <= SYSCALL_MAXWORDS);
+
+	args[0] = tf->tf_a0;
+	args[1] = tf->tf_a1;
+	args[2] = tf->tf_a2;
+	args[3] = tf->tf_a3;
+	if (nwords <= 4) {
+		return 0;
+	}
+	return copyin((const_userptr_t)(tf->tf_sp + 16), &args[4],
+		      (nwords - 4) * sizeof(args[0]));
+}
+
 /*
  * System call dispatcher.
  *
@@ -78,8 +102,11 @@
 void
 syscall(struct trapframe *tf)
 {
+	struct syscallent *sc;
+	uint32_t args[SYSCALL_MAXWORDS];
+	uint32_t start;
 	int callno;
-	int32_t retval;
+	int64_t retval;
 	int err;
 
 	KASSERT(curthread != NULL);
@@ -99,22 +126,26 @@ syscall(struct trapframe *tf)
 
 	retval = 0;
 
-	switch (callno) {
-	    case SYS_reboot:
-		err = sys_reboot(tf->tf_a0);
-		break;
-
-	    case SYS___time:
-		err = sys___time((userptr_t)tf->tf_a0,
-				 (userptr_t)tf->tf_a1);
-		break;
-
-	    /* Add stuff here */
-
-	    default:
+	/*
+	 * The calls are in the table generated from <syscall.h>; see
+	 * syscalltab.h. This is the one place every call goes through,
+	 * so it's where they're counted, timed, and traced.
+	 */
+	if (callno < 0 || (unsigned)callno >= syscalltab_size ||
+	    syscalltab[callno].sc_func == NULL) {
 		kprintf("Unknown syscall %d\n", callno);
+		sc = NULL;
 		err = ENOSYS;
-		break;
+	}
+	else {
+		sc = &syscalltab[callno];
+		err = syscall_getargs(tf, sc->sc_nwords, args);
+		if (err == 0) {
+			syscall_enter(sc, args);
+			start = cpu_cycles();
+			err = sc->sc_func(tf, args, &retval);
+			syscall_leave(sc, cpu_cycles() - start, err, retval);
+		}
 	}
 
 
@@ -127,9 +158,15 @@ syscall(struct trapframe *tf)
 		tf->tf_v0 = err;
 		tf->tf_a3 = 1;      /* signal an error */
 	}
+	else if (sc->sc_retsize == 64) {
+		/* Success; the high half goes in v0, the low in v1. */
+		tf->tf_v0 = (uint32_t)(retval >> 32);
+		tf->tf_v1 = (uint32_t)retval;
+		tf->tf_a3 = 0;      /* signal no error */
+	}
 	else {
 		/* Success. */
-		tf->tf_v0 = retval;
+		tf->tf_v0 = (int32_t)retval;
 		tf->tf_a3 = 0;      /* signal no error */
 	}
 
@@ -149,13 +186,46 @@ syscall(struct trapframe *tf)
 /*
  * Enter user mode for a newly forked process.
  *
- * This function is provided as a reminder. You need to write
- * both it and the code that calls it.
- *
- * Thus, you can trash it and do things another way if you prefer.
+ * TF is a kmalloc'd copy of the parent's trapframe from sys_fork.
+ * mips_usermode needs the trapframe on our own stack, so copy it
+ * there and free the original; then make fork return 0 in the child.
  */
 void
 enter_forked_process(struct trapframe *tf)
 {
-	(void)tf;
+	struct trapframe mytf;
+
+	mytf = *tf;
+	kfree(tf);
+
+	mytf.tf_v0 = 0;		/* child's return value */
+	mytf.tf_a3 = 0;		/* signal no error */
+	mytf.tf_epc += 4;	/* skip the syscall instruction */
+
+	mips_usermode(&mytf);
+}
+
+/*
+ * Enter user mode in a new thread of the current process.
+ *
+ * TF is a kmalloc'd copy of the creating thread's trapframe from
+ * sys___thread_create, so the new thread gets the same global
+ * pointer and status; it starts at ENTRY with ARG as its argument
+ * and STACK as its stack pointer.
+ */
+void
+enter_new_thread(struct trapframe *tf, userptr_t arg, vaddr_t stack,
+		 vaddr_t entry)
+{
+	struct trapframe mytf;
+
+	mytf = *tf;
+	kfree(tf);
+
+	mytf.tf_epc = entry;
+	mytf.tf_a0 = (vaddr_t)arg;
+	mytf.tf_sp = stack;
+	mytf.tf_ra = 0;		/* returning from ENTRY is a fault */
+
+	mips_usermode(&mytf);
 }
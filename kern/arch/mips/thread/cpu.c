@@ -67,6 +67,13 @@
 vaddr_t cpustacks[MAXCPUS];
 vaddr_t cputhreads[MAXCPUS];
 
+/*
+ * State for the fast-path TLB refill in exception-mips1.S, indexed
+ * the same way. The page table is maintained by the VM system; 0
+ * sends every refill to vm_fault.
+ */
+struct cputlb cputlbs[MAXCPUS];
+
 /*
  * Do machine-dependent initialization of the cpu structure or things
  * associated with a new cpu. Note that we're not running on the new
@@ -246,6 +253,25 @@ cpu_irqonoff(void)
         SET_STATUS(xoff);
 }
 
+/*
+ * Read the cycle counter. (It's a MIPS32 register, but System/161
+ * has it; the timer interrupt is driven off it too.)
+ */
+uint32_t
+cpu_cycles(void)
+{
+	uint32_t count;
+
+	/* $9 == c0_count */
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $9;"		/* do it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (count));
+	return count;
+}
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -29,6 +29,8 @@
 #include <opt-unsw.h>
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
 #include <lib.h>
 #include <spl.h>
 #include <cpu.h>
@@ -149,11 +151,51 @@ free_kpages(vaddr_t addr)
 
 #endif
 
+void
+vm_tlbshootdown_all(void)
+{
+	int i, spl;
+
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	splx(spl);
+}
+
 void
 vm_tlbshootdown(const struct tlbshootdown *ts)
 {
-	(void)ts;
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	/* The only shootdowns dumbvm sees are for the kva arena. */
+	kva_tlbshootdown(ts);
+}
+
+void
+vm_printstats(void)
+{
+	/* dumbvm keeps no statistics. */
+}
+
+void
+vm_sample(struct vmsample *vs)
+{
+	/* Nor rates. */
+	vs->vs_misses = vs->vs_faults = 0;
+	vs->vs_when.tv_sec = 0;
+	vs->vs_when.tv_nsec = 0;
+}
+
+void
+vm_printrates(const struct vmsample *since)
+{
+	(void)since;
+}
+
+void
+vm_filechanged(struct vnode *v)
+{
+	/* No page cache, so nothing to forget. */
+	(void)v;
 }
 
 int
@@ -170,6 +212,14 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 
 	DEBUG(DB_VM, "dumbvm: fault: 0x%x\n", faultaddress);
 
+	if (KVA_OWNS(faultaddress)) {
+		/* Large kernel allocation, mapped through kseg2. */
+		if (faulttype == VM_FAULT_READONLY) {
+			return EFAULT;
+		}
+		return kva_fault(faultaddress);
+	}
+
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
 		/* We always create pages read-write, so we can't get this */
@@ -252,9 +302,12 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		return 0;
 	}
 
-	kprintf("dumbvm: Ran out of TLB entries - cannot handle page fault\n");
+	/* No free slot; replace a random one. */
+	ehi = faultaddress;
+	elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+	tlb_random(ehi, elo);
 	splx(spl);
-	return EFAULT;
+	return 0;
 }
 
 struct addrspace *
@@ -440,3 +493,12 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	*ret = new;
 	return 0;
 }
+
+void
+as_getusage(struct addrspace *as, struct rusage *ru)
+{
+	/* Everything is in core from the start, and nothing faults. */
+	ru->ru_rss = (as->as_npages1 + as->as_npages2 + DUMBVM_STACKPAGES)
+		* (PAGE_SIZE / 1024);
+	ru->ru_maxrss = ru->ru_rss;
+}
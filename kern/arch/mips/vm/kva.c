@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <mips/tlb.h>
+#include <vm.h>
+
+/*
+ * Kernel virtual-address arena.
+ *
+ * kmalloc hands large requests to alloc_kpages, which needs that
+ * many physically contiguous frames. Once physical memory gets
+ * fragmented those requests fail even though plenty of single frames
+ * are free. Instead, large allocations can come from here: we hand
+ * out a contiguous range of kseg2 virtual addresses and back each
+ * page of it with whatever single frame alloc_kpages(1) gives us.
+ * The mappings are loaded into the TLB on demand by kva_fault(),
+ * which vm_fault() calls for faults in the arena.
+ *
+ * The arena's page table is a flat array with one TLB entrylo value
+ * per page. It is statically allocated so it lives in kseg0 and can
+ * be read by the fault handler without faulting itself. The fault
+ * handler does not take kva_lock; an entry is always written before
+ * the address it maps is handed out, and is not cleared until after
+ * the address has been given back.
+ *
+ * Two software bits live in the low byte of each entry, which is
+ * unused by the TLB; they are masked off before the entry is loaded.
+ * KVA_RESERVED marks a page as allocated (possibly before its frame
+ * is), and KVA_NOTLAST marks every page of an allocation but the
+ * last, so kva_free can find the end.
+ *
+ * Address ranges are allocated next-fit from a rotating hint. Other
+ * CPUs may have the pages of a range in their TLBs, as the entries
+ * are global, so kva_release shoots them down and waits until every
+ * CPU has dropped them before freeing the frames or the range;
+ * otherwise a CPU could go on using a frame after it was handed to
+ * someone else.
+ */
+
+#define KVA_NPAGES	(KVA_ARENA_SIZE / PAGE_SIZE)
+
+#define KVA_RESERVED	0x00000001
+#define KVA_NOTLAST	0x00000002
+#define KVA_SWBITS	0x000000ff
+
+static uint32_t kva_ptes[KVA_NPAGES];
+static unsigned kva_hint;		/* next page to try */
+static unsigned kva_inuse;		/* pages currently allocated */
+static struct spinlock kva_lock = SPINLOCK_INITIALIZER;
+
+#define KVA_INDEX(va)	(((va) - KVA_ARENA_BASE) / PAGE_SIZE)
+#define KVA_VADDR(i)	(KVA_ARENA_BASE + (vaddr_t)(i) * PAGE_SIZE)
+
+/*
+ * Find and reserve NPAGES consecutive free pages. Returns the index
+ * of the first one, or KVA_NPAGES if there is no such run.
+ */
+static
+unsigned
+kva_reserve(unsigned npages)
+{
+	unsigned start, run, i, tries;
+
+	spinlock_acquire(&kva_lock);
+
+	start = kva_hint;
+	run = 0;
+	for (tries = 0; tries < KVA_NPAGES + npages; tries++) {
+		i = start + run;
+		if (i >= KVA_NPAGES) {
+			/* runs may not wrap; start over at the bottom */
+			start = 0;
+			run = 0;
+			continue;
+		}
+		if (kva_ptes[i] != 0) {
+			start = i + 1;
+			run = 0;
+			continue;
+		}
+		run++;
+		if (run == npages) {
+			for (i = start; i < start + npages - 1; i++) {
+				kva_ptes[i] = KVA_RESERVED | KVA_NOTLAST;
+			}
+			kva_ptes[i] = KVA_RESERVED;
+			kva_hint = (start + npages) % KVA_NPAGES;
+			kva_inuse += npages;
+			spinlock_release(&kva_lock);
+			return start;
+		}
+	}
+
+	spinlock_release(&kva_lock);
+	return KVA_NPAGES;
+}
+
+/*
+ * Flush the TLB entries for a range of the arena on this CPU.
+ */
+static
+void
+kva_tlbflush(vaddr_t va, unsigned npages)
+{
+	unsigned i;
+	int index, spl;
+
+	spl = splhigh();
+	for (i = 0; i < npages; i++) {
+		index = tlb_probe(va + i * PAGE_SIZE, 0);
+		if (index >= 0) {
+			tlb_write(TLBHI_INVALID(index), TLBLO_INVALID(),
+				  index);
+		}
+	}
+	splx(spl);
+}
+
+/*
+ * Release the frames backing pages FIRST..FIRST+NPAGES-1 and return
+ * the pages to the free pool.
+ */
+static
+void
+kva_release(unsigned first, unsigned npages)
+{
+	struct tlbshootdown ts;
+	paddr_t paddr;
+	unsigned i;
+
+	ts.ts_vaddr = KVA_VADDR(first);
+	ts.ts_npages = npages;
+	ts.ts_pid = 0;		/* arena entries are global */
+	kva_tlbflush(ts.ts_vaddr, npages);
+	ipi_tlbshootdown_broadcast(&ts);
+	ipi_tlbshootdown_wait();
+
+	for (i = first; i < first + npages; i++) {
+		paddr = kva_ptes[i] & TLBLO_PPAGE;
+		if (paddr != 0) {
+			free_kpages(PADDR_TO_KVADDR(paddr));
+		}
+	}
+
+	spinlock_acquire(&kva_lock);
+	for (i = first; i < first + npages; i++) {
+		kva_ptes[i] = 0;
+	}
+	kva_inuse -= npages;
+	spinlock_release(&kva_lock);
+}
+
+/*
+ * Allocate NPAGES pages of kernel virtual memory in the arena. The
+ * pages are virtually contiguous but the frames behind them need
+ * not be. Returns 0 if either address space or memory runs out.
+ */
+vaddr_t
+kva_alloc(unsigned npages)
+{
+	unsigned first, i;
+	vaddr_t frame;
+
+	KASSERT(npages > 0);
+
+	first = kva_reserve(npages);
+	if (first == KVA_NPAGES) {
+		return 0;
+	}
+
+	/*
+	 * Get the frames without holding kva_lock, in case
+	 * alloc_kpages needs to wait or comes back to kmalloc.
+	 */
+	for (i = first; i < first + npages; i++) {
+		frame = alloc_kpages(1);
+		if (frame == 0) {
+			kva_release(first, npages);
+			return 0;
+		}
+		kva_ptes[i] |= KVADDR_TO_PADDR(frame) |
+			TLBLO_DIRTY | TLBLO_VALID | TLBLO_GLOBAL;
+	}
+
+	return KVA_VADDR(first);
+}
+
+/*
+ * Free an allocation made by kva_alloc.
+ */
+void
+kva_free(vaddr_t addr)
+{
+	unsigned first, i;
+
+	KASSERT(KVA_OWNS(addr));
+	KASSERT(addr % PAGE_SIZE == 0);
+
+	first = KVA_INDEX(addr);
+	KASSERT(kva_ptes[first] & KVA_RESERVED);
+	if (first > 0 && (kva_ptes[first - 1] & KVA_NOTLAST)) {
+		panic("kva_free: 0x%x is not the start of an allocation\n",
+		      addr);
+	}
+
+	for (i = first; kva_ptes[i] & KVA_NOTLAST; i++) {
+		KASSERT(i + 1 < KVA_NPAGES);
+	}
+	kva_release(first, i - first + 1);
+}
+
+/*
+ * Handle a TLB miss on an arena address by loading the mapping.
+ * Returns EFAULT if the address is not allocated.
+ */
+int
+kva_fault(vaddr_t faultaddress)
+{
+	uint32_t elo;
+	int spl;
+
+	KASSERT(KVA_OWNS(faultaddress));
+
+	elo = kva_ptes[KVA_INDEX(faultaddress)];
+	if ((elo & TLBLO_VALID) == 0) {
+		return EFAULT;
+	}
+
+	spl = splhigh();
+	tlb_random(faultaddress & PAGE_FRAME, elo & ~(uint32_t)KVA_SWBITS);
+	splx(spl);
+	return 0;
+}
+
+/*
+ * Handle the arena's part of a TLB shootdown request.
+ */
+void
+kva_tlbshootdown(const struct tlbshootdown *ts)
+{
+	KASSERT(KVA_OWNS(ts->ts_vaddr));
+	kva_tlbflush(ts->ts_vaddr, ts->ts_npages);
+}
+
+/*
+ * Print arena usage; called from kheap_printstats.
+ */
+void
+kva_printstats(void)
+{
+	unsigned inuse;
+
+	spinlock_acquire(&kva_lock);
+	inuse = kva_inuse;
+	spinlock_release(&kva_lock);
+
+	kprintf("kva arena: %u/%u pages in use\n", inuse, KVA_NPAGES);
+}
@@ -43,12 +43,30 @@ static paddr_t lastpaddr;   /* one past end of last free physical page */
 typedef struct ft_entry {
         unsigned allocated:1; /* the corresponding frame is allocated */
         unsigned not_last:1; /* the frame is part of a multiframe allocation */
+        unsigned refcount:30; /* references to a single frame; see frame_incref */
+        struct addrspace *as; /* owner of a pageable user page; see frame_setowner */
+        vaddr_t vaddr;        /* where the owner maps it */
+        struct addrspace *as2; /* another mapper of a shared page */
+        vaddr_t vaddr2;       /* where that one maps it */
+        unsigned swapslot;    /* swap slot holding a clean copy, or SWAP_NOSLOT */
 } ft_entry_t;
 
 
 static ft_entry_t * frame_table = NULL; /* base of frame table */
 static uint32_t first_frame;
 static uint32_t last_frame;
+static uint32_t free_frames_count; /* unallocated frames; see frame_nfree */
+static uint32_t clock_hand;        /* next frame frame_nextvictim looks at */
+
+/*
+ * Pool of free frames that have already been zeroed; see
+ * frame_prezero. Frames in the pool are marked allocated, so the
+ * table scans skip them, but they count as free.
+ */
+static paddr_t zero_pool[ZERO_POOL_SIZE];
+static unsigned zero_pool_count;
+static unsigned zero_pool_hits;    /* alloc_zeroed_kpage served from pool */
+static unsigned zero_pool_misses;  /* ...and zeroed on the spot */
 
 #define PAGE_BITS 12
 #define TRUE 1
@@ -141,6 +159,8 @@ ram_bootstrap(void)
         for (i = first_frame; i < (lastpaddr >> PAGE_BITS); i++) {
                 frame_table[i].allocated = FALSE;
         }
+        free_frames_count = last_frame - first_frame;
+        clock_hand = first_frame;
 
         
 }
@@ -212,6 +232,13 @@ static paddr_t alloc_one_frame(unsigned int npages)
                 if (frame_table[i].allocated == FALSE) {
                         frame_table[i].allocated = TRUE;
                         frame_table[i].not_last = FALSE;
+                        frame_table[i].refcount = 1;
+                        frame_table[i].as = NULL;
+                        frame_table[i].vaddr = 0;
+                        frame_table[i].as2 = NULL;
+                        frame_table[i].vaddr2 = 0;
+                        frame_table[i].swapslot = SWAP_NOSLOT;
+                        free_frames_count--;
 
                         spinlock_release(&frame_table_spinlock);
 
@@ -257,6 +284,7 @@ static paddr_t alloc_multiple_frames(unsigned int npages)
                 }
                 frame_table[j].allocated = TRUE;
                 frame_table[j].not_last = FALSE;
+                free_frames_count -= npages;
 
                 spinlock_release(&frame_table_spinlock);
                 
@@ -269,6 +297,39 @@ static paddr_t alloc_multiple_frames(unsigned int npages)
         return (paddr_t) 0;
 }
 
+/*
+ * Take a frame out of the zero pool, or return 0 if it's empty. The
+ * frame comes back set up as alloc_one_frame would leave it. Call
+ * with the frame table lock held.
+ */
+static paddr_t zero_pool_take(void)
+{
+        paddr_t paddr;
+
+        if (zero_pool_count == 0) {
+                return (paddr_t) 0;
+        }
+        paddr = zero_pool[--zero_pool_count];
+        KASSERT(frame_table[paddr >> PAGE_BITS].allocated == TRUE);
+        return paddr;
+}
+
+/*
+ * Give every frame in the zero pool back to the table, so that
+ * multiframe allocations can use them. Call with the frame table
+ * lock held.
+ */
+static void zero_pool_drain(void)
+{
+        uint32_t i;
+
+        while (zero_pool_count > 0) {
+                i = zero_pool[--zero_pool_count] >> PAGE_BITS;
+                frame_table[i].allocated = FALSE;
+                free_frames_count++;
+        }
+}
+
 static void free_frames(vaddr_t vaddr)
 {
         paddr_t paddr;
@@ -288,6 +349,7 @@ static void free_frames(vaddr_t vaddr)
         
         while (frame_table[i].allocated == TRUE) { /* otherwise mark block free */
                 frame_table[i].allocated = FALSE;
+                free_frames_count++;
                 if (frame_table[i].not_last == TRUE) {
                         i++;
                 }
@@ -302,9 +364,22 @@ alloc_kpages(unsigned npages)
         paddr_t paddr;
         if (npages > 1 ) {
                 paddr = alloc_multiple_frames(npages);
+                if (paddr == 0 && zero_pool_count > 0) {
+                        /* The pooled frames may be in the way. */
+                        spinlock_acquire(&frame_table_spinlock);
+                        zero_pool_drain();
+                        spinlock_release(&frame_table_spinlock);
+                        paddr = alloc_multiple_frames(npages);
+                }
         }
         else {
                 paddr = alloc_one_frame(npages);
+                if (paddr == 0) {
+                        /* Last resort: a frame somebody zeroed for nothing. */
+                        spinlock_acquire(&frame_table_spinlock);
+                        paddr = zero_pool_take();
+                        spinlock_release(&frame_table_spinlock);
+                }
         }
         
 	if (paddr == 0) {
@@ -319,3 +394,285 @@ free_kpages(vaddr_t addr)
         free_frames(addr);
 }
 
+/*
+ * Pre-zeroed frames.
+ *
+ * alloc_zeroed_kpage is alloc_kpages(1) for a page that has to be
+ * zero-filled, as new user pages are. It takes a frame from the
+ * zero pool if there is one, and otherwise zeroes one itself.
+ * frame_prezero, called by the VM system's zeroing thread when there
+ * is nothing better to do, zeroes a free frame and adds it to the
+ * pool; it returns false if the pool is full or there are no free
+ * frames left to zero. frame_nzeroed is the pool size.
+ */
+
+vaddr_t
+alloc_zeroed_kpage(void)
+{
+        paddr_t paddr;
+        vaddr_t kva;
+
+        spinlock_acquire(&frame_table_spinlock);
+        paddr = zero_pool_take();
+        if (paddr != 0) {
+                zero_pool_hits++;
+                spinlock_release(&frame_table_spinlock);
+                return PADDR_TO_KVADDR(paddr);
+        }
+        zero_pool_misses++;
+        spinlock_release(&frame_table_spinlock);
+
+        kva = alloc_kpages(1);
+        if (kva != 0) {
+                bzero((void *)kva, PAGE_SIZE);
+        }
+        return kva;
+}
+
+bool
+frame_prezero(void)
+{
+        paddr_t paddr;
+
+        if (zero_pool_count >= ZERO_POOL_SIZE) {
+                return false;
+        }
+
+        paddr = alloc_one_frame(1);
+        if (paddr == 0) {
+                return false;
+        }
+        bzero((void *)PADDR_TO_KVADDR(paddr), PAGE_SIZE);
+
+        spinlock_acquire(&frame_table_spinlock);
+        if (zero_pool_count < ZERO_POOL_SIZE) {
+                zero_pool[zero_pool_count++] = paddr;
+                paddr = 0;
+        }
+        spinlock_release(&frame_table_spinlock);
+
+        if (paddr != 0) {
+                /* Somebody else filled it meanwhile. */
+                free_kpages(PADDR_TO_KVADDR(paddr));
+                return false;
+        }
+        return true;
+}
+
+unsigned
+frame_nzeroed(void)
+{
+        return zero_pool_count;
+}
+
+void
+frame_printstats(void)
+{
+        unsigned count, hits, misses;
+
+        spinlock_acquire(&frame_table_spinlock);
+        count = zero_pool_count;
+        hits = zero_pool_hits;
+        misses = zero_pool_misses;
+        spinlock_release(&frame_table_spinlock);
+
+        kprintf("vm: %u pre-zeroed frames ready; %u zero-fill "
+                "allocations used one, %u zeroed on the spot\n",
+                count, hits, misses);
+}
+
+/*
+ * Reference counts for single frames.
+ *
+ * A frame from alloc_kpages(1) starts with one reference. The VM
+ * system shares user pages between address spaces copy-on-write and
+ * takes an extra reference for each additional mapping; the frame is
+ * freed when the last one is dropped. free_kpages ignores the count.
+ * frame_unmap drops the reference of a user mapping; see below.
+ */
+
+void
+frame_incref(paddr_t paddr)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+
+        spinlock_acquire(&frame_table_spinlock);
+        KASSERT(frame_table[i].allocated == TRUE);
+        KASSERT(frame_table[i].not_last == FALSE);
+        frame_table[i].refcount++;
+        spinlock_release(&frame_table_spinlock);
+}
+
+unsigned
+frame_decref(paddr_t paddr)
+{
+        return frame_unmap(paddr, NULL);
+}
+
+/*
+ * Drop the reference AS holds by mapping the frame, forgetting AS as
+ * a mapper. If that leaves a single mapping and we know whose it is,
+ * that address space becomes the owner again.
+ */
+unsigned
+frame_unmap(paddr_t paddr, struct addrspace *as)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+        unsigned count;
+
+        spinlock_acquire(&frame_table_spinlock);
+        KASSERT(frame_table[i].allocated == TRUE);
+        KASSERT(frame_table[i].refcount > 0);
+        if (as != NULL && frame_table[i].as == as) {
+                frame_table[i].as = NULL;
+        }
+        else if (as != NULL && frame_table[i].as2 == as) {
+                frame_table[i].as2 = NULL;
+        }
+        count = --frame_table[i].refcount;
+        if (count == 0) {
+                frame_table[i].allocated = FALSE;
+                free_frames_count++;
+        }
+        else if (count == 1 && frame_table[i].as == NULL) {
+                frame_table[i].as = frame_table[i].as2;
+                frame_table[i].vaddr = frame_table[i].vaddr2;
+                frame_table[i].as2 = NULL;
+        }
+        spinlock_release(&frame_table_spinlock);
+        return count;
+}
+
+unsigned
+frame_refcount(paddr_t paddr)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+        unsigned count;
+
+        spinlock_acquire(&frame_table_spinlock);
+        KASSERT(frame_table[i].allocated == TRUE);
+        count = frame_table[i].refcount;
+        spinlock_release(&frame_table_spinlock);
+        return count;
+}
+
+
+/*
+ * Page replacement support.
+ *
+ * A user page that only one address space maps has an owner: the
+ * address space and the virtual address it is mapped at, which lets
+ * frame_nextvictim work back from a frame to the page table entry
+ * referring to it. Kernel frames have no owner and are never picked,
+ * and neither are shared frames.
+ *
+ * For a shared frame, frame_setowner instead records AS as one of
+ * the address spaces mapping it. Two are remembered: the one that
+ * owned it, and the last other one to map it (as after fork, the
+ * parent and the child). frame_unmap forgets them as they go, so when
+ * all but one mapping have been dropped, the one left is usually
+ * known and becomes the owner, and the page can be evicted again. If
+ * it isn't known (the frame was shared three or more ways), the page
+ * has no owner until it is written, when the VM system sets one.
+ *
+ * The VM system also records here which swap slot, if any, holds an
+ * up-to-date copy of the page, so that clean pages can be dropped
+ * without writing them out again.
+ *
+ * None of this is interpreted here; the VM system (vm/vm.c) keeps it
+ * consistent with its page tables.
+ */
+
+void
+frame_setowner(paddr_t paddr, struct addrspace *as, vaddr_t vaddr)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+
+        spinlock_acquire(&frame_table_spinlock);
+        KASSERT(frame_table[i].allocated == TRUE);
+        if (as == NULL || frame_table[i].refcount == 1) {
+                frame_table[i].as = as;
+                frame_table[i].vaddr = vaddr;
+                frame_table[i].as2 = NULL;
+        }
+        else if (frame_table[i].as == as ||
+                 (frame_table[i].as == NULL && frame_table[i].as2 != as)) {
+                frame_table[i].as = as;
+                frame_table[i].vaddr = vaddr;
+        }
+        else {
+                frame_table[i].as2 = as;
+                frame_table[i].vaddr2 = vaddr;
+        }
+        spinlock_release(&frame_table_spinlock);
+}
+
+unsigned
+frame_getslot(paddr_t paddr)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+        unsigned slot;
+
+        spinlock_acquire(&frame_table_spinlock);
+        KASSERT(frame_table[i].allocated == TRUE);
+        slot = frame_table[i].swapslot;
+        spinlock_release(&frame_table_spinlock);
+        return slot;
+}
+
+void
+frame_setslot(paddr_t paddr, unsigned slot)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+
+        spinlock_acquire(&frame_table_spinlock);
+        KASSERT(frame_table[i].allocated == TRUE);
+        frame_table[i].swapslot = slot;
+        spinlock_release(&frame_table_spinlock);
+}
+
+/*
+ * Advance the clock hand to the next unshared frame with an owner
+ * and return it, along with the owner. Returns 0 if a whole
+ * revolution turns up nothing.
+ */
+paddr_t
+frame_nextvictim(struct addrspace **as, vaddr_t *vaddr)
+{
+        uint32_t i, n;
+
+        spinlock_acquire(&frame_table_spinlock);
+        for (n = first_frame; n < last_frame; n++) {
+                i = clock_hand++;
+                if (clock_hand >= last_frame) {
+                        clock_hand = first_frame;
+                }
+                if (frame_table[i].allocated == TRUE &&
+                    frame_table[i].refcount == 1 &&
+                    frame_table[i].as != NULL) {
+                        *as = frame_table[i].as;
+                        *vaddr = frame_table[i].vaddr;
+                        spinlock_release(&frame_table_spinlock);
+                        return (paddr_t) (i << PAGE_BITS);
+                }
+        }
+        spinlock_release(&frame_table_spinlock);
+        return (paddr_t) 0;
+}
+
+/*
+ * Frame counts, for the pageout thread's watermarks. The free count
+ * is only a snapshot.
+ */
+
+unsigned
+frame_nfree(void)
+{
+        return free_frames_count + zero_pool_count;
+}
+
+unsigned
+frame_nframes(void)
+{
+        return last_frame - first_frame;
+}
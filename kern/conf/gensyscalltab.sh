@@ -0,0 +1,201 @@
+#!/bin/sh
+#
+# gensyscalltab.sh - generate the kernel's system call table.
+#
+# Usage: gensyscalltab.sh kern/syscall.h syscall.h > syscalltab.c
+#
+# Reads the call numbers from <kern/syscall.h> and the sys_*
+# prototypes from <syscall.h>, in both cases only between the
+# /*CALLBEGIN*/ and /*CALLEND*/ markers, and writes syscalltab.c:
+# for each prototype, a wrapper that takes the arguments as the
+# 32-bit words the MIPS calling convention passes them in (64-bit
+# values in aligned pairs, high word first) and converts them, and
+# an entry in syscalltab[], indexed by call number, pointing to it.
+# See syscalltab.h.
+#
+# A prototype's parameters can be:
+#    struct trapframe *tf  the caller's trapframe; takes no words
+#    off_t NAME            a 64-bit argument
+#    TYPE *retval          last; where the return value goes (64
+#                          bits if TYPE is off_t, else 32)
+#    anything else         a 32-bit argument
+# A prototype returns int (0 or an error code), or is __DEAD void
+# for calls that never return.
+# Preprocessor conditionals between the markers are copied through,
+# so calls can depend on kernel options.
+#
+# Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+#	The President and Fellows of Harvard College.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+# 3. Neither the name of the University nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+
+if [ $# != 2 ]; then
+    echo "Usage: $0 kern/syscall.h syscall.h" 1>&2
+    exit 1
+fi
+
+# tabs to spaces, just in case
+cat "$1" "$2" | tr '\t' ' ' |\
+awk -v maxwords=8 '
+    function trim(s) {
+	sub("^ +", "", s);
+	sub(" +$", "", s);
+	return s;
+    }
+
+    function doproto(p,    name, params, np, par, i, pname, type,
+		     w, call, rettype, dead) {
+	gsub(" +", " ", p);
+	dead = (p ~ /^ *__DEAD void sys_/);
+	name = p;
+	sub("^ *(int|__DEAD void) sys_", "", name);
+	sub(" *\\(.*", "", name);
+	if (!(name in num)) {
+	    printf "gensyscalltab: sys_%s has no SYS_%s\n", \
+		name, name > "/dev/stderr";
+	    bad = 1;
+	    return;
+	}
+
+	params = p;
+	sub("^[^(]*\\(", "", params);
+	sub("\\).*", "", params);
+	np = split(params, par, ",");
+
+	w = 0;
+	call = "";
+	rettype = "";
+	for (i=1; i<=np; i++) {
+	    par[i] = trim(par[i]);
+	    if (par[i] == "void") {
+		continue;
+	    }
+	    pname = par[i];
+	    sub("^.*[ *]", "", pname);
+	    type = trim(substr(par[i], 1, length(par[i]) - length(pname)));
+	    if (call != "") {
+		call = call ", ";
+	    }
+	    if (type == "struct trapframe *") {
+		call = call "tf";
+	    }
+	    else if (pname == "retval" && i == np) {
+		rettype = type;
+		sub(" *\\*$", "", rettype);
+		call = call "&rv";
+	    }
+	    else if (type == "off_t") {
+		if (w % 2) {
+		    w++;
+		}
+		call = call sprintf("(off_t)(((uint64_t)a[%d] << 32) | a[%d])",
+				    w, w+1);
+		w += 2;
+	    }
+	    else {
+		call = call sprintf("(%s)a[%d]", type, w);
+		w++;
+	    }
+	}
+	if (w > maxwords) {
+	    printf "gensyscalltab: sys_%s takes too many words\n", \
+		name > "/dev/stderr";
+	    bad = 1;
+	    return;
+	}
+
+	funcs = funcs "\nstatic\nint\n";
+	funcs = funcs sprintf("sc_%s(struct trapframe *tf, const uint32_t *a, int64_t *retval)\n{\n", name);
+	if (rettype != "") {
+	    funcs = funcs sprintf("\t%s rv;\n\tint err;\n\n", rettype);
+	}
+	funcs = funcs "\t(void)tf;\n\t(void)a;\n";
+	if (dead) {
+	    funcs = funcs "\t(void)retval;\n";
+	    funcs = funcs sprintf("\tsys_%s(%s);\n}\n", name, call);
+	}
+	else if (rettype != "") {
+	    funcs = funcs sprintf("\terr = sys_%s(%s);\n", name, call);
+	    funcs = funcs "\tif (err == 0) {\n\t\t*retval = rv;\n\t}\n";
+	    funcs = funcs "\treturn err;\n}\n";
+	}
+	else {
+	    funcs = funcs "\t(void)retval;\n";
+	    funcs = funcs sprintf("\treturn sys_%s(%s);\n}\n", name, call);
+	}
+
+	entries = entries sprintf("\t[SYS_%s] = { \"%s\", sc_%s, %d, %d },\n",
+				  name, name, name, w,
+				  rettype == "" ? 0 : rettype == "off_t" ? 64 : 32);
+    }
+
+    /^\/\*CALLBEGIN\*\// { look=1; file++; next; }
+    /^\/\*CALLEND\*\// { look=0; next; }
+    !look { next; }
+
+    # The call numbers.
+    file == 1 && /^#define SYS_/ && NF==3 {
+	sub("^SYS_", "", $2);
+	num[$2] = $3;
+	next;
+    }
+    file == 1 { next; }
+
+    # The prototypes, and any conditionals around them.
+    /^ *# *(if|ifdef|ifndef|elif|else|endif)/ {
+	funcs = funcs $0 "\n";
+	entries = entries $0 "\n";
+	next;
+    }
+    proto != "" || /^int sys_/ || /^__DEAD void sys_/ {
+	proto = proto " " $0;
+	if (proto ~ /;/) {
+	    doproto(proto);
+	    proto = "";
+	}
+	next;
+    }
+
+    END {
+	if (bad) {
+	    exit 1;
+	}
+	print "/* Automatically generated by gensyscalltab.sh; do not edit */";
+	print "";
+	print "#include <types.h>";
+	print "#include <kern/syscall.h>";
+	print "#include <syscall.h>";
+	print "#include <syscalltab.h>";
+	printf "%s", funcs;
+	print "";
+	print "struct syscallent syscalltab[] = {";
+	printf "%s", entries;
+	print "};";
+	print "";
+	print "const unsigned syscalltab_size =";
+	print "\tsizeof(syscalltab) / sizeof(syscalltab[0]);";
+    }
+'
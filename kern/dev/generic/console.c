@@ -49,6 +49,7 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <cpu.h>
@@ -134,21 +135,50 @@ putch_intr(struct con_softc *cs, int ch)
 }
 
 /*
- * Read a character, using interrupts to wait for I/O completion.
+ * Take the next character from the input buffer, which P on cs_rsem
+ * has said is there.
  */
 static
 int
-getch_intr(struct con_softc *cs)
+getch_buffered(struct con_softc *cs)
 {
 	unsigned char ret;
 
-	P(cs->cs_rsem);
 	ret = cs->cs_gotchars[cs->cs_gotchars_tail];
 	cs->cs_gotchars_tail =
 		(cs->cs_gotchars_tail + 1) % CONSOLE_INPUT_BUFFER_SIZE;
 	return ret;
 }
 
+/*
+ * Read a character, using interrupts to wait for I/O completion.
+ */
+static
+int
+getch_intr(struct con_softc *cs)
+{
+	P(cs->cs_rsem);
+	return getch_buffered(cs);
+}
+
+/*
+ * The same, for a user read: give up with EINTR if the thread is
+ * killed while waiting (see thread_kill).
+ */
+static
+int
+getch_user(struct con_softc *cs, char *ch)
+{
+	int result;
+
+	result = P_intr(cs->cs_rsem);
+	if (result) {
+		return result;
+	}
+	*ch = getch_buffered(cs);
+	return 0;
+}
+
 /*
  * Called from underlying device when a read-ready interrupt occurs.
  *
@@ -174,6 +204,7 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars_head = nexthead;
 
 	V(cs->cs_rsem);
+	pollqueue_wakeup(&cs->cs_pollq);
 }
 
 /*
@@ -247,6 +278,7 @@ con_io(struct device *dev, struct uio *uio)
 	int result;
 	char ch;
 	struct lock *lk;
+	size_t start;
 
 	(void)dev;  // unused
 
@@ -260,9 +292,16 @@ con_io(struct device *dev, struct uio *uio)
 	KASSERT(lk != NULL);
 	lock_acquire(lk);
 
+	start = uio->uio_resid;
 	while (uio->uio_resid > 0) {
 		if (uio->uio_rw==UIO_READ) {
-			ch = getch();
+			KASSERT(the_console != NULL);
+			result = getch_user(the_console, &ch);
+			if (result) {
+				lock_release(lk);
+				/* Don't lose what we already read. */
+				return uio->uio_resid < start ? 0 : result;
+			}
 			if (ch=='\r') {
 				ch = '\n';
 			}
@@ -302,10 +341,33 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Poll: readable once there's a character to read (though a read
+ * still waits for a whole line or a full buffer), and always
+ * writable.
+ */
+static
+int
+con_poll(struct device *dev, int events, struct pollwaiter *pw)
+{
+	struct con_softc *cs = dev->d_data;
+	int revents;
+
+	revents = events & POLLOUT;
+	if (events & POLLIN) {
+		pollqueue_add(&cs->cs_pollq, pw);
+		if (cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+			revents |= POLLIN;
+		}
+	}
+	return revents;
+}
+
 static const struct device_ops console_devops = {
 	.devop_eachopen = con_eachopen,
 	.devop_io = con_io,
 	.devop_ioctl = con_ioctl,
+	.devop_poll = con_poll,
 };
 
 static
@@ -386,6 +448,7 @@ config_con(struct con_softc *cs, int unit)
 	cs->cs_wsem = wsem;
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	pollqueue_init(&cs->cs_pollq);
 
 	the_console = cs;
 	con_userlock_read = rlk;
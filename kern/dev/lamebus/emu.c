@@ -52,6 +52,7 @@
 #include <lamebus/emu.h>
 #include <platform/bus.h>
 #include <vfs.h>
+#include <poll.h>
 #include <emufs.h>
 #include "autoconf.h"
 
@@ -851,13 +852,16 @@ emufs_namefile(struct vnode *v, struct uio *uio)
 
 /*
  * VOP_MMAP
+ *
+ * Files can be mapped; the VM system pages them with emufs_read and
+ * emufs_write.
  */
 static
 int
 emufs_mmap(struct vnode *v)
 {
 	(void)v;
-	return ENOSYS;
+	return 0;
 }
 
 //////////////////////////////
@@ -1093,6 +1097,7 @@ static const struct vnode_ops emufs_fileops = {
 	.vop_gettype = emufs_file_gettype,
 	.vop_isseekable = emufs_isseekable,
 	.vop_fsync = emufs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = emufs_mmap,
 	.vop_truncate = emufs_truncate,
 	.vop_namefile = emufs_uio_op_notdir,
@@ -1127,6 +1132,7 @@ static const struct vnode_ops emufs_dirops = {
 	.vop_gettype = emufs_dir_gettype,
 	.vop_isseekable = emufs_isseekable,
 	.vop_fsync = emufs_void_op_isdir,
+	.vop_poll = vopready_poll,
 	.vop_mmap = emufs_void_op_isdir,
 	.vop_truncate = emufs_truncate_isdir,
 	.vop_namefile = emufs_namefile,
@@ -30,6 +30,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <kern/poll.h>
 #include <stat.h>
 #include <uio.h>
 #include <synch.h>
@@ -38,6 +39,7 @@
 #include <current.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <poll.h>
 
 #include "semfs.h"
 
@@ -136,7 +138,8 @@ semfs_getsem(struct semfs_vnode *semv)
  * Wakeup helper. We only need to wake up if there are sleepers, which
  * should only be the case if the old count is 0; and we only
  * potentially need to wake more than one sleeper if the new count
- * will be more than 1.
+ * will be more than 1. Anyone in poll() waiting for the count to
+ * become nonzero is woken too.
  */
 static
 void
@@ -145,6 +148,7 @@ semfs_wakeup(struct semfs_sem *sem, unsigned newcount)
 	if (sem->sems_count > 0 || newcount == 0) {
 		return;
 	}
+	pollqueue_wakeup(&sem->sems_pollq);
 	if (newcount == 1) {
 		cv_signal(sem->sems_cv, sem->sems_lock);
 	}
@@ -182,7 +186,9 @@ semfs_semstat(struct vnode *vn, struct stat *buf)
 
 /*
  * Read. This is P(); decrease the count by the amount read.
- * Don't actually bother to transfer any data.
+ * Don't actually bother to transfer any data. If we're interrupted
+ * partway, give back what we took; other processes may be waiting
+ * for it.
  */
 static
 int
@@ -190,9 +196,11 @@ semfs_read(struct vnode *vn, struct uio *uio)
 {
 	struct semfs_vnode *semv = vn->vn_data;
 	struct semfs_sem *sem;
-	size_t consume;
+	size_t consume, taken;
+	int result;
 
 	sem = semfs_getsem(semv);
+	taken = 0;
 
 	lock_acquire(sem->sems_lock);
 	while (uio->uio_resid > 0) {
@@ -205,6 +213,7 @@ semfs_read(struct vnode *vn, struct uio *uio)
 			      semv->semv_semnum, sem->sems_count,
 			      sem->sems_count - consume);
 			sem->sems_count -= consume;
+			taken += consume;
 			/* don't bother advancing the uio data pointers */
 			uio->uio_offset += consume;
 			uio->uio_resid -= consume;
@@ -215,7 +224,20 @@ semfs_read(struct vnode *vn, struct uio *uio)
 		if (sem->sems_count == 0) {
 			DEBUG(DB_SEMFS, "semfs: sem%u: blocking\n",
 			      semv->semv_semnum);
-			cv_wait(sem->sems_cv, sem->sems_lock);
+			result = cv_wait_intr(sem->sems_cv, sem->sems_lock);
+			/*
+			 * If the count went up meanwhile, take that
+			 * first; giving back to a count of 0 can't
+			 * overflow.
+			 */
+			if (result && sem->sems_count == 0) {
+				semfs_wakeup(sem, taken);
+				sem->sems_count = taken;
+				uio->uio_offset -= taken;
+				uio->uio_resid += taken;
+				lock_release(sem->sems_lock);
+				return result;
+			}
 		}
 	}
 	lock_release(sem->sems_lock);
@@ -255,6 +277,31 @@ semfs_write(struct vnode *vn, struct uio *uio)
 	return 0;
 }
 
+/*
+ * Poll. A semaphore can be read (P) without blocking when the count
+ * isn't zero, and written (V) any time.
+ */
+static
+int
+semfs_poll(struct vnode *vn, int events, struct pollwaiter *pw)
+{
+	struct semfs_vnode *semv = vn->vn_data;
+	struct semfs_sem *sem;
+	int revents;
+
+	revents = events & POLLOUT;
+	if (events & POLLIN) {
+		sem = semfs_getsem(semv);
+		lock_acquire(sem->sems_lock);
+		pollqueue_add(&sem->sems_pollq, pw);
+		if (sem->sems_count > 0) {
+			revents |= POLLIN;
+		}
+		lock_release(sem->sems_lock);
+	}
+	return revents;
+}
+
 /*
  * Truncate. Set the count to the specified value.
  *
@@ -663,6 +710,7 @@ static const struct vnode_ops semfs_dirops = {
 	.vop_gettype = semfs_gettype,
 	.vop_isseekable = semfs_isseekable,
 	.vop_fsync = semfs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
 	.vop_namefile = semfs_namefile,
@@ -696,6 +744,7 @@ static const struct vnode_ops semfs_semops = {
 	.vop_gettype = semfs_gettype,
 	.vop_isseekable = semfs_isseekable,
 	.vop_fsync = semfs_fsync,
+	.vop_poll = semfs_poll,
 	.vop_mmap = vopfail_mmap_perm,
 	.vop_truncate = semfs_truncate,
 	.vop_namefile = vopfail_uio_notdir,
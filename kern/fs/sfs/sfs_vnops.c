@@ -39,6 +39,7 @@
 #include <lib.h>
 #include <uio.h>
 #include <vfs.h>
+#include <poll.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
@@ -232,14 +233,15 @@ sfs_fsync(struct vnode *v)
 }
 
 /*
- * Called for mmap().
+ * Called for mmap(). Files can be mapped; the VM system pages them
+ * with sfs_read and sfs_write.
  */
 static
 int
-sfs_mmap(struct vnode *v   /* add stuff as needed */)
+sfs_mmap(struct vnode *v)
 {
 	(void)v;
-	return ENOSYS;
+	return 0;
 }
 
 /*
@@ -599,6 +601,7 @@ const struct vnode_ops sfs_fileops = {
 	.vop_gettype = sfs_gettype,
 	.vop_isseekable = sfs_isseekable,
 	.vop_fsync = sfs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = sfs_mmap,
 	.vop_truncate = sfs_truncate,
 	.vop_namefile = vopfail_uio_notdir,
@@ -633,6 +636,7 @@ const struct vnode_ops sfs_dirops = {
 	.vop_gettype = sfs_gettype,
 	.vop_isseekable = sfs_isseekable,
 	.vop_fsync = sfs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
 	.vop_namefile = sfs_namefile,
@@ -39,13 +39,48 @@
 #include "opt-dumbvm.h"
 
 struct vnode;
+struct lock;
+struct rusage;
+struct pagetable;
 
 
+/*
+ * A region is a page-aligned range of an address space with uniform
+ * permissions: one per ELF segment, plus the stack. Pages in a
+ * region are not backed by anything until they are first touched;
+ * see vm_fault(). Then they are zero-filled, except for the part of
+ * the region mapped from a file, if any (see as_map_file), which is
+ * read in from the file.
+ */
+struct region {
+        vaddr_t rg_base;                /* first address */
+        size_t rg_npages;               /* length in pages */
+        int rg_flags;                   /* RG_* permissions */
+        struct vnode *rg_vnode;         /* file mapped, or NULL */
+        vaddr_t rg_fileva;              /* where file data starts */
+        size_t rg_filesize;             /* length of file data */
+        off_t rg_fileoff;               /* file offset of rg_fileva */
+        struct region *rg_next;         /* next region, by address */
+};
+
+#define RG_READ         0x1
+#define RG_WRITE        0x2
+#define RG_EXEC         0x4
+#define RG_SHARED       0x8     /* MAP_SHARED: writes go to the file */
+#define RG_MMAP         0x10    /* made by mmap; can be unmapped */
+
+#define RG_TOP(rg)      ((rg)->rg_base + (rg)->rg_npages * PAGE_SIZE)
+
+/* Maximum user stack size; pages are only allocated as it is touched */
+#define VM_STACKPAGES   4096
+
 /*
  * Address space - data structure associated with the virtual memory
  * space of a process.
  *
- * You write this.
+ * as_lock protects the region list and serializes faults. It is a
+ * sleep lock because filling in a page may need to wait for memory
+ * or I/O. Page table entries are protected by vm_ptlock instead.
  */
 
 struct addrspace {
@@ -58,7 +93,24 @@ struct addrspace {
         size_t as_npages2;
         paddr_t as_stackpbase;
 #else
-        /* Put stuff here for your VM system */
+        struct lock *as_lock;           /* protects the following */
+        struct region *as_regions;      /* sorted list of regions */
+        struct pagetable *as_pt;        /* page table (see vm_ptlock) */
+        bool as_loading;                /* ignore RG_WRITE while loading */
+        struct region *as_heap;         /* region sbrk grows, or NULL */
+        vaddr_t as_heapbrk;             /* current break, in as_heap */
+        vaddr_t as_faultnext;           /* fault here is sequential */
+        unsigned as_faultwin;           /* fault-around window, in pages */
+        unsigned as_minflt;             /* faults that needed no I/O */
+        unsigned as_majflt;             /* faults that read a page in */
+        unsigned as_ncowbreaks;         /* shared pages copied on write */
+        unsigned as_nswapins;           /* pages read back from swap */
+        unsigned as_nprefaults;         /* pages mapped by fault-around */
+        unsigned as_rss;                /* pages in core; vm_ptlock */
+        unsigned as_maxrss;             /* largest as_rss; vm_ptlock */
+        unsigned as_pageouts;           /* pages being evicted; vm_ptlock */
+        uint32_t as_asid;               /* TLB address space ID; see vm.c */
+        uint32_t as_tlbcpus;            /* CPUs it has been active on */
 #endif
 };
 
@@ -99,6 +151,36 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_getusage - fill in the memory fields of RU (resident set
+ *                sizes, fault counts) for the address space. Leaves
+ *                the other fields alone.
+ *
+ *    as_map_file - make FILESIZE bytes of the file V, starting at
+ *                OFFSET, appear at VADDR, in the region already
+ *                defined there. Pages are read from the file as they
+ *                are touched; the rest of the region is zero-filled.
+ *
+ *    as_mmap   - add a region of LEN bytes with permissions FLAGS
+ *                (RG_*) mapping FILESIZE bytes of the file V from
+ *                OFFSET, or if V is NULL, just zero-filled. With
+ *                FIXED, it goes at *VADDR; otherwise anywhere free.
+ *                Hands back the address in *VADDR.
+ *
+ *    as_munmap - remove the mappings of the pages in [VADDR,
+ *                VADDR+LEN), which must all have been made by
+ *                as_mmap, writing back MAP_SHARED pages first.
+ *
+ *    as_msync  - write back the changed MAP_SHARED pages in [VADDR,
+ *                VADDR+LEN).
+ *
+ *    as_sbrk   - move the end of the heap by AMOUNT bytes (which may
+ *                be negative), handing back the old end in OLDBRK.
+ *                The heap starts out empty, on the page after the
+ *                last segment loaded; see as_complete_load.
+ *
+ *    as_findregion - return the region containing VADDR, or NULL.
+ *                The caller must hold as_lock.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -117,16 +199,36 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+void              as_getusage(struct addrspace *as, struct rusage *ru);
+
+#if !OPT_DUMBVM
+int               as_map_file(struct addrspace *as, vaddr_t vaddr,
+                              struct vnode *v, off_t offset,
+                              size_t filesize);
+int               as_mmap(struct addrspace *as, vaddr_t *vaddr, size_t len,
+                          int flags, bool fixed, struct vnode *v,
+                          off_t offset, size_t filesize);
+int               as_munmap(struct addrspace *as, vaddr_t vaddr, size_t len);
+int               as_msync(struct addrspace *as, vaddr_t vaddr, size_t len);
+int               as_sbrk(struct addrspace *as, intptr_t amount,
+                          vaddr_t *oldbrk);
+struct region    *as_findregion(struct addrspace *as, vaddr_t vaddr);
+#endif
 
 
 /*
  * Functions in loadelf.c
  *    load_elf - load an ELF user program executable into the current
  *               address space. Returns the entry point (initial PC)
- *               in the space pointed to by ENTRYPOINT.
+ *               in the space pointed to by ENTRYPOINT. Segments are
+ *               mapped from the file and paged in as they are used.
+ *
+ *    load_elf_eager - the same, but reads every segment in up front.
+ *               (This is what load_elf does with dumbvm.)
  */
 
 int load_elf(struct vnode *v, vaddr_t *entrypoint);
+int load_elf_eager(struct vnode *v, vaddr_t *entrypoint);
 
 
 #endif /* _ADDRSPACE_H_ */
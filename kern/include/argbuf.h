@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _ARGBUF_H_
+#define _ARGBUF_H_
+
+/*
+ * Argument vectors for exec.
+ *
+ * The strings are copied into one ARG_MAX-sized buffer, packed from
+ * the front, while each string's offset goes in a word at the back,
+ * counting down. The two ends meeting is exactly the ARG_MAX limit
+ * (which counts both the strings and the argv pointers), so there's
+ * no separate pass to measure the arguments first. Once the new
+ * address space is ready, the offsets are turned into an argv array
+ * right after the strings and the whole block goes onto the new user
+ * stack with one copyout.
+ */
+
+struct argbuf {
+	char *ab_buf;		/* ARG_MAX bytes */
+	size_t ab_strsize;	/* bytes of strings at the front */
+	unsigned ab_argc;	/* number of offsets at the back */
+};
+
+/*
+ * Functions in argbuf.c:
+ *
+ *    argbuf_init       - allocate the buffer. ENOMEM if we can't.
+ *    argbuf_cleanup    - free it.
+ *    argbuf_fromuser   - collect the NULL-terminated user argv UARGV.
+ *                        E2BIG if it exceeds ARG_MAX.
+ *    argbuf_fromkernel - the same for kernel strings ARGS[0..NARGS-1].
+ *    argbuf_copyout    - put the strings and an argv array for them
+ *                        on the current address space's stack below
+ *                        *STACKPTR, and hand back the new stack
+ *                        pointer and the user address of argv.
+ */
+int argbuf_init(struct argbuf *ab);
+void argbuf_cleanup(struct argbuf *ab);
+int argbuf_fromuser(struct argbuf *ab, userptr_t uargv);
+int argbuf_fromkernel(struct argbuf *ab, char **args, unsigned nargs);
+int argbuf_copyout(struct argbuf *ab, vaddr_t *stackptr, userptr_t *uargv);
+
+#endif /* _ARGBUF_H_ */
@@ -88,5 +88,27 @@ void timespec_sub(const struct timespec *t1,
  */
 void clocksleep(int seconds);
 
+/*
+ * Clock timers: one-shot callbacks from the timer interrupt.
+ *
+ * clocktimer_start() arranges for FUNC(DATA) to be called once DELAY
+ * has passed, to within a hardclock tick. clocktimer_stop() cancels
+ * it if it hasn't gone off yet; once it returns, FUNC isn't running
+ * and won't be, so the timer can be freed. FUNC runs on CPU 0 in the
+ * interrupt handler with a spinlock held, so it mustn't sleep; it
+ * can take other spinlocks and do wchan_wakeall.
+ */
+struct clocktimer {
+	struct timespec ct_when;	/* when to go off */
+	void (*ct_func)(void *);	/* what to call */
+	void *ct_data;			/* argument for ct_func */
+	bool ct_pending;		/* on the list, not gone off yet */
+	struct clocktimer *ct_next;	/* next on the list */
+};
+
+void clocktimer_start(struct clocktimer *ct, const struct timespec *delay,
+		      void (*func)(void *), void *data);
+void clocktimer_stop(struct clocktimer *ct);
+
 
 #endif /* _CLOCK_H_ */
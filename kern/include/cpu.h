@@ -61,6 +61,7 @@ struct cpu {
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
+	uint32_t c_asidgen;		/* ASID generation of TLB; see vm.c */
 
 	/*
 	 * Accessed by other cpus.
@@ -77,7 +78,15 @@ struct cpu {
 	 * TLB shootdown requests made to this CPU are queued in
 	 * c_shootdown[], with c_numshootdown holding the number of
 	 * requests. TLBSHOOTDOWN_MAX is the maximum number that can
-	 * be queued at once, which is machine-dependent.
+	 * be queued at once, which is machine-dependent. If more than
+	 * that arrive, c_numshootdown is set past TLBSHOOTDOWN_MAX and
+	 * the whole TLB is flushed instead.
+	 *
+	 * c_shootdowns_sent counts the requests ever made to this CPU
+	 * and c_shootdowns_done how many of those it has handled, so
+	 * ipi_tlbshootdown_wait can tell when they have all been
+	 * carried out. c_ipi_live is false before the CPU has started
+	 * and after it has stopped, when it won't answer.
 	 *
 	 * The contents of struct tlbshootdown are also machine-
 	 * dependent and might reasonably be either an address space
@@ -86,6 +95,9 @@ struct cpu {
 	uint32_t c_ipi_pending;		/* One bit for each IPI number */
 	struct tlbshootdown c_shootdown[TLBSHOOTDOWN_MAX];
 	unsigned c_numshootdown;
+	unsigned c_shootdowns_sent;
+	unsigned c_shootdowns_done;
+	bool c_ipi_live;
 	struct spinlock c_ipi_lock;
 
 	/*
@@ -142,6 +154,13 @@ void cpu_irqon(void);
 void cpu_idle(void);
 void cpu_halt(void);
 
+/*
+ * Read the current CPU's cycle counter, for timing short stretches of
+ * code. It wraps around, so only differences of less than the wrap
+ * time mean anything.
+ */
+uint32_t cpu_cycles(void);
+
 /*
  * Interprocessor interrupts.
  *
@@ -155,6 +174,15 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_broadcast sends the same shootdown to all CPUs
+ * except the current one.
+ * ipi_tlbshootdown_some sends it to the CPUs whose c_number bits are
+ * set in CPUS, again except the current one.
+ * ipi_tlbshootdown_wait waits until every other CPU has carried out
+ * all the shootdowns sent to it so far. Shootdowns are otherwise
+ * asynchronous, so this is needed before reusing memory the
+ * invalidated entries mapped. It must be called without spinlocks
+ * held, since the CPUs it waits for may be spinning on them.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -169,6 +197,10 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_some(uint32_t cpus,
+			   const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_wait(void);
 
 void interprocessor_interrupt(void);
 
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FILETABLE_H_
+#define _FILETABLE_H_
+
+/*
+ * Per-process file descriptor table.
+ *
+ * A fixed array of OPEN_MAX openfile pointers, indexed by file
+ * descriptor; NULL means the descriptor isn't open. The slots are
+ * protected by a spinlock rather than a sleep lock, because looking
+ * up a descriptor is on the path of every read and write and is only
+ * a load and a reference count bump. Anything that might sleep, such
+ * as closing the file a slot used to hold, happens after letting go.
+ */
+
+#include <limits.h>
+#include <spinlock.h>
+
+struct openfile;
+
+struct filetable {
+	struct spinlock ft_lock;
+	struct openfile *ft_files[OPEN_MAX];
+};
+
+/*
+ * Functions in filetable.c:
+ *
+ *    filetable_create  - make an empty table. NULL if out of memory.
+ *    filetable_destroy - close everything and free the table.
+ *    filetable_copy    - make a new table with the same files in the
+ *                        same descriptors, sharing their offsets (for
+ *                        fork). NULL if out of memory.
+ *    filetable_get     - look up FD and hand back its openfile with a
+ *                        reference added, which the caller drops with
+ *                        openfile_decref. EBADF if FD isn't open.
+ *    filetable_place   - put FILE in the lowest free descriptor, and
+ *                        hand that back. Takes over the caller's
+ *                        reference. EMFILE if the table is full.
+ *    filetable_placeat - put FILE at descriptor FD, handing back what
+ *                        was there before (or NULL) for the caller to
+ *                        openfile_decref. Takes over the caller's
+ *                        reference. EBADF if FD is out of range.
+ *    filetable_remove  - empty descriptor FD, handing back its file
+ *                        for the caller to openfile_decref. EBADF if
+ *                        FD isn't open.
+ *    filetable_okfd    - whether FD is in range.
+ */
+struct filetable *filetable_create(void);
+void filetable_destroy(struct filetable *ft);
+struct filetable *filetable_copy(struct filetable *ft);
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_place(struct filetable *ft, struct openfile *file, int *fd);
+int filetable_placeat(struct filetable *ft, struct openfile *file, int fd,
+		      struct openfile **oldfile);
+int filetable_remove(struct filetable *ft, int fd, struct openfile **ret);
+bool filetable_okfd(int fd);
+
+#endif /* _FILETABLE_H_ */
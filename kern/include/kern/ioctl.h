@@ -34,6 +34,11 @@
  * ioctl operation codes
  */
 
-/* (none yet) */
+/*
+ * FIONBIO: the argument points to an int; nonzero makes reads and
+ * writes on the object fail with EAGAIN instead of waiting. Only
+ * pipes support it so far.
+ */
+#define FIONBIO		1
 
 #endif /* _KERN_IOCTL_H_*/
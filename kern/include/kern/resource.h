@@ -67,6 +67,12 @@ struct rusage {
 	__counter_t ru_nsignals;	/* signals delivered (count) */
 	__counter_t ru_nvcsw;		/* voluntary context switches (count)*/
 	__counter_t ru_nivcsw;		/* involuntary ditto (count) */
+
+	/* OS/161 additions */
+	__size_t ru_rss;		/* current RSS (kb) */
+	__counter_t ru_ncow;		/* pages copied on write (count) */
+	__counter_t ru_nswapin;		/* pages read from swap (count) */
+	__counter_t ru_nprefault;	/* pages mapped ahead of use (count) */
 };
 
 /* limit codes for getrusage/setrusage */
@@ -54,6 +54,12 @@
 #define SYS_waitpid      4
 #define SYS_getpid       5
 #define SYS_getppid      6
+//                              (threads)
+#define SYS___thread_create 123
+#define SYS___thread_exit 124
+#define SYS___thread_join 125
+#define SYS___futex_wait 126
+#define SYS___futex_wake 127
 //                              (virtual memory)
 #define SYS_sbrk         7
 #define SYS_mmap         8
@@ -65,6 +71,7 @@
 //#define SYS_munlock    14
 //#define SYS_munlockall 15
 //#define SYS_minherit   16
+#define SYS_msync        121
 //                              (security/credentials)
 #define SYS_umask        17
 #define SYS_issetugid    18
@@ -86,7 +93,7 @@
 //#define SYS_sigaltstack 33
 //                              (resource tracking and usage)
 //#define SYS_wait4      34
-//#define SYS_getrusage  35
+#define SYS_getrusage    35
 //                              (resource limits)
 //#define SYS_getrlimit  36
 //#define SYS_setrlimit  37
@@ -109,13 +116,13 @@
 #define SYS_close        49
 #define SYS_read         50
 #define SYS_pread        51
-//#define SYS_readv      52
-//#define SYS_preadv     53
+#define SYS_readv        52
+#define SYS_preadv       53
 #define SYS_getdirentry  54
 #define SYS_write        55
 #define SYS_pwrite       56
-//#define SYS_writev     57
-//#define SYS_pwritev    58
+#define SYS_writev       57
+#define SYS_pwritev      58
 #define SYS_lseek        59
 #define SYS_flock        60
 #define SYS_ftruncate    61
@@ -124,6 +131,7 @@
 #define SYS_ioctl        64
 #define SYS_select       65
 #define SYS_poll         66
+#define SYS_splice       122
 
 //                              -- Pathname-related --
 #define SYS_link         67
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _OPENFILE_H_
+#define _OPENFILE_H_
+
+/*
+ * Open file objects.
+ *
+ * An openfile is what a file descriptor refers to: a vnode, the mode
+ * it was opened with, and the seek position. It's shared by every
+ * descriptor made from the same open, via dup2 or fork, so they all
+ * move the same offset.
+ *
+ * of_offsetlock serializes I/O that uses and advances the offset,
+ * so two threads reading through one openfile get different bytes.
+ * Objects that can't seek (the console) have no offset to protect,
+ * and don't take it. The reference count is under a spinlock so
+ * getting and dropping a reference never sleeps.
+ */
+
+#include <spinlock.h>
+
+struct lock;
+struct vnode;
+
+struct openfile {
+	struct vnode *of_vnode;		/* the object */
+	int of_accmode;			/* O_RDONLY, O_WRONLY, or O_RDWR */
+	bool of_append;			/* O_APPEND: writes go at the end */
+	bool of_seekable;		/* VOP_ISSEEKABLE, saved */
+
+	struct lock *of_offsetlock;	/* protects of_offset */
+	off_t of_offset;		/* seek position */
+
+	struct spinlock of_countlock;	/* protects of_refcount */
+	unsigned of_refcount;		/* descriptors referring to us */
+};
+
+/*
+ * Functions in openfile.c:
+ *
+ *    openfile_open   - open PATH with vfs_open and make an openfile
+ *                      for it, with one reference. May destroy PATH.
+ *    openfile_create - make an openfile for a vnode that's already
+ *                      open (such as a pipe), with access mode and
+ *                      flags OPENFLAGS. On success it takes over the
+ *                      caller's vnode reference.
+ *    openfile_incref - add a reference.
+ *    openfile_decref - drop a reference; the last one closes the file.
+ */
+int openfile_open(char *path, int openflags, mode_t mode,
+		  struct openfile **ret);
+int openfile_create(struct vnode *v, int openflags, struct openfile **ret);
+void openfile_incref(struct openfile *file);
+void openfile_decref(struct openfile *file);
+
+#endif /* _OPENFILE_H_ */
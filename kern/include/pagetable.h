@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PAGETABLE_H_
+#define _PAGETABLE_H_
+
+/*
+ * Two-level page tables for user address spaces.
+ *
+ * The top level (the directory) is one page holding PT_NENTRIES
+ * pointers to second-level tables, each of which is one page of
+ * PT_NENTRIES page table entries. Second-level tables are allocated
+ * only when something in the 4M of address space they cover is
+ * touched. Both levels are whole frames in kseg0, so they can be
+ * walked without taking TLB faults.
+ *
+ * A page table entry is laid out like the TLB's entrylo word, so a
+ * valid PTE can be loaded into the TLB as it is. The low byte, which
+ * the TLB does not use, holds software bits; it must be masked off
+ * (PTE_TLBLO) before loading. An entry of 0 means nothing is there
+ * yet and the page should be filled in according to its region.
+ *
+ * A page in memory has PTE_INCORE set. PTE_VALID doubles as its
+ * referenced bit: page replacement clears it, and the next access
+ * faults and sets it again. A page out on swap has PTE_SWAPPED set
+ * and the swap slot number where the frame number would be.
+ * PTE_CLEAN marks a page that still holds exactly what its region
+ * would fill it with again (e.g. program text); rather than being
+ * written to swap it can just be dropped back to an empty entry.
+ * PTE_CACHED marks a frame shared through the text page cache.
+ *
+ * Functions:
+ *     pt_create  - allocate an empty page table. Returns NULL if
+ *                  out of memory.
+ *     pt_destroy - free a page table. RELEASE, if not NULL, is
+ *                  called with DATA on every nonzero entry first.
+ *     pt_lookup  - return a pointer to the entry for VADDR. If
+ *                  CREATE is set, allocate the second-level table
+ *                  if necessary, returning NULL if out of memory;
+ *                  otherwise return NULL if there is no table.
+ */
+
+#include <machine/tlb.h>
+
+typedef uint32_t pte_t;
+
+#define PT_NENTRIES	1024
+#define PT_L1_INDEX(va)	((va) >> 22)
+#define PT_L2_INDEX(va)	(((va) >> 12) & (PT_NENTRIES - 1))
+
+/* Hardware bits, as in TLB entrylo */
+#define PTE_FRAME	TLBLO_PPAGE	/* physical page */
+#define PTE_DIRTY	TLBLO_DIRTY	/* writes allowed */
+#define PTE_VALID	TLBLO_VALID	/* may be loaded into the TLB */
+
+/* Software bits */
+#define PTE_INCORE	0x00000001	/* PTE_FRAME holds the page */
+#define PTE_SWAPPED	0x00000002	/* the page is in swap; see PTE_SLOT */
+#define PTE_BUSY	0x00000004	/* the page is going to or from swap */
+#define PTE_CLEAN	0x00000008	/* can be refilled from the region */
+#define PTE_CACHED	0x00000010	/* frame is in the text page cache */
+#define PTE_SWBITS	0x000000ff
+
+#define PTE_SLOT(pte)	((pte) >> 12)
+#define PTE_MKSLOT(s)	(((pte_t)(s) << 12) | PTE_SWAPPED)
+
+#define PTE_TLBLO(pte)	((pte) & ~(pte_t)PTE_SWBITS)
+
+struct pagetable {
+	pte_t *pt_dir[PT_NENTRIES];
+};
+
+struct pagetable *pt_create(void);
+void pt_destroy(struct pagetable *pt, void (*release)(void *, pte_t),
+		void *data);
+pte_t *pt_lookup(struct pagetable *pt, vaddr_t vaddr, bool create);
+
+#endif /* _PAGETABLE_H_ */
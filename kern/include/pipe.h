@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+/*
+ * Pipes.
+ *
+ * A pipe is a one-page ring buffer with a vnode for each end, so
+ * that the file table, read, write, and close treat it like any
+ * other open file. Each end goes away when its vnode's last
+ * reference does; the pipe itself goes when both have.
+ *
+ * pipe_create     - make a pipe, handing back a vnode for each end.
+ * pipe_isreadend  - whether V is the read end of a pipe.
+ * pipe_iswriteend - whether V is the write end of a pipe.
+ * pipe_fill       - move up to LEN bytes into the pipe whose write end
+ *                   is PIPEVN by reading file SRC at *POS, advancing
+ *                   *POS and handing back the amount in *MOVED.
+ * pipe_drain      - move up to LEN bytes out of the pipe whose read
+ *                   end is PIPEVN by writing them to file DST at *POS.
+ *
+ * pipe_fill and pipe_drain are for splice: the file system reads
+ * straight into, or writes straight out of, the ring buffer, with no
+ * copy through user memory. Like read and write on the pipe, they
+ * wait until there's space or data, unless the end is non-blocking.
+ */
+
+struct vnode;
+
+int pipe_create(struct vnode **readend, struct vnode **writeend);
+bool pipe_isreadend(struct vnode *v);
+bool pipe_iswriteend(struct vnode *v);
+int pipe_fill(struct vnode *pipevn, struct vnode *src, off_t *pos,
+	      size_t len, size_t *moved);
+int pipe_drain(struct vnode *pipevn, struct vnode *dst, off_t *pos,
+	       size_t len, size_t *moved);
+
+#endif /* _PIPE_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Waiting for I/O readiness, for poll().
+ *
+ * Anything poll can wait on (a pipe end, a semaphore, the console)
+ * has a pollqueue. Its vop_poll adds the caller's pollwaiter to the
+ * queue, then reports which of the requested events are ready now;
+ * whenever one might have become ready, it calls pollqueue_wakeup,
+ * which wakes every waiter on the queue. Adding to the queue before
+ * checking, under the same lock that changes the state, means no
+ * wakeup can fall in between.
+ *
+ * pollqueue_init    - set up an empty queue.
+ * pollqueue_cleanup - tear down a queue; it must be empty.
+ * pollqueue_add     - put PW on the queue, unless PW is NULL (a later
+ *                     pass of the same poll, already on it).
+ * pollqueue_wakeup  - wake everyone on the queue. Works in interrupt
+ *                     handlers.
+ *
+ * pollwaiter_create  - make a waiter for one poll() call that can be
+ *                      on up to MAXQUEUES queues. If MSECS is
+ *                      positive, it times out after that long.
+ * pollwaiter_destroy - take the waiter off its queues and free it.
+ * pollwaiter_reset   - forget past wakeups, before checking the
+ *                      files again.
+ * pollwaiter_sleep   - sleep until a wakeup since the last reset, or
+ *                      the timeout, and say in *TIMEDOUT whether it
+ *                      timed out. Fails with EINTR if the thread is
+ *                      killed (see thread_kill).
+ *
+ * vopready_poll is the vop_poll for objects that are always ready,
+ * like regular files.
+ */
+
+#include <spinlock.h>
+
+struct pollentry;
+struct pollwaiter;
+struct vnode;
+
+struct pollqueue {
+	struct spinlock pq_lock;
+	struct pollentry *pq_entries;
+};
+
+void pollqueue_init(struct pollqueue *pq);
+void pollqueue_cleanup(struct pollqueue *pq);
+void pollqueue_add(struct pollqueue *pq, struct pollwaiter *pw);
+void pollqueue_wakeup(struct pollqueue *pq);
+
+struct pollwaiter *pollwaiter_create(unsigned maxqueues, int msecs);
+void pollwaiter_destroy(struct pollwaiter *pw);
+void pollwaiter_reset(struct pollwaiter *pw);
+int pollwaiter_sleep(struct pollwaiter *pw, bool *timedout);
+
+int vopready_poll(struct vnode *v, int events, struct pollwaiter *pw);
+
+#endif /* _POLL_H_ */
@@ -36,22 +36,31 @@
  * Note: curproc is defined by <current.h>.
  */
 
+#include <kern/time.h>
+#include <kern/resource.h>
 #include <spinlock.h>
 
 struct addrspace;
+struct cv;
+struct filetable;
 struct thread;
+struct trapframe;
+struct uthread;
 struct vnode;
+struct wchan;
 
 /*
  * Process structure.
  *
  * Note that we only count the number of threads in each process.
- * (And, unless you implement multithreaded user processes, this
- * number will not exceed 1 except in kproc.) If you want to know
- * exactly which threads are in the process, e.g. for debugging, add
- * an array and a sleeplock to protect it. (You can't use a spinlock
- * to protect an array because arrays need to be able to call
- * kmalloc.)
+ * A user process starts with one; thread_create adds more, each with
+ * a record on p_threads so thread_join can find out when it's done.
+ *
+ * p_lock comes before the spinlocks threads sleep on interruptibly
+ * (those of condition variables, semaphores and poll waiters; see
+ * wchan_sleep_intr): proc_singlethread calls thread_kill with it
+ * held, so that the threads it kills can't exit meanwhile. So don't
+ * take p_lock while holding one of those.
  *
  * You will most likely be adding stuff to this structure, so you may
  * find you need a sleeplock in here for other reasons as well.
@@ -63,16 +72,47 @@ struct proc {
 	char *p_name;			/* Name of this process */
 	struct spinlock p_lock;		/* Lock for this structure */
 	unsigned p_numthreads;		/* Number of threads in this process */
+	struct thread *p_threadlist;	/* them, linked by t_procnext */
 
 	/* VM */
 	struct addrspace *p_addrspace;	/* virtual address space */
 
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
-
-	/* add more material here as needed */
+	struct filetable *p_filetable;	/* open files, by descriptor */
+
+	/*
+	 * Process table and family. These are protected by the
+	 * process table lock in proc.c, not p_lock.
+	 */
+	pid_t p_pid;			/* process id; 0 for kproc */
+	struct proc *p_parent;		/* who collects our status, or NULL */
+	struct proc *p_children;	/* first of our children */
+	struct proc *p_nextsib;		/* our parent's next child */
+	struct proc *p_prevsib;		/* our parent's previous child */
+	bool p_vfork;			/* using our parent's address space */
+	bool p_exited;			/* true once we've exited */
+	int p_exitstatus;		/* wait status, once we've exited */
+	struct cv *p_exitcv;		/* signaled when we exit */
+	struct rusage p_usage;		/* our own use, saved at exit */
+	struct rusage p_childusage;	/* total use of collected children */
+
+	/*
+	 * User threads. p_threads, p_nexttid, and p_userthreads are
+	 * protected by p_threadlock; p_survivor by p_lock.
+	 */
+	struct lock *p_threadlock;
+	struct cv *p_threadcv;		/* signaled when a user thread exits */
+	struct uthread *p_threads;	/* threads made by thread_create */
+	int p_nexttid;			/* tid for the next one */
+	unsigned p_userthreads;		/* user threads not yet exited */
+	struct thread *p_survivor;	/* if set, every other thread must go */
+	struct wchan *p_threadwchan;	/* p_survivor waits here for them */
 };
 
+/* How many processes, including unwaited-for zombies, there can be. */
+#define PROCS_MAX	1024
+
 /* This is the process structure for the kernel and for kernel-only threads. */
 extern struct proc *kproc;
 
@@ -82,6 +122,64 @@ void proc_bootstrap(void);
 /* Create a fresh process for use by runprogram(). */
 struct proc *proc_create_runprogram(const char *name);
 
+/*
+ * Create a child of the current process that's a copy of it (for
+ * fork), or with VFORK, that borrows its address space (for vfork).
+ */
+int proc_fork(bool vfork, struct proc **ret);
+
+/* Wait for vfork child PID to give back our address space. */
+void proc_vforkwait(pid_t pid);
+
+/*
+ * Give a borrowed address space back to the vfork parent, if the
+ * current process has one. The caller must already have taken it out
+ * of p_addrspace. Returns false if it wasn't borrowed.
+ */
+bool proc_vforkdone(void);
+
+/* Exit the current process and thread with wait status STATUS. */
+__DEAD void proc_exit(int status);
+
+/*
+ * Wait for the current process's child PID to exit and collect it.
+ * With NOHANG, hand back 0 as *RETPID instead of waiting.
+ */
+int proc_wait(pid_t pid, bool nohang, int *status, pid_t *retpid);
+
+/* Get the resource use of the current process's collected children. */
+void proc_getchildusage(struct rusage *ru);
+
+/*
+ * Multithreaded user processes.
+ *
+ *    proc_threadcreate - add a thread to the current process that
+ *                        starts in user mode at ENTRY with ARG as
+ *                        its argument and STACK as its stack pointer;
+ *                        hand back its thread id. TF is a kmalloc'd
+ *                        trapframe for enter_new_thread, which the
+ *                        new thread frees; on error it's the
+ *                        caller's.
+ *    proc_threadexit   - end the current thread, leaving VALUE for
+ *                        thread_join. The last one out exits the
+ *                        process with status 0.
+ *    proc_threadjoin   - wait for thread TID to exit and hand back
+ *                        its VALUE.
+ *    proc_singlethread - make every other thread in the current
+ *                        process go away, for exit and exec. Fails
+ *                        with EINTR if another thread got there
+ *                        first and is making this one go away.
+ *    proc_checkkilled  - called on the way back to user mode; if
+ *                        another thread is doing proc_singlethread,
+ *                        exit this one instead.
+ */
+int proc_threadcreate(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		      userptr_t stack, int *tid);
+__DEAD void proc_threadexit(userptr_t value);
+int proc_threadjoin(int tid, userptr_t *value);
+int proc_singlethread(void);
+void proc_checkkilled(void);
+
 /* Destroy a process. */
 void proc_destroy(struct proc *proc);
 
@@ -97,5 +195,8 @@ struct addrspace *proc_getas(void);
 /* Change the address space of the current process, and return the old one. */
 struct addrspace *proc_setas(struct addrspace *);
 
+/* Print every process's memory use and fault counts (kernel menu). */
+void proc_printvmstats(void);
+
 
 #endif /* _PROC_H_ */
@@ -62,6 +62,12 @@ void sem_destroy(struct semaphore *);
 void P(struct semaphore *);
 void V(struct semaphore *);
 
+/*
+ * P, but gives up with EINTR if the thread is killed while waiting
+ * (see thread_kill), without decrementing the count.
+ */
+int P_intr(struct semaphore *);
+
 
 /*
  * Simple lock for mutual exclusion.
@@ -139,5 +145,12 @@ void cv_wait(struct cv *cv, struct lock *lock);
 void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
 
+/*
+ * cv_wait, but returns EINTR if the thread has been killed (see
+ * thread_kill), before or while waiting; the lock is held again
+ * either way. Otherwise returns 0.
+ */
+int cv_wait_intr(struct cv *cv, struct lock *lock);
+
 
 #endif /* _SYNCH_H_ */
@@ -32,6 +32,7 @@
 
 
 #include <cdefs.h> /* for __DEAD */
+#include "opt-dumbvm.h"
 struct trapframe; /* from <machine/trapframe.h> */
 
 /*
@@ -51,12 +52,61 @@ void enter_forked_process(struct trapframe *tf);
 __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 		       vaddr_t stackptr, vaddr_t entrypoint);
 
+/* Enter user mode in a new thread. Does not return. */
+__DEAD void enter_new_thread(struct trapframe *tf, userptr_t arg,
+			     vaddr_t stackptr, vaddr_t entrypoint);
+
 
 /*
  * Prototypes for IN-KERNEL entry points for system call implementations.
+ *
+ * Caution: these are parsed by kern/conf/gensyscalltab.sh to make the
+ * system call table; see <syscalltab.h> for what it understands.
+ * Only put sys_* prototypes and preprocessor conditionals between the
+ * markers.
  */
 
+/*CALLBEGIN*/
 int sys_reboot(int code);
+int sys_fork(struct trapframe *tf, pid_t *retval);
+int sys_vfork(struct trapframe *tf, pid_t *retval);
+int sys_execv(userptr_t prog, userptr_t args);
+__DEAD void sys__exit(int code);
+int sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retval);
+int sys_getpid(pid_t *retval);
+int sys___thread_create(struct trapframe *tf, userptr_t entry, userptr_t arg,
+			userptr_t stack, int32_t *retval);
+__DEAD void sys___thread_exit(userptr_t value);
+int sys___thread_join(int tid, userptr_t value);
+int sys___futex_wait(userptr_t addr, int val);
+int sys___futex_wake(userptr_t addr, int count, int *retval);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_getrusage(int who, userptr_t usage);
+int sys_open(userptr_t path, int flags, mode_t mode, int32_t *retval);
+int sys_read(int fd, userptr_t buf, size_t size, int32_t *retval);
+int sys_write(int fd, userptr_t buf, size_t size, int32_t *retval);
+int sys_pread(int fd, userptr_t buf, size_t size, off_t pos, int32_t *retval);
+int sys_pwrite(int fd, userptr_t buf, size_t size, off_t pos,
+	       int32_t *retval);
+int sys_readv(int fd, userptr_t iov, int iovcnt, int32_t *retval);
+int sys_writev(int fd, userptr_t iov, int iovcnt, int32_t *retval);
+int sys_preadv(int fd, userptr_t iov, int iovcnt, off_t pos, int32_t *retval);
+int sys_pwritev(int fd, userptr_t iov, int iovcnt, off_t pos,
+		int32_t *retval);
+int sys_lseek(int fd, off_t pos, int whence, off_t *retval);
+int sys_close(int fd);
+int sys_dup2(int oldfd, int newfd, int32_t *retval);
+int sys_pipe(userptr_t fds);
+int sys_ioctl(int fd, int code, userptr_t data);
+int sys_splice(int fromfd, int tofd, size_t len, int32_t *retval);
+int sys_poll(userptr_t fds, unsigned nfds, int timeout, int *retval);
+#if !OPT_DUMBVM
+int sys_sbrk(intptr_t amount, int32_t *retval);
+int sys_mmap(userptr_t addr, size_t len, int prot, int flags, int fd,
+	     off_t offset, int32_t *retval);
+int sys_munmap(userptr_t addr, size_t len);
+int sys_msync(userptr_t addr, size_t len, int flags);
+#endif
+/*CALLEND*/
 
 #endif /* _SYSCALL_H_ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _SYSCALLTAB_H_
+#define _SYSCALLTAB_H_
+
+/*
+ * The system call table.
+ *
+ * syscalltab[] is indexed by call number. It's generated, as
+ * syscalltab.c in the kernel build directory, by
+ * kern/conf/gensyscalltab.sh from the numbers in <kern/syscall.h>
+ * and the sys_* prototypes in <syscall.h>. So to add a system call,
+ * write it, put its prototype in <syscall.h>, and make sure its
+ * number isn't commented out. Numbers with no prototype have a null
+ * sc_func and get ENOSYS.
+ *
+ * sc_func calls the sys_* function, converting its arguments from
+ * the 32-bit words the calling convention passes them in. The
+ * dispatcher fetches sc_nwords of those: a0-a3, then from the user
+ * stack. sc_retsize is the size in bits of the return value (0, 32,
+ * or 64); the trapframe is there for the calls that need it.
+ *
+ * The rest is statistics and tracing, kept by syscall_enter and
+ * syscall_leave. The counts aren't synchronized; they're only for
+ * reporting. Calls that don't come back (_exit, successful execv)
+ * are counted but not timed.
+ */
+
+struct trapframe;
+
+#define SYSCALL_MAXWORDS	8
+
+/*
+ * Time histogram: bucket 0 counts calls taking under
+ * 2^SYSCALL_HISTSHIFT cycles, each bucket after it twice as long,
+ * and the last everything longer.
+ */
+#define SYSCALL_HISTSHIFT	8
+#define SYSCALL_HISTSIZE	16
+
+struct syscallent {
+	const char *sc_name;
+	int (*sc_func)(struct trapframe *tf, const uint32_t *args,
+		       int64_t *retval);
+	unsigned sc_nwords;		/* argument words to fetch */
+	unsigned sc_retsize;		/* return value bits */
+
+	bool sc_trace;			/* print each call */
+	unsigned sc_calls;		/* times called */
+	unsigned sc_errors;		/* times it failed */
+	uint64_t sc_cycles;		/* total time in it */
+	unsigned sc_hist[SYSCALL_HISTSIZE];	/* calls by time */
+};
+
+extern struct syscallent syscalltab[];
+extern const unsigned syscalltab_size;
+
+/*
+ * Functions in syscallstat.c:
+ *
+ *    syscall_enter      - count a call to SC with argument words ARGS,
+ *                         and print it if it's being traced.
+ *    syscall_leave      - record that SC took CYCLES and returned ERR
+ *                         or, if ERR is 0, RETVAL.
+ *    syscall_printstats - print the counts and time histogram of
+ *                         every call that's been made.
+ *    syscall_resetstats - zero them.
+ *    syscall_settrace   - turn tracing of the call named NAME, or with
+ *                         NULL every call, on or off. ENOENT if there's
+ *                         no such call.
+ */
+void syscall_enter(struct syscallent *sc, const uint32_t *args);
+void syscall_leave(struct syscallent *sc, uint32_t cycles, int err,
+		   int64_t retval);
+void syscall_printstats(void);
+void syscall_resetstats(void);
+int syscall_settrace(const char *name, bool on);
+
+#endif /* _SYSCALLTAB_H_ */
@@ -93,15 +93,19 @@ int longstress(int, char **);
 int createstress(int, char **);
 int printfile(int, char **);
 
+/* VM tests */
+int elfbench(int, char **);
+
 /* other tests */
 int kmalloctest(int, char **);
 int kmallocstress(int, char **);
 int kmalloctest3(int, char **);
 int kmalloctest4(int, char **);
+int kmalloctest5(int, char **);
 int nettest(int, char **);
 
 /* Routine for running a user-level program. */
-int runprogram(char *progname);
+int runprogram(char *progname, char **args, unsigned nargs);
 
 /* Kernel menu system. */
 void menu(char *argstr);
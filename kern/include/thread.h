@@ -106,7 +106,18 @@ struct thread {
 	 * Public fields
 	 */
 
-	/* add more here as needed */
+	/*
+	 * Killing (thread_kill, wchan_sleep_intr). t_killlock
+	 * protects the rest; it comes after the spinlock of whatever
+	 * the thread sleeps on, and nothing comes after it.
+	 */
+	struct spinlock t_killlock;
+	bool t_killed;			/* interruptible sleeps fail */
+	struct wchan *t_sleepwchan;	/* where it sleeps interruptibly */
+	struct spinlock *t_sleeplock;	/* that channel's spinlock */
+	unsigned t_sleeppins;		/* thread_kills still using them */
+
+	struct thread *t_procnext;	/* next in t_proc's list (proc.c) */
 };
 
 /*
@@ -169,5 +180,14 @@ void schedule(void);
  */
 void thread_consider_migration(void);
 
+/*
+ * Kill thread T: from now on wchan_sleep_intr fails with EINTR for
+ * it, and if it's asleep there now it's woken (along with whoever
+ * else is on the same channel). It's up to T to go away after that.
+ * The caller must keep T from exiting during the call, and must not
+ * hold the spinlock of any channel T might sleep on.
+ */
+void thread_kill(struct thread *t);
+
 
 #endif /* _THREAD_H_ */
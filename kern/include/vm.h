@@ -37,6 +37,7 @@
  */
 
 
+#include <kern/time.h>
 #include <machine/vm.h>
 
 /* Fault-type arguments to vm_fault() */
@@ -55,8 +56,105 @@ int vm_fault(int faulttype, vaddr_t faultaddress);
 vaddr_t alloc_kpages(unsigned npages);
 void free_kpages(vaddr_t addr);
 
+/*
+ * Reference counts on single frames (paddrs), for pages shared
+ * between address spaces. alloc_kpages(1) returns a frame with one
+ * reference; frame_decref frees the frame when the count reaches
+ * zero and returns the new count. frame_unmap is frame_decref for
+ * the reference AS holds by mapping the frame (see frame_setowner).
+ */
+struct addrspace;
+
+void frame_incref(paddr_t paddr);
+unsigned frame_decref(paddr_t paddr);
+unsigned frame_unmap(paddr_t paddr, struct addrspace *as);
+unsigned frame_refcount(paddr_t paddr);
+
+/*
+ * Pre-zeroed frames.
+ *
+ *    alloc_zeroed_kpage - alloc_kpages(1), but zero-filled; cheap when
+ *                         the VM system's zeroing thread has got ahead.
+ *    frame_prezero      - zero a free frame for later. Returns false if
+ *                         enough are waiting or there's nothing free.
+ *    frame_nzeroed      - number of zeroed frames waiting, at most
+ *                         ZERO_POOL_SIZE.
+ *    frame_printstats   - print how many allocations found one.
+ */
+#define ZERO_POOL_SIZE 64
+
+vaddr_t alloc_zeroed_kpage(void);
+bool frame_prezero(void);
+unsigned frame_nzeroed(void);
+void frame_printstats(void);
+
+/*
+ * Frame table support for page replacement (see vm/vm.c).
+ *
+ *    frame_setowner   - record (or with AS NULL, clear) the address
+ *                       space and address mapping an unshared frame.
+ *                       For a shared one, remember AS as a mapper,
+ *                       to become the owner if the others unmap it.
+ *    frame_getslot    - return the swap slot holding a clean copy of
+ *                       the frame's page, or SWAP_NOSLOT.
+ *    frame_setslot    - set the same.
+ *    frame_nextvictim - advance the clock hand to the next frame with
+ *                       an owner; 0 if there are none.
+ *    frame_nfree      - number of free frames.
+ *    frame_nframes    - number of frames the allocator manages.
+ */
+#define SWAP_NOSLOT ((unsigned)-1)
+
+void frame_setowner(paddr_t paddr, struct addrspace *as, vaddr_t vaddr);
+unsigned frame_getslot(paddr_t paddr);
+void frame_setslot(paddr_t paddr, unsigned slot);
+paddr_t frame_nextvictim(struct addrspace **as, vaddr_t *vaddr);
+unsigned frame_nfree(void);
+unsigned frame_nframes(void);
+
 /* TLB shootdown handling called from interprocessor_interrupt */
+void vm_tlbshootdown_all(void);
 void vm_tlbshootdown(const struct tlbshootdown *);
 
+/*
+ * Print VM and TLB statistics (kernel menu). For the TLB miss and
+ * vm_fault rates over a program run, take a vm_sample before it and
+ * pass it to vm_printrates after.
+ */
+struct vmsample {
+	unsigned vs_misses;		/* user TLB misses */
+	unsigned vs_faults;		/* of those, handled by vm_fault */
+	struct timespec vs_when;
+};
+
+void vm_printstats(void);
+void vm_sample(struct vmsample *vs);
+void vm_printrates(const struct vmsample *since);
+
+/* File V was written or truncated; forget any pages cached from it */
+struct vnode;
+void vm_filechanged(struct vnode *v);
+
+/*
+ * Kernel virtual-address arena (in kseg2 on mips), used by kmalloc
+ * for large allocations so they need not be physically contiguous.
+ *
+ *    kva_alloc   - allocate NPAGES virtually contiguous pages.
+ *                  Returns 0 on failure.
+ *    kva_free    - free an allocation made by kva_alloc. Waits for
+ *                  the other CPUs to drop their mappings, so it
+ *                  can't be called with a spinlock held.
+ *    kva_fault   - load the TLB mapping for an address in the arena;
+ *                  called from vm_fault.
+ *    kva_tlbshootdown - handle a shootdown for arena addresses.
+ *
+ * Whether an address belongs to the arena is tested with KVA_OWNS().
+ */
+vaddr_t kva_alloc(unsigned npages);
+void kva_free(vaddr_t addr);
+int kva_fault(vaddr_t faultaddress);
+void kva_tlbshootdown(const struct tlbshootdown *ts);
+void kva_printstats(void);
+
 
 #endif /* _VM_H_ */
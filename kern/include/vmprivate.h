@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _VMPRIVATE_H_
+#define _VMPRIVATE_H_
+
+#include <spinlock.h>
+#include <pagetable.h>
+
+/*
+ * Subsystem-private VM defs.
+ *
+ * This file is to be used only by the VM system (kern/vm and the
+ * machine-dependent VM code). Like threadprivate.h, it lives in the
+ * public include directory only so both halves can get at it.
+ */
+
+/*
+ * TLB management (vm.c).
+ *
+ *     vm_tlbload       - load a mapping for VADDR in the running
+ *                        address space into the TLB on this CPU,
+ *                        replacing any existing entry.
+ *     vm_tlbinvalidate - drop any entry for VADDR with address
+ *                        space ID PID on this CPU.
+ *     vm_tlbflush      - drop every entry on this CPU.
+ *     vm_tlbflushas    - drop every entry for address space AS, on
+ *                        every CPU, for when other threads of the
+ *                        process may be running in it elsewhere.
+ *     vm_tlbactivate   - switch this CPU to address space AS (or with
+ *                        NULL, none): give it an address space ID if
+ *                        need be and point the refill handler at its
+ *                        page table.
+ */
+struct addrspace;
+
+void vm_tlbload(vaddr_t vaddr, pte_t pte);
+void vm_tlbinvalidate(vaddr_t vaddr, uint32_t pid);
+void vm_tlbflush(void);
+void vm_tlbflushas(struct addrspace *as);
+void vm_tlbactivate(struct addrspace *as);
+
+/*
+ * Page management (vm.c).
+ *
+ *     vm_newpage  - get a zero-filled frame for a user page and hand
+ *                   back a valid PTE for it (without PTE_DIRTY). May
+ *                   page something else out to make room.
+ *     vm_freepage - release the frame or swap slot a PTE of AS refers
+ *                   to. AS is NULL for a page that was never mapped.
+ *     vm_pagewait - wait for a PTE_BUSY page to finish moving.
+ *     vm_swapin   - bring the page *PTEP of AS refers to in from
+ *                   swap. Drops vm_ptlock to do the I/O.
+ *     vm_syncpage - write a page of a MAP_SHARED mapping back to its
+ *                   file, if it has been changed.
+ *     vm_droppage - discard a page and its TLB entries.
+ *     vm_pinpage  - if a page can be accessed without faulting, mark
+ *                   it busy and return its frame, for copyin/copyout
+ *                   to use directly. Otherwise return false.
+ *     vm_unpinpage - undo vm_pinpage.
+ *     vm_rssadjust - add DELTA (which may be negative) to the count
+ *                   of AS's pages in core, for statistics.
+ *
+ * Page table entries of all address spaces are protected by
+ * vm_ptlock, because the page replacement code changes entries of
+ * address spaces other than its own. The address space lock just
+ * serializes faults and region changes. Hold vm_ptlock to call
+ * vm_freepage, vm_pagewait, and vm_swapin, but not vm_newpage. Hold
+ * the address space lock, but not vm_ptlock, to call vm_syncpage and
+ * vm_droppage. Hold neither to call vm_pinpage and vm_unpinpage.
+ * Hold vm_ptlock to call vm_rssadjust.
+ */
+extern struct spinlock vm_ptlock;
+struct region;
+
+int vm_newpage(pte_t *ret);
+void vm_freepage(struct addrspace *as, pte_t pte);
+void vm_pagewait(void);
+int vm_swapin(struct addrspace *as, vaddr_t vaddr, pte_t *ptep);
+int vm_syncpage(struct addrspace *as, struct region *rg, vaddr_t vaddr);
+void vm_droppage(struct addrspace *as, vaddr_t vaddr);
+bool vm_pinpage(struct addrspace *as, vaddr_t vaddr, bool write,
+		paddr_t *ret);
+void vm_unpinpage(struct addrspace *as, vaddr_t vaddr);
+void vm_rssadjust(struct addrspace *as, int delta);
+
+/*
+ * Swap space (swap.c).
+ *
+ *     swap_bootstrap - attach the swap device, if there is one.
+ *     swap_alloc     - allocate a swap slot. ENOSPC if there's none.
+ *     swap_free      - release a slot.
+ *     swap_in        - read a slot into a physical frame.
+ *     swap_out       - write a physical frame to a slot.
+ */
+void swap_bootstrap(void);
+int swap_alloc(unsigned *slot);
+void swap_free(unsigned slot);
+int swap_in(unsigned slot, paddr_t frame);
+int swap_out(unsigned slot, paddr_t frame);
+
+/*
+ * Shared pages of program text (textcache.c).
+ *
+ *     textcache_lookup     - find the frame caching the page of file V
+ *                            at OFFSET whose bytes [LO, HI) are from
+ *                            the file, and take a reference to it.
+ *                            Returns 0 if there isn't one.
+ *     textcache_insert     - cache a newly read page, or if another
+ *                            thread beat us to it, switch *FRAMEP to
+ *                            its frame.
+ *     textcache_release    - drop a reference to a cached frame; use
+ *                            instead of frame_unmap on PTE_CACHED
+ *                            pages. May be called with vm_ptlock
+ *                            held, so it leaves the entry for...
+ *     textcache_reap       - ...this, which drops the vnode
+ *                            references of released entries. Call
+ *                            with no spinlocks held.
+ *     textcache_invalidate - forget the pages cached from file V.
+ *     textcache_printstats - print hit counts.
+ */
+struct vnode;
+
+paddr_t textcache_lookup(struct vnode *v, off_t offset,
+			 unsigned lo, unsigned hi);
+int textcache_insert(struct vnode *v, off_t offset, unsigned lo, unsigned hi,
+		     paddr_t *framep);
+void textcache_release(paddr_t frame, struct addrspace *as);
+void textcache_reap(void);
+void textcache_invalidate(struct vnode *v);
+void textcache_printstats(void);
+
+#endif /* _VMPRIVATE_H_ */
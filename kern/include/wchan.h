@@ -66,6 +66,14 @@ bool wchan_isempty(struct wchan *wc, struct spinlock *lk);
  */
 void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * The same, but interruptible: if the current thread has been killed
+ * (thread_kill), before or during the sleep, returns EINTR instead of
+ * 0. Either way the lock is held again on return, though it may have
+ * been dropped more than once in between.
+ */
+int wchan_sleep_intr(struct wchan *wc, struct spinlock *lk);
+
 /*
  * Wake up one thread, or all threads, sleeping on a wait channel.
  * The associated spinlock should be locked.
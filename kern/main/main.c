@@ -40,6 +40,7 @@
 #include <clock.h>
 #include <thread.h>
 #include <proc.h>
+#include <futex.h>
 #include <current.h>
 #include <synch.h>
 #include <vm.h>
@@ -109,6 +110,7 @@ boot(void)
 	/* Early initialization. */
 	ram_bootstrap();
 	proc_bootstrap();
+	futex_bootstrap();
 	thread_bootstrap();
 	hardclock_bootstrap();
 	vfs_bootstrap();
@@ -31,6 +31,7 @@
 #include <kern/errno.h>
 #include <kern/reboot.h>
 #include <kern/unistd.h>
+#include <kern/wait.h>
 #include <limits.h>
 #include <lib.h>
 #include <uio.h>
@@ -39,9 +40,11 @@
 #include <synch.h>
 #include <thread.h>
 #include <proc.h>
+#include <vm.h>
 #include <vfs.h>
 #include <sfs.h>
 #include <syscall.h>
+#include <syscalltab.h>
 #include "opt-synchprobs.h"
 #include "opt-sfs.h"
 #include "opt-net.h"
@@ -61,11 +64,7 @@
 
 /*
  * Function for a thread that runs an arbitrary userlevel program by
- * name.
- *
- * Note: this cannot pass arguments to the program. You may wish to
- * change it so it can, because that will make testing much easier
- * in the future.
+ * name, with the rest of the command line as its arguments.
  *
  * It copies the program name because runprogram destroys the copy
  * it gets by passing it to vfs_open().
@@ -80,20 +79,16 @@ cmd_progthread(void *ptr, unsigned long nargs)
 
 	KASSERT(nargs >= 1);
 
-	if (nargs > 2) {
-		kprintf("Warning: argument passing from menu not supported\n");
-	}
-
 	/* Hope we fit. */
 	KASSERT(strlen(args[0]) < sizeof(progname));
 
 	strcpy(progname, args[0]);
 
-	result = runprogram(progname);
+	result = runprogram(progname, args, nargs);
 	if (result) {
 		kprintf("Running program %s failed: %s\n", args[0],
 			strerror(result));
-		return;
+		proc_exit(_MKWAIT_EXIT(1));
 	}
 
 	/* NOTREACHED: runprogram only returns on error. */
@@ -102,20 +97,18 @@ cmd_progthread(void *ptr, unsigned long nargs)
 /*
  * Common code for cmd_prog and cmd_shell.
  *
- * Note that this does not wait for the subprogram to finish, but
- * returns immediately to the menu. This is usually not what you want,
- * so you should have it call your system-calls-assignment waitpid
- * code after forking.
- *
- * Also note that because the subprogram's thread uses the "args"
- * array and strings, until you do this a race condition exists
- * between that code and the menu input code.
+ * The new process is a child of kproc, and this waits for it to
+ * finish before going back to the menu. (That also keeps the menu
+ * input code from reusing the "args" array and strings while the
+ * subprogram's thread is still using them.)
  */
 static
 int
 common_prog(int nargs, char **args)
 {
 	struct proc *proc;
+	pid_t pid;
+	int status;
 	int result;
 
 	/* Create a process for the new program to run in. */
@@ -123,6 +116,7 @@ common_prog(int nargs, char **args)
 	if (proc == NULL) {
 		return ENOMEM;
 	}
+	pid = proc->p_pid;
 
 	result = thread_fork(args[0] /* thread name */,
 			proc /* new process */,
@@ -134,10 +128,17 @@ common_prog(int nargs, char **args)
 		return result;
 	}
 
-	/*
-	 * The new process will be destroyed when the program exits...
-	 * once you write the code for handling that.
-	 */
+	result = proc_wait(pid, false, &status, &pid);
+	if (result) {
+		kprintf("waitpid failed: %s\n", strerror(result));
+		return result;
+	}
+	if (WIFSIGNALED(status)) {
+		kprintf("%s: signal %d\n", args[0], WTERMSIG(status));
+	}
+	else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+		kprintf("%s: exit %d\n", args[0], WEXITSTATUS(status));
+	}
 
 	return 0;
 }
@@ -466,6 +467,87 @@ cmd_kheapstats(int nargs, char **args)
 	return 0;
 }
 
+/*
+ * "vm" prints the VM statistics; "vm p program [arguments]" runs the
+ * program and prints the TLB miss rates over its run.
+ */
+static
+int
+cmd_vmstats(int nargs, char **args)
+{
+	struct vmsample vs;
+	int result;
+
+	if (nargs == 1) {
+		vm_printstats();
+		return 0;
+	}
+	if (nargs < 3 || strcmp(args[1], "p") != 0) {
+		kprintf("Usage: vm [p program [arguments]]\n");
+		return EINVAL;
+	}
+
+	vm_sample(&vs);
+	result = common_prog(nargs - 2, args + 2);
+	vm_printrates(&vs);
+	return result;
+}
+
+static
+int
+cmd_vmprocs(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	proc_printvmstats();
+
+	return 0;
+}
+
+static
+int
+cmd_syscallstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		syscall_printstats();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		syscall_resetstats();
+	}
+	else {
+		kprintf("Usage: syscallstat [reset]\n");
+	}
+
+	return 0;
+}
+
+static
+int
+cmd_strace(int nargs, char **args)
+{
+	bool on;
+	int i;
+
+	if (nargs < 2 || (strcmp(args[1], "on") && strcmp(args[1], "off"))) {
+		kprintf("Usage: strace on|off [call...]\n");
+		return EINVAL;
+	}
+	on = !strcmp(args[1], "on");
+
+	if (nargs == 2) {
+		syscall_settrace(NULL, on);
+		return 0;
+	}
+	for (i=2; i<nargs; i++) {
+		if (syscall_settrace(args[i], on)) {
+			kprintf("strace: No system call %s\n", args[i]);
+		}
+	}
+
+	return 0;
+}
+
 static
 int
 cmd_kheapgeneration(int nargs, char **args)
@@ -561,6 +643,7 @@ static const char *testmenu[] = {
 	"[km2] kmalloc stress test           ",
 	"[km3] Large kmalloc test            ",
 	"[km4] Multipage kmalloc test        ",
+	"[km5] Fragmented large kmalloc test ",
 	"[tt1] Thread test 1                 ",
 	"[tt2] Thread test 2                 ",
 	"[tt3] Thread test 3                 ",
@@ -578,6 +661,7 @@ static const char *testmenu[] = {
 	"[fs4] FS write stress 2             ",
 	"[fs5] FS long stress                ",
 	"[fs6] FS create stress              ",
+	"[elf] ELF load benchmark            ",
 	NULL
 };
 
@@ -605,6 +689,10 @@ static const char *mainmenu[] = {
 	"[kh] Kernel heap stats              ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[vm] VM and TLB stats [p prog args] ",
+	"[vmp] Per-process memory use        ",
+	"[syscallstat] Syscall stats [reset] ",
+	"[strace] Trace syscalls on|off [..] ",
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -663,6 +751,10 @@ static struct {
 	{ "kh",         cmd_kheapstats },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "vm",         cmd_vmstats },
+	{ "vmp",        cmd_vmprocs },
+	{ "syscallstat", cmd_syscallstat },
+	{ "strace",     cmd_strace },
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -673,6 +765,7 @@ static struct {
 	{ "km2",	kmallocstress },
 	{ "km3",	kmalloctest3 },
 	{ "km4",	kmalloctest4 },
+	{ "km5",	kmalloctest5 },
 #if OPT_NET
 	{ "net",	nettest },
 #endif
@@ -718,6 +811,9 @@ static struct {
 	{ "fs5",	longstress },
 	{ "fs6",	createstress },
 
+	/* VM tests */
+	{ "elf",	elfbench },
+
 	{ NULL, NULL }
 };
 
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Futex wait queues.
+ *
+ * Waiting threads are kept in a hash table keyed by address space
+ * and user address. Each bucket has a sleep lock (since futex_wait
+ * has to copyin the word, which can fault, while holding it), a list
+ * of waiters, and one CV they all sleep on. futex_wake takes the
+ * waiters it wakes off the list and marks them, then broadcasts;
+ * anyone else on the same bucket just goes back to sleep. With
+ * enough buckets that's rare.
+ *
+ * Checking the word and going on the list happen under the bucket
+ * lock, and so does futex_wake, so a wake that follows a change to
+ * the word can't slip in between the check and the sleep.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <proc.h>
+#include <futex.h>
+
+#define FUTEX_BUCKETS	64
+
+/*
+ * One waiting thread. It lives on the waiter's stack.
+ */
+struct futexwaiter {
+	struct addrspace *fw_as;
+	userptr_t fw_addr;
+	bool fw_woken;
+	struct futexwaiter *fw_next;
+};
+
+struct futexbucket {
+	struct lock *fb_lock;
+	struct cv *fb_cv;
+	struct futexwaiter *fb_waiters;
+};
+
+static struct futexbucket futextable[FUTEX_BUCKETS];
+
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_BUCKETS; i++) {
+		futextable[i].fb_lock = lock_create("futex");
+		futextable[i].fb_cv = cv_create("futex");
+		if (futextable[i].fb_lock == NULL ||
+		    futextable[i].fb_cv == NULL) {
+			panic("futex_bootstrap: Out of memory\n");
+		}
+		futextable[i].fb_waiters = NULL;
+	}
+}
+
+/*
+ * Pick the bucket for ADDR in AS. Multiplicative hashing, so that
+ * words close together spread out.
+ */
+static
+struct futexbucket *
+futex_bucket(struct addrspace *as, userptr_t addr)
+{
+	uint32_t key;
+
+	key = ((vaddr_t)addr / sizeof(int)) ^ ((vaddr_t)as / sizeof(void *));
+	key *= 2654435761U;
+	return &futextable[(key >> 16) % FUTEX_BUCKETS];
+}
+
+/*
+ * Take W off the list of bucket FB. Call with the bucket lock held.
+ */
+static
+void
+futex_unlink(struct futexbucket *fb, struct futexwaiter *w)
+{
+	struct futexwaiter **wp;
+
+	for (wp = &fb->fb_waiters; *wp != w; wp = &(*wp)->fw_next) {
+		KASSERT(*wp != NULL);
+	}
+	*wp = w->fw_next;
+}
+
+int
+futex_wait(userptr_t addr, int val)
+{
+	struct futexwaiter w;
+	struct futexbucket *fb;
+	int cur, result;
+
+	if ((vaddr_t)addr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+
+	w.fw_as = proc_getas();
+	w.fw_addr = addr;
+	w.fw_woken = false;
+	fb = futex_bucket(w.fw_as, addr);
+
+	lock_acquire(fb->fb_lock);
+	result = copyin(addr, &cur, sizeof(cur));
+	if (result) {
+		lock_release(fb->fb_lock);
+		return result;
+	}
+	if (cur != val) {
+		lock_release(fb->fb_lock);
+		return EAGAIN;
+	}
+
+	w.fw_next = fb->fb_waiters;
+	fb->fb_waiters = &w;
+	while (!w.fw_woken) {
+		result = cv_wait_intr(fb->fb_cv, fb->fb_lock);
+		if (result && !w.fw_woken) {
+			futex_unlink(fb, &w);
+			lock_release(fb->fb_lock);
+			return result;
+		}
+	}
+	lock_release(fb->fb_lock);
+	return 0;
+}
+
+int
+futex_wake(userptr_t addr, int count, int *woken)
+{
+	struct addrspace *as;
+	struct futexbucket *fb;
+	struct futexwaiter **wp, *w;
+	int n;
+
+	if ((vaddr_t)addr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+
+	as = proc_getas();
+	fb = futex_bucket(as, addr);
+	n = 0;
+
+	lock_acquire(fb->fb_lock);
+	wp = &fb->fb_waiters;
+	while (*wp != NULL && n < count) {
+		w = *wp;
+		if (w->fw_as == as && w->fw_addr == addr) {
+			*wp = w->fw_next;
+			w->fw_woken = true;
+			n++;
+		}
+		else {
+			wp = &w->fw_next;
+		}
+	}
+	if (n > 0) {
+		cv_broadcast(fb->fb_cv, fb->fb_lock);
+	}
+	lock_release(fb->fb_lock);
+
+	*woken = n;
+	return 0;
+}
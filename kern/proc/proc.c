@@ -38,22 +38,251 @@
  * things they point to. Rearrange this (and/or change it to be a
  * regular lock) as needed.
  *
- * Unless you're implementing multithreaded user processes, the only
- * process that will have more than one thread is the kernel process.
+ * Besides the kernel process, a user process can have more than one
+ * thread: each user thread has a kernel thread of its own, and they
+ * share the process's address space and file table.
  */
 
 #include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/wait.h>
+#include <limits.h>
 #include <spl.h>
+#include <synch.h>
+#include <wchan.h>
+#include <thread.h>
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
 #include <vnode.h>
+#include <filetable.h>
+#include <syscall.h>
+#include "opt-dumbvm.h"
 
 /*
  * The process for the kernel; this holds all the kernel-only threads.
  */
 struct proc *kproc;
 
+/*
+ * The process table, indexed by pid.
+ *
+ * PID p lives in slot (p - PID_MIN) % PROCS_MAX. Each time a slot is
+ * reused its pid goes up by PROCS_MAX (going back to the bottom once
+ * it would pass PID_MAX), so a pid isn't handed out again right after
+ * it's freed. The free slots are on a FIFO list threaded through the
+ * table, so getting and freeing a pid, and looking one up, take
+ * constant time no matter how many processes there are; taking the
+ * oldest free slot puts off reusing any one pid as long as possible.
+ *
+ * kproc has no slot and no pid.
+ *
+ * proctable_lock protects the table and also the family fields of
+ * every process (p_pid through p_childusage; see proc.h). It's a sleep
+ * lock so waitpid can wait on a child's p_exitcv with it.
+ */
+struct procslot {
+	struct proc *ps_proc;	/* the process, or NULL if free */
+	pid_t ps_pid;		/* its pid, or the next one to use if free */
+	int ps_nextfree;	/* next free slot, or -1 */
+};
+
+static struct procslot proctable[PROCS_MAX];
+static int proctable_freehead, proctable_freetail;
+static struct lock *proctable_lock;
+
+/*
+ * Record of a thread made by thread_create, kept on p_threads until
+ * thread_join collects it. (The thread a process starts with has
+ * none and can't be joined.)
+ */
+struct uthread {
+	int ut_tid;			/* thread id */
+	struct thread *ut_thread;	/* the thread, until it exits */
+	bool ut_exited;			/* true once it has */
+	userptr_t ut_value;		/* what it passed to thread_exit */
+	struct uthread *ut_next;	/* next on p_threads */
+};
+
+/*
+ * Set up the table with every slot free, in order.
+ */
+static
+void
+proctable_init(void)
+{
+	int i;
+
+	KASSERT(PROCS_MAX <= PID_MAX - PID_MIN + 1);
+
+	for (i=0; i<PROCS_MAX; i++) {
+		proctable[i].ps_proc = NULL;
+		proctable[i].ps_pid = PID_MIN + i;
+		proctable[i].ps_nextfree = i + 1;
+	}
+	proctable[PROCS_MAX - 1].ps_nextfree = -1;
+	proctable_freehead = 0;
+	proctable_freetail = PROCS_MAX - 1;
+
+	proctable_lock = lock_create("proctable");
+	if (proctable_lock == NULL) {
+		panic("proc_bootstrap: lock_create failed\n");
+	}
+}
+
+/*
+ * Give PROC a pid. Call with proctable_lock held.
+ */
+static
+int
+proctable_add(struct proc *proc)
+{
+	struct procslot *ps;
+	int slot;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+	KASSERT(proc->p_pid == 0);
+
+	slot = proctable_freehead;
+	if (slot < 0) {
+		return ENPROC;
+	}
+	ps = &proctable[slot];
+	proctable_freehead = ps->ps_nextfree;
+	if (proctable_freehead < 0) {
+		proctable_freetail = -1;
+	}
+
+	KASSERT(ps->ps_proc == NULL);
+	ps->ps_proc = proc;
+	ps->ps_nextfree = -1;
+	proc->p_pid = ps->ps_pid;
+	return 0;
+}
+
+/*
+ * Take PROC's pid away, if it has one. Call with proctable_lock held.
+ */
+static
+void
+proctable_remove(struct proc *proc)
+{
+	struct procslot *ps;
+	int slot;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+
+	if (proc->p_pid == 0) {
+		return;
+	}
+	slot = (proc->p_pid - PID_MIN) % PROCS_MAX;
+	ps = &proctable[slot];
+	KASSERT(ps->ps_proc == proc);
+	KASSERT(ps->ps_pid == proc->p_pid);
+
+	ps->ps_proc = NULL;
+	ps->ps_pid += PROCS_MAX;
+	if (ps->ps_pid > PID_MAX) {
+		ps->ps_pid = PID_MIN + slot;
+	}
+	if (proctable_freetail < 0) {
+		proctable_freehead = slot;
+	}
+	else {
+		proctable[proctable_freetail].ps_nextfree = slot;
+	}
+	proctable_freetail = slot;
+	proc->p_pid = 0;
+}
+
+/*
+ * Find the process with pid PID, or NULL if there isn't one. Call
+ * with proctable_lock held.
+ */
+static
+struct proc *
+proctable_get(pid_t pid)
+{
+	struct procslot *ps;
+
+	KASSERT(lock_do_i_hold(proctable_lock));
+
+	if (pid < PID_MIN || pid > PID_MAX) {
+		return NULL;
+	}
+	ps = &proctable[(pid - PID_MIN) % PROCS_MAX];
+	if (ps->ps_proc == NULL || ps->ps_pid != pid) {
+		return NULL;
+	}
+	return ps->ps_proc;
+}
+
+/*
+ * Make KID a child of PARENT. Call with proctable_lock held.
+ */
+static
+void
+proc_addchild(struct proc *parent, struct proc *kid)
+{
+	KASSERT(lock_do_i_hold(proctable_lock));
+	KASSERT(kid->p_parent == NULL);
+
+	kid->p_parent = parent;
+	kid->p_prevsib = NULL;
+	kid->p_nextsib = parent->p_children;
+	if (parent->p_children != NULL) {
+		parent->p_children->p_prevsib = kid;
+	}
+	parent->p_children = kid;
+}
+
+/*
+ * Take KID off its parent's list of children, if it has a parent.
+ * Call with proctable_lock held.
+ */
+static
+void
+proc_remchild(struct proc *kid)
+{
+	KASSERT(lock_do_i_hold(proctable_lock));
+
+	if (kid->p_parent == NULL) {
+		return;
+	}
+	if (kid->p_prevsib != NULL) {
+		kid->p_prevsib->p_nextsib = kid->p_nextsib;
+	}
+	else {
+		KASSERT(kid->p_parent->p_children == kid);
+		kid->p_parent->p_children = kid->p_nextsib;
+	}
+	if (kid->p_nextsib != NULL) {
+		kid->p_nextsib->p_prevsib = kid->p_prevsib;
+	}
+	kid->p_parent = NULL;
+	kid->p_nextsib = NULL;
+	kid->p_prevsib = NULL;
+}
+
+/*
+ * Add the resource use in FROM to TO.
+ */
+static
+void
+rusage_add(struct rusage *to, const struct rusage *from)
+{
+	if (from->ru_maxrss > to->ru_maxrss) {
+		to->ru_maxrss = from->ru_maxrss;
+	}
+	to->ru_minflt += from->ru_minflt;
+	to->ru_majflt += from->ru_majflt;
+	to->ru_ncow += from->ru_ncow;
+	to->ru_nswapin += from->ru_nswapin;
+	to->ru_nprefault += from->ru_nprefault;
+}
+
 /*
  * Create a proc structure.
  */
@@ -72,8 +301,34 @@ proc_create(const char *name)
 		kfree(proc);
 		return NULL;
 	}
+	proc->p_exitcv = cv_create(name);
+	if (proc->p_exitcv == NULL) {
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+	proc->p_threadlock = lock_create(name);
+	proc->p_threadcv = cv_create(name);
+	proc->p_threadwchan = wchan_create(name);
+	if (proc->p_threadlock == NULL || proc->p_threadcv == NULL ||
+	    proc->p_threadwchan == NULL) {
+		if (proc->p_threadwchan != NULL) {
+			wchan_destroy(proc->p_threadwchan);
+		}
+		if (proc->p_threadcv != NULL) {
+			cv_destroy(proc->p_threadcv);
+		}
+		if (proc->p_threadlock != NULL) {
+			lock_destroy(proc->p_threadlock);
+		}
+		cv_destroy(proc->p_exitcv);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
 
 	proc->p_numthreads = 0;
+	proc->p_threadlist = NULL;
 	spinlock_init(&proc->p_lock);
 
 	/* VM fields */
@@ -81,41 +336,71 @@ proc_create(const char *name)
 
 	/* VFS fields */
 	proc->p_cwd = NULL;
+	proc->p_filetable = NULL;
+
+	/* Process table and family */
+	proc->p_pid = 0;
+	proc->p_parent = NULL;
+	proc->p_children = NULL;
+	proc->p_nextsib = NULL;
+	proc->p_prevsib = NULL;
+	proc->p_vfork = false;
+	proc->p_exited = false;
+	proc->p_exitstatus = 0;
+	bzero(&proc->p_usage, sizeof(proc->p_usage));
+	bzero(&proc->p_childusage, sizeof(proc->p_childusage));
+
+	/* User threads: just the one that will run the program */
+	proc->p_threads = NULL;
+	proc->p_nexttid = 1;
+	proc->p_userthreads = 1;
+	proc->p_survivor = NULL;
 
 	return proc;
 }
 
 /*
- * Destroy a proc structure.
- *
- * Note: nothing currently calls this. Your wait/exit code will
- * probably want to do so.
+ * Free the current process's thread records, for exit and exec once
+ * the other threads are gone, and for proc_destroy. Call with
+ * p_threadlock held.
  */
+static
 void
-proc_destroy(struct proc *proc)
+proc_freethreads(struct proc *proc)
 {
-	/*
-	 * You probably want to destroy and null out much of the
-	 * process (particularly the address space) at exit time if
-	 * your wait/exit design calls for the process structure to
-	 * hang around beyond process exit. Some wait/exit designs
-	 * do, some don't.
-	 */
+	struct uthread *ut;
 
-	KASSERT(proc != NULL);
-	KASSERT(proc != kproc);
+	while (proc->p_threads != NULL) {
+		ut = proc->p_threads;
+		proc->p_threads = ut->ut_next;
+		kfree(ut);
+	}
+}
 
-	/*
-	 * We don't take p_lock in here because we must have the only
-	 * reference to this structure. (Otherwise it would be
-	 * incorrect to destroy it.)
-	 */
+/*
+ * Give back a process's address space, open files, and current
+ * directory. This happens at exit, since the process structure
+ * hangs around until its parent collects the exit status, or at
+ * destroy time if the process never ran.
+ */
+static
+void
+proc_freeresources(struct proc *proc)
+{
+	struct filetable *ft;
 
 	/* VFS fields */
 	if (proc->p_cwd) {
 		VOP_DECREF(proc->p_cwd);
 		proc->p_cwd = NULL;
 	}
+	spinlock_acquire(&proc->p_lock);
+	ft = proc->p_filetable;
+	proc->p_filetable = NULL;
+	spinlock_release(&proc->p_lock);
+	if (ft != NULL) {
+		filetable_destroy(ft);
+	}
 
 	/* VM fields */
 	if (proc->p_addrspace) {
@@ -162,12 +447,58 @@ proc_destroy(struct proc *proc)
 			as = proc->p_addrspace;
 			proc->p_addrspace = NULL;
 		}
+#if !OPT_DUMBVM
+		DEBUG(DB_VM, "%s: %u minor and %u major faults, "
+		      "%u pages mapped by fault-around, max RSS %u pages\n",
+		      proc->p_name, as->as_minflt, as->as_majflt,
+		      as->as_nprefaults, as->as_maxrss);
+#endif
 		as_destroy(as);
 	}
+}
+
+/*
+ * Destroy a proc structure.
+ *
+ * This is called when a process that exited is collected (or when
+ * its parent exits without collecting it), and when a new process
+ * couldn't be set up. By the time a process has exited, proc_exit
+ * has already given back its address space and files.
+ */
+void
+proc_destroy(struct proc *proc)
+{
+	KASSERT(proc != NULL);
+	KASSERT(proc != kproc);
+
+	/*
+	 * We don't take p_lock in here because we must have the only
+	 * reference to this structure. (Otherwise it would be
+	 * incorrect to destroy it.) Except for proc_printvmstats,
+	 * which the process table lock keeps out once we're no
+	 * longer in the table.
+	 */
+	lock_acquire(proctable_lock);
+	proc_remchild(proc);
+	proctable_remove(proc);
+	if (proc->p_vfork) {
+		/* A vfork child that never ran; this is its parent's. */
+		proc->p_addrspace = NULL;
+		proc->p_vfork = false;
+	}
+	lock_release(proctable_lock);
+	KASSERT(proc->p_children == NULL);
+
+	proc_freeresources(proc);
 
-	KASSERT(proc->p_numthreads == 0);
+	KASSERT(proc->p_numthreads == 0 && proc->p_threadlist == NULL);
 	spinlock_cleanup(&proc->p_lock);
 
+	proc_freethreads(proc);
+	wchan_destroy(proc->p_threadwchan);
+	cv_destroy(proc->p_threadcv);
+	lock_destroy(proc->p_threadlock);
+	cv_destroy(proc->p_exitcv);
 	kfree(proc->p_name);
 	kfree(proc);
 }
@@ -178,6 +509,8 @@ proc_destroy(struct proc *proc)
 void
 proc_bootstrap(void)
 {
+	proctable_init();
+
 	kproc = proc_create("[kernel]");
 	if (kproc == NULL) {
 		panic("proc_create for kproc failed\n");
@@ -187,25 +520,45 @@ proc_bootstrap(void)
 /*
  * Create a fresh proc for use by runprogram.
  *
- * It will have no address space and will inherit the current
- * process's (that is, the kernel menu's) current directory.
+ * It will have no address space and no open files, and will inherit
+ * the current process's (that is, the kernel menu's) current
+ * directory.
  */
 struct proc *
 proc_create_runprogram(const char *name)
 {
 	struct proc *newproc;
+	int result;
 
 	newproc = proc_create(name);
 	if (newproc == NULL) {
 		return NULL;
 	}
 
+	/* It's a child of kproc; the menu waits for it. */
+	lock_acquire(proctable_lock);
+	result = proctable_add(newproc);
+	if (result == 0) {
+		proc_addchild(curproc, newproc);
+	}
+	lock_release(proctable_lock);
+	if (result) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
 	/* VM fields */
 
 	newproc->p_addrspace = NULL;
 
 	/* VFS fields */
 
+	newproc->p_filetable = filetable_create();
+	if (newproc->p_filetable == NULL) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
 	/*
 	 * Lock the current process to copy its current directory.
 	 * (We don't need to lock the new process, though, as we have
@@ -221,6 +574,506 @@ proc_create_runprogram(const char *name)
 	return newproc;
 }
 
+/*
+ * Create a child of the current process for fork: a copy of its
+ * address space, the same open files (sharing their offsets), and
+ * the same current directory. The caller still has to give it a
+ * thread; if that fails, proc_destroy it.
+ *
+ * For vfork, the child gets the parent's address space itself
+ * instead of a copy, and the parent must not touch it (or return to
+ * user mode) until the child gives it back by exiting or execing;
+ * see proc_vforkwait. Nothing gets copied, so this costs the same
+ * however big the parent is.
+ */
+int
+proc_fork(bool vfork, struct proc **ret)
+{
+	struct proc *proc = curproc;
+	struct proc *newproc;
+	struct addrspace *as;
+	int result;
+
+	newproc = proc_create(proc->p_name);
+	if (newproc == NULL) {
+		return ENOMEM;
+	}
+
+	/* VM fields */
+	as = proc_getas();
+	if (as != NULL && vfork) {
+		newproc->p_addrspace = as;
+		newproc->p_vfork = true;
+	}
+	else if (as != NULL) {
+		result = as_copy(as, &newproc->p_addrspace);
+		if (result) {
+			proc_destroy(newproc);
+			return result;
+		}
+	}
+
+	/* VFS fields */
+	if (proc->p_filetable != NULL) {
+		newproc->p_filetable = filetable_copy(proc->p_filetable);
+		if (newproc->p_filetable == NULL) {
+			proc_destroy(newproc);
+			return ENOMEM;
+		}
+	}
+	spinlock_acquire(&proc->p_lock);
+	if (proc->p_cwd != NULL) {
+		VOP_INCREF(proc->p_cwd);
+		newproc->p_cwd = proc->p_cwd;
+	}
+	spinlock_release(&proc->p_lock);
+
+	/* Process table and family */
+	lock_acquire(proctable_lock);
+	result = proctable_add(newproc);
+	if (result == 0) {
+		proc_addchild(proc, newproc);
+	}
+	lock_release(proctable_lock);
+	if (result) {
+		proc_destroy(newproc);
+		return result;
+	}
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * Wait until vfork child PID is done with our address space. It
+ * signals p_exitcv when it is, as well as when it exits.
+ */
+void
+proc_vforkwait(pid_t pid)
+{
+	struct proc *kid;
+
+	lock_acquire(proctable_lock);
+	while ((kid = proctable_get(pid)) != NULL && kid->p_vfork) {
+		KASSERT(kid->p_parent == curproc);
+		cv_wait(kid->p_exitcv, proctable_lock);
+	}
+	lock_release(proctable_lock);
+}
+
+bool
+proc_vforkdone(void)
+{
+	struct proc *proc = curproc;
+	bool borrowed;
+
+	lock_acquire(proctable_lock);
+	borrowed = proc->p_vfork;
+	if (borrowed) {
+		proc->p_vfork = false;
+		cv_broadcast(proc->p_exitcv, proctable_lock);
+	}
+	lock_release(proctable_lock);
+	return borrowed;
+}
+
+/*
+ * Exit the current process with wait status STATUS.
+ *
+ * Everything but the proc structure is given back right away. The
+ * structure itself stays in the process table, holding the status,
+ * until the parent collects it with proc_wait. If there's no parent
+ * to do that, it's destroyed now. Our own children lose their
+ * parent: the ones that already exited are destroyed now, and the
+ * rest will destroy themselves when they exit.
+ *
+ * Any other threads go first (see proc_singlethread). Then our
+ * thread leaves the process, so that once the exit is visible to the
+ * parent it can destroy the process without waiting for us to finish
+ * switching out.
+ */
+void
+proc_exit(int status)
+{
+	struct proc *proc = curproc;
+	struct proc *kid, *nextkid, *zombies;
+	struct addrspace *as;
+	bool orphan;
+
+	KASSERT(proc != NULL);
+	KASSERT(proc != kproc);
+
+	if (proc_singlethread()) {
+		/* Another thread is exiting or exec'ing; it wins. */
+		thread_exit();
+	}
+
+	/*
+	 * If we borrowed the address space from vfork, give it back.
+	 * (Only this thread clears p_vfork, so we can check it
+	 * without the lock.) Otherwise save its memory figures for
+	 * the parent's getrusage.
+	 */
+	if (proc->p_vfork) {
+		proc_setas(NULL);
+		as_deactivate();
+		proc_vforkdone();
+	}
+	as = proc_getas();
+	if (as != NULL) {
+		as_getusage(as, &proc->p_usage);
+		proc->p_usage.ru_rss = 0;
+	}
+	proc_freeresources(proc);
+
+	proc_remthread(curthread);
+
+	lock_acquire(proctable_lock);
+	zombies = NULL;
+	for (kid = proc->p_children; kid != NULL; kid = nextkid) {
+		nextkid = kid->p_nextsib;
+		proc_remchild(kid);
+		if (kid->p_exited) {
+			proctable_remove(kid);
+			kid->p_nextsib = zombies;
+			zombies = kid;
+		}
+	}
+	proc->p_exited = true;
+	proc->p_exitstatus = status;
+	orphan = proc->p_parent == NULL;
+	if (orphan) {
+		proctable_remove(proc);
+	}
+	else {
+		cv_broadcast(proc->p_exitcv, proctable_lock);
+	}
+	lock_release(proctable_lock);
+
+	while (zombies != NULL) {
+		kid = zombies;
+		zombies = kid->p_nextsib;
+		kid->p_nextsib = NULL;
+		proc_destroy(kid);
+	}
+	if (orphan) {
+		proc_destroy(proc);
+	}
+
+	thread_exit();
+}
+
+/*
+ * Wait for the current process's child PID to exit, hand back its
+ * wait status, and destroy it.
+ *
+ * This goes straight to the child through the process table and
+ * sleeps on the child's own CV, so it costs the same however many
+ * other processes there are. The child is looked up again after
+ * every wakeup in case another thread in this process collected it
+ * first.
+ */
+int
+proc_wait(pid_t pid, bool nohang, int *status, pid_t *retpid)
+{
+	struct proc *kid;
+	int result;
+
+	lock_acquire(proctable_lock);
+	while ((kid = proctable_get(pid)) != NULL &&
+	       kid->p_parent == curproc && !kid->p_exited) {
+		if (nohang) {
+			lock_release(proctable_lock);
+			*retpid = 0;
+			return 0;
+		}
+		result = cv_wait_intr(kid->p_exitcv, proctable_lock);
+		if (result) {
+			lock_release(proctable_lock);
+			return result;
+		}
+	}
+	if (kid == NULL) {
+		lock_release(proctable_lock);
+		return ESRCH;
+	}
+	if (kid->p_parent != curproc) {
+		lock_release(proctable_lock);
+		return ECHILD;
+	}
+
+	*status = kid->p_exitstatus;
+	rusage_add(&curproc->p_childusage, &kid->p_usage);
+	rusage_add(&curproc->p_childusage, &kid->p_childusage);
+	proc_remchild(kid);
+	proctable_remove(kid);
+	lock_release(proctable_lock);
+
+	proc_destroy(kid);
+	*retpid = pid;
+	return 0;
+}
+
+/*
+ * Get the total resource use of the children the current process
+ * has collected, and their collected children, and so on.
+ */
+void
+proc_getchildusage(struct rusage *ru)
+{
+	lock_acquire(proctable_lock);
+	*ru = curproc->p_childusage;
+	lock_release(proctable_lock);
+}
+
+////////////////////////////////////////////////////////////
+// multithreaded user processes
+
+/*
+ * How a new user thread starts, passed from proc_threadcreate.
+ */
+struct threadstart {
+	struct trapframe *ts_tf;
+	userptr_t ts_entry;
+	userptr_t ts_arg;
+	userptr_t ts_stack;
+};
+
+/*
+ * Thread function for a new user thread: go to user mode.
+ */
+static
+void
+proc_threadstart(void *data, unsigned long tid)
+{
+	struct threadstart ts = *(struct threadstart *)data;
+	struct proc *proc = curproc;
+	struct uthread *ut;
+
+	kfree(data);
+
+	lock_acquire(proc->p_threadlock);
+	for (ut = proc->p_threads; ut != NULL; ut = ut->ut_next) {
+		if (ut->ut_tid == (int)tid) {
+			ut->ut_thread = curthread;
+			break;
+		}
+	}
+	lock_release(proc->p_threadlock);
+
+	/*
+	 * If the process is being torn down already, we'll notice on
+	 * the first trap back from user mode.
+	 */
+	enter_new_thread(ts.ts_tf, ts.ts_arg, (vaddr_t)ts.ts_stack,
+			 (vaddr_t)ts.ts_entry);
+}
+
+int
+proc_threadcreate(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		  userptr_t stack, int *tid)
+{
+	struct proc *proc = curproc;
+	struct threadstart *ts;
+	struct uthread *ut, **utp;
+	int result;
+
+	ts = kmalloc(sizeof(*ts));
+	if (ts == NULL) {
+		return ENOMEM;
+	}
+	ut = kmalloc(sizeof(*ut));
+	if (ut == NULL) {
+		kfree(ts);
+		return ENOMEM;
+	}
+	ts->ts_tf = tf;
+	ts->ts_entry = entry;
+	ts->ts_arg = arg;
+	ts->ts_stack = stack;
+
+	lock_acquire(proc->p_threadlock);
+	ut->ut_tid = proc->p_nexttid++;
+	ut->ut_thread = NULL;
+	ut->ut_exited = false;
+	ut->ut_value = NULL;
+	ut->ut_next = proc->p_threads;
+	proc->p_threads = ut;
+	proc->p_userthreads++;
+	*tid = ut->ut_tid;
+
+	/*
+	 * Fork with the lock held, so the new thread can't look for
+	 * its record before it's there, and nobody can join it before
+	 * we know whether it started.
+	 */
+	result = thread_fork(proc->p_name, proc, proc_threadstart, ts,
+			     ut->ut_tid);
+	if (result) {
+		utp = &proc->p_threads;
+		while (*utp != ut) {
+			utp = &(*utp)->ut_next;
+		}
+		*utp = ut->ut_next;
+		proc->p_userthreads--;
+		kfree(ut);
+		kfree(ts);
+	}
+	lock_release(proc->p_threadlock);
+	return result;
+}
+
+void
+proc_threadexit(userptr_t value)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	bool last;
+
+	lock_acquire(proc->p_threadlock);
+	for (ut = proc->p_threads; ut != NULL; ut = ut->ut_next) {
+		if (ut->ut_thread == curthread) {
+			ut->ut_thread = NULL;
+			ut->ut_exited = true;
+			ut->ut_value = value;
+			cv_broadcast(proc->p_threadcv, proc->p_threadlock);
+			break;
+		}
+	}
+	KASSERT(proc->p_userthreads > 0);
+	proc->p_userthreads--;
+	last = proc->p_userthreads == 0;
+	lock_release(proc->p_threadlock);
+
+	if (last) {
+		proc_exit(_MKWAIT_EXIT(0));
+	}
+	thread_exit();
+}
+
+/*
+ * Wait for thread TID. The record is looked up again after every
+ * wakeup in case another thread joined it first. Give up if the
+ * process is being torn down; we'll be killed on the way out.
+ */
+int
+proc_threadjoin(int tid, userptr_t *value)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut, **utp;
+	int result;
+
+	lock_acquire(proc->p_threadlock);
+	while (1) {
+		for (utp = &proc->p_threads; *utp != NULL;
+		     utp = &(*utp)->ut_next) {
+			if ((*utp)->ut_tid == tid) {
+				break;
+			}
+		}
+		ut = *utp;
+		if (ut == NULL) {
+			lock_release(proc->p_threadlock);
+			return ESRCH;
+		}
+		if (ut->ut_thread == curthread) {
+			lock_release(proc->p_threadlock);
+			return EINVAL;
+		}
+		if (ut->ut_exited) {
+			break;
+		}
+		result = cv_wait_intr(proc->p_threadcv, proc->p_threadlock);
+		if (result) {
+			lock_release(proc->p_threadlock);
+			return result;
+		}
+	}
+	*utp = ut->ut_next;
+	lock_release(proc->p_threadlock);
+
+	*value = ut->ut_value;
+	kfree(ut);
+	return 0;
+}
+
+/*
+ * Make the current thread the only one in its process.
+ *
+ * There's no way to stop a thread from outside, so this marks us as
+ * the survivor, kills the others (thread_kill), and waits for them to
+ * notice: each one exits the next time it heads back to user mode
+ * (proc_checkkilled, from the trap code; the timer catches ones that
+ * never make system calls). Killing wakes a thread that is blocked
+ * in an interruptible sleep (pipe and console reads, waitpid, poll,
+ * thread_join, futex_wait, semfs), which then fails with EINTR on its
+ * way out. A thread in an uninterruptible sleep, such as disk I/O,
+ * goes when that finishes. If another thread is already doing this,
+ * it wins: we're killed too and fail with EINTR, and the caller
+ * should clean up and return, to exit on the way back to user mode.
+ *
+ * Afterwards the thread records are gone and the count is back to
+ * one, as for a new process.
+ */
+int
+proc_singlethread(void)
+{
+	struct proc *proc = curproc;
+	struct thread *t;
+	bool alone;
+
+	spinlock_acquire(&proc->p_lock);
+	if (proc->p_survivor != NULL) {
+		KASSERT(proc->p_survivor != curthread);
+		spinlock_release(&proc->p_lock);
+		/* It may not have got to us yet. */
+		thread_kill(curthread);
+		return EINTR;
+	}
+	alone = proc->p_numthreads == 1;
+	if (!alone) {
+		proc->p_survivor = curthread;
+		/*
+		 * Holding p_lock keeps them from exiting meanwhile.
+		 * (This puts it before their sleep locks; see proc.h.)
+		 */
+		for (t = proc->p_threadlist; t != NULL; t = t->t_procnext) {
+			if (t != curthread) {
+				thread_kill(t);
+			}
+		}
+	}
+	spinlock_release(&proc->p_lock);
+
+	if (!alone) {
+		spinlock_acquire(&proc->p_lock);
+		while (proc->p_numthreads > 1) {
+			wchan_sleep(proc->p_threadwchan, &proc->p_lock);
+		}
+		proc->p_survivor = NULL;
+		spinlock_release(&proc->p_lock);
+	}
+
+	lock_acquire(proc->p_threadlock);
+	proc_freethreads(proc);
+	proc->p_userthreads = 1;
+	lock_release(proc->p_threadlock);
+	return 0;
+}
+
+/*
+ * This is on the path back to user mode for every trap, so look
+ * without t_killlock; if we miss t_killed being set we'll see it
+ * next time.
+ */
+void
+proc_checkkilled(void)
+{
+	if (curthread->t_killed) {
+		thread_exit();
+	}
+}
+
 /*
  * Add a thread to a process. Either the thread or the process might
  * or might not be current.
@@ -239,6 +1092,12 @@ proc_addthread(struct proc *proc, struct thread *t)
 
 	spinlock_acquire(&proc->p_lock);
 	proc->p_numthreads++;
+	t->t_procnext = proc->p_threadlist;
+	proc->p_threadlist = t;
+	if (proc->p_survivor != NULL) {
+		/* Too late; it goes too. */
+		thread_kill(t);
+	}
 	spinlock_release(&proc->p_lock);
 
 	spl = splhigh();
@@ -261,6 +1120,7 @@ void
 proc_remthread(struct thread *t)
 {
 	struct proc *proc;
+	struct thread **tp;
 	int spl;
 
 	proc = t->t_proc;
@@ -269,6 +1129,15 @@ proc_remthread(struct thread *t)
 	spinlock_acquire(&proc->p_lock);
 	KASSERT(proc->p_numthreads > 0);
 	proc->p_numthreads--;
+	for (tp = &proc->p_threadlist; *tp != t; tp = &(*tp)->t_procnext) {
+		KASSERT(*tp != NULL);
+	}
+	*tp = t->t_procnext;
+	t->t_procnext = NULL;
+	if (proc->p_survivor != NULL) {
+		/* proc_singlethread is waiting for us to go */
+		wchan_wakeall(proc->p_threadwchan, &proc->p_lock);
+	}
 	spinlock_release(&proc->p_lock);
 
 	spl = splhigh();
@@ -318,3 +1187,49 @@ proc_setas(struct addrspace *newas)
 	spinlock_release(&proc->p_lock);
 	return oldas;
 }
+
+/*
+ * Print the memory use of every process with an address space.
+ */
+void
+proc_printvmstats(void)
+{
+	struct proc *proc;
+	struct rusage ru;
+	unsigned i;
+	bool hasas;
+
+	kprintf("%-16s %6s %8s %8s %8s %8s %8s %8s\n", "PROCESS", "PID",
+		"RSS(K)", "MAX(K)", "MINFLT", "MAJFLT", "COW", "SWAPIN");
+
+	/* Holding the table lock keeps processes from being destroyed. */
+	lock_acquire(proctable_lock);
+	for (i=0; i<PROCS_MAX; i++) {
+		proc = proctable[i].ps_proc;
+		if (proc == NULL) {
+			continue;
+		}
+
+		/*
+		 * Holding p_lock keeps the address space from being
+		 * swapped out from under us and destroyed; but we
+		 * can't print while holding a spinlock.
+		 */
+		bzero(&ru, sizeof(ru));
+		spinlock_acquire(&proc->p_lock);
+		hasas = proc->p_addrspace != NULL;
+		if (hasas) {
+			as_getusage(proc->p_addrspace, &ru);
+		}
+		spinlock_release(&proc->p_lock);
+		if (!hasas) {
+			continue;
+		}
+
+		kprintf("%-16s %6d %8u %8u %8llu %8llu %8llu %8llu\n",
+			proc->p_name, proc->p_pid, (unsigned)ru.ru_rss,
+			(unsigned)ru.ru_maxrss, ru.ru_minflt, ru.ru_majflt,
+			ru.ru_ncow, ru.ru_nswapin);
+	}
+	lock_release(proctable_lock);
+}
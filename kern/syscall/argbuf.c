@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Argument vectors for exec. See argbuf.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <limits.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <argbuf.h>
+
+/*
+ * The offset of argument K, in the words counting down from the end
+ * of the buffer.
+ */
+#define ARGBUF_OFFSET(ab, k) \
+	(((uint32_t *)((ab)->ab_buf + ARG_MAX))[-1 - (int)(k)])
+
+int
+argbuf_init(struct argbuf *ab)
+{
+	ab->ab_buf = kmalloc(ARG_MAX);
+	if (ab->ab_buf == NULL) {
+		return ENOMEM;
+	}
+	ab->ab_strsize = 0;
+	ab->ab_argc = 0;
+	return 0;
+}
+
+void
+argbuf_cleanup(struct argbuf *ab)
+{
+	kfree(ab->ab_buf);
+	ab->ab_buf = NULL;
+}
+
+/*
+ * How much room there is for the next string: the space between the
+ * strings and the offsets, less a word for its own offset and one for
+ * the NULL that ends argv.
+ */
+static
+size_t
+argbuf_room(struct argbuf *ab)
+{
+	size_t used;
+
+	used = ab->ab_strsize + (ab->ab_argc + 2) * sizeof(uint32_t);
+	return used < ARG_MAX ? ARG_MAX - used : 0;
+}
+
+int
+argbuf_fromuser(struct argbuf *ab, userptr_t uargv)
+{
+	userptr_t uarg;
+	vaddr_t where;
+	size_t room, len;
+	int result;
+
+	while (1) {
+		where = (vaddr_t)uargv + ab->ab_argc * sizeof(userptr_t);
+		result = copyin((const_userptr_t)where, &uarg, sizeof(uarg));
+		if (result) {
+			return result;
+		}
+		if (uarg == NULL) {
+			return 0;
+		}
+
+		room = argbuf_room(ab);
+		if (room == 0) {
+			return E2BIG;
+		}
+		result = copyinstr((const_userptr_t)uarg,
+				   ab->ab_buf + ab->ab_strsize, room, &len);
+		if (result == ENAMETOOLONG) {
+			return E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		ARGBUF_OFFSET(ab, ab->ab_argc) = ab->ab_strsize;
+		ab->ab_strsize += len;
+		ab->ab_argc++;
+	}
+}
+
+int
+argbuf_fromkernel(struct argbuf *ab, char **args, unsigned nargs)
+{
+	unsigned i;
+	size_t len;
+
+	for (i=0; i<nargs; i++) {
+		len = strlen(args[i]) + 1;
+		if (len > argbuf_room(ab)) {
+			return E2BIG;
+		}
+		memcpy(ab->ab_buf + ab->ab_strsize, args[i], len);
+		ARGBUF_OFFSET(ab, ab->ab_argc) = ab->ab_strsize;
+		ab->ab_strsize += len;
+		ab->ab_argc++;
+	}
+	return 0;
+}
+
+int
+argbuf_copyout(struct argbuf *ab, vaddr_t *stackptr, userptr_t *uargv)
+{
+	uint32_t *offsets, *argv, tmp;
+	size_t strpad, size;
+	unsigned nptrs, i;
+	vaddr_t base;
+	int result;
+
+	nptrs = ab->ab_argc + 1;
+	strpad = ROUNDUP(ab->ab_strsize, sizeof(uint32_t));
+	size = strpad + nptrs * sizeof(uint32_t);
+	KASSERT(size <= ARG_MAX);
+
+	/* The block goes at the top of the stack; keep sp 8-aligned. */
+	base = (*stackptr - size) & ~(vaddr_t)7;
+
+	/*
+	 * The offsets are at the back, last argument first, and lowest
+	 * of all the slot for the NULL. Put them in order, slide them
+	 * down to just after the strings, and make them user addresses.
+	 */
+	offsets = (uint32_t *)(ab->ab_buf + ARG_MAX) - nptrs;
+	for (i=0; i < nptrs/2; i++) {
+		tmp = offsets[i];
+		offsets[i] = offsets[nptrs - 1 - i];
+		offsets[nptrs - 1 - i] = tmp;
+	}
+	bzero(ab->ab_buf + ab->ab_strsize, strpad - ab->ab_strsize);
+	argv = (uint32_t *)(ab->ab_buf + strpad);
+	memmove(argv, offsets, nptrs * sizeof(uint32_t));
+	for (i=0; i<ab->ab_argc; i++) {
+		argv[i] += base;
+	}
+	argv[ab->ab_argc] = 0;
+
+	result = copyout(ab->ab_buf, (userptr_t)base, size);
+	if (result) {
+		return result;
+	}
+	*stackptr = base;
+	*uargv = (userptr_t)(base + strpad);
+	return 0;
+}
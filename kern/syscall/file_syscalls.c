@@ -0,0 +1,650 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <kern/seek.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <proc.h>
+#include <current.h>
+#include <copyinout.h>
+#include <vm.h>
+#include <vnode.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <pipe.h>
+#include <poll.h>
+#include <syscall.h>
+
+/*
+ * File system calls: open, the reads and writes, lseek, close, dup2,
+ * pipe, ioctl, splice, and poll.
+ */
+
+int
+sys_open(userptr_t upath, int flags, mode_t mode, int32_t *retval)
+{
+	const int allflags = O_ACCMODE | O_CREAT | O_EXCL | O_TRUNC |
+		O_APPEND | O_NOCTTY;
+	struct openfile *file;
+	char *path;
+	int result;
+
+	if ((flags & allflags) != flags) {
+		return EINVAL;
+	}
+
+	path = kmalloc(__PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(upath, path, __PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = openfile_open(path, flags, mode, &file);
+	kfree(path);
+	if (result) {
+		return result;
+	}
+
+	result = filetable_place(curproc->p_filetable, file, retval);
+	if (result) {
+		openfile_decref(file);
+		return result;
+	}
+	return 0;
+}
+
+/*
+ * Common code for all the reads and writes: move data between the
+ * file open on FD and the user memory USERUIO describes. If POS is
+ * NULL, the transfer happens at the file's seek position, which is
+ * advanced by the amount moved; otherwise it happens at *POS and the
+ * seek position is left alone.
+ */
+static
+int
+file_rw(int fd, struct uio *useruio, const off_t *pos, size_t *retval)
+{
+	struct openfile *file;
+	struct stat st;
+	size_t size = useruio->uio_resid;
+	bool useoffset;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+	if (file->of_accmode ==
+	    (useruio->uio_rw == UIO_READ ? O_WRONLY : O_RDONLY)) {
+		openfile_decref(file);
+		return EBADF;
+	}
+
+	useoffset = pos == NULL && file->of_seekable;
+	if (pos != NULL) {
+		if (!file->of_seekable) {
+			openfile_decref(file);
+			return ESPIPE;
+		}
+		if (*pos < 0) {
+			openfile_decref(file);
+			return EINVAL;
+		}
+		useruio->uio_offset = *pos;
+	}
+	else if (useoffset) {
+		lock_acquire(file->of_offsetlock);
+		if (useruio->uio_rw == UIO_WRITE && file->of_append) {
+			result = VOP_STAT(file->of_vnode, &st);
+			if (result) {
+				goto out;
+			}
+			file->of_offset = st.st_size;
+		}
+		useruio->uio_offset = file->of_offset;
+	}
+
+	if (useruio->uio_rw == UIO_READ) {
+		result = VOP_READ(file->of_vnode, useruio);
+	}
+	else {
+		result = VOP_WRITE(file->of_vnode, useruio);
+		vm_filechanged(file->of_vnode);
+	}
+	if (useoffset) {
+		/* Even after an error, this much got moved. */
+		file->of_offset = useruio->uio_offset;
+	}
+
+ out:
+	if (useoffset) {
+		lock_release(file->of_offsetlock);
+	}
+	openfile_decref(file);
+	if (result) {
+		return result;
+	}
+	*retval = size - useruio->uio_resid;
+	return 0;
+}
+
+/*
+ * read, write, pread, and pwrite: one user buffer BUF of SIZE bytes.
+ */
+static
+int
+buf_rw(int fd, userptr_t buf, size_t size, const off_t *pos,
+       enum uio_rw rw, int32_t *retval)
+{
+	struct iovec iov;
+	struct uio useruio;
+	size_t done = 0;
+	int result;
+
+	iov.iov_ubase = buf;
+	iov.iov_len = size;
+	useruio.uio_iov = &iov;
+	useruio.uio_iovcnt = 1;
+	useruio.uio_offset = 0;
+	useruio.uio_resid = size;
+	useruio.uio_segflg = UIO_USERSPACE;
+	useruio.uio_rw = rw;
+	useruio.uio_space = proc_getas();
+
+	result = file_rw(fd, &useruio, pos, &done);
+	*retval = done;
+	return result;
+}
+
+/*
+ * readv, writev, preadv, and pwritev: the user's array of IOVCNT
+ * iovecs at UIOV goes straight into the uio, so the file system sees
+ * one request for the lot. Small arrays are copied onto the stack.
+ */
+#define SMALL_IOVCNT	8
+
+static
+int
+vec_rw(int fd, userptr_t uiov, int iovcnt, const off_t *pos,
+       enum uio_rw rw, int32_t *retval)
+{
+	struct iovec smalliov[SMALL_IOVCNT], *iov;
+	struct uio useruio;
+	size_t total, done = 0;
+	int i, result;
+
+	if (iovcnt < 0 || iovcnt > __IOV_MAX) {
+		return EINVAL;
+	}
+	if (iovcnt <= SMALL_IOVCNT) {
+		iov = smalliov;
+	}
+	else {
+		iov = kmalloc(iovcnt * sizeof(*iov));
+		if (iov == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	result = copyin(uiov, iov, iovcnt * sizeof(*iov));
+	if (result) {
+		goto out;
+	}
+	total = 0;
+	for (i=0; i<iovcnt; i++) {
+		if (iov[i].iov_len > (size_t)-1 - total) {
+			result = EINVAL;
+			goto out;
+		}
+		total += iov[i].iov_len;
+	}
+
+	useruio.uio_iov = iov;
+	useruio.uio_iovcnt = iovcnt;
+	useruio.uio_offset = 0;
+	useruio.uio_resid = total;
+	useruio.uio_segflg = UIO_USERSPACE;
+	useruio.uio_rw = rw;
+	useruio.uio_space = proc_getas();
+
+	result = file_rw(fd, &useruio, pos, &done);
+	*retval = done;
+
+ out:
+	if (iov != smalliov) {
+		kfree(iov);
+	}
+	return result;
+}
+
+int
+sys_read(int fd, userptr_t buf, size_t size, int32_t *retval)
+{
+	return buf_rw(fd, buf, size, NULL, UIO_READ, retval);
+}
+
+int
+sys_write(int fd, userptr_t buf, size_t size, int32_t *retval)
+{
+	return buf_rw(fd, buf, size, NULL, UIO_WRITE, retval);
+}
+
+int
+sys_pread(int fd, userptr_t buf, size_t size, off_t pos, int32_t *retval)
+{
+	return buf_rw(fd, buf, size, &pos, UIO_READ, retval);
+}
+
+int
+sys_pwrite(int fd, userptr_t buf, size_t size, off_t pos, int32_t *retval)
+{
+	return buf_rw(fd, buf, size, &pos, UIO_WRITE, retval);
+}
+
+int
+sys_readv(int fd, userptr_t iov, int iovcnt, int32_t *retval)
+{
+	return vec_rw(fd, iov, iovcnt, NULL, UIO_READ, retval);
+}
+
+int
+sys_writev(int fd, userptr_t iov, int iovcnt, int32_t *retval)
+{
+	return vec_rw(fd, iov, iovcnt, NULL, UIO_WRITE, retval);
+}
+
+int
+sys_preadv(int fd, userptr_t iov, int iovcnt, off_t pos, int32_t *retval)
+{
+	return vec_rw(fd, iov, iovcnt, &pos, UIO_READ, retval);
+}
+
+int
+sys_pwritev(int fd, userptr_t iov, int iovcnt, off_t pos, int32_t *retval)
+{
+	return vec_rw(fd, iov, iovcnt, &pos, UIO_WRITE, retval);
+}
+
+int
+sys_lseek(int fd, off_t pos, int whence, off_t *retval)
+{
+	struct openfile *file;
+	struct stat st;
+	off_t newpos;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+	if (!file->of_seekable) {
+		openfile_decref(file);
+		return ESPIPE;
+	}
+
+	lock_acquire(file->of_offsetlock);
+	switch (whence) {
+	    case SEEK_SET:
+		newpos = pos;
+		break;
+	    case SEEK_CUR:
+		newpos = file->of_offset + pos;
+		break;
+	    case SEEK_END:
+		result = VOP_STAT(file->of_vnode, &st);
+		newpos = st.st_size + pos;
+		break;
+	    default:
+		result = EINVAL;
+		break;
+	}
+	if (result == 0 && newpos < 0) {
+		result = EINVAL;
+	}
+	if (result == 0) {
+		file->of_offset = newpos;
+		*retval = newpos;
+	}
+	lock_release(file->of_offsetlock);
+
+	openfile_decref(file);
+	return result;
+}
+
+int
+sys_close(int fd)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_remove(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+	openfile_decref(file);
+	return 0;
+}
+
+int
+sys_dup2(int oldfd, int newfd, int32_t *retval)
+{
+	struct openfile *file, *oldfile;
+	int result;
+
+	if (!filetable_okfd(newfd)) {
+		return EBADF;
+	}
+
+	/* This takes the reference the new descriptor will hold. */
+	result = filetable_get(curproc->p_filetable, oldfd, &file);
+	if (result) {
+		return result;
+	}
+	if (oldfd == newfd) {
+		openfile_decref(file);
+		*retval = newfd;
+		return 0;
+	}
+
+	result = filetable_placeat(curproc->p_filetable, file, newfd,
+				   &oldfile);
+	if (result) {
+		openfile_decref(file);
+		return result;
+	}
+	if (oldfile != NULL) {
+		openfile_decref(oldfile);
+	}
+	*retval = newfd;
+	return 0;
+}
+
+int
+sys_pipe(userptr_t fds)
+{
+	struct filetable *ft = curproc->p_filetable;
+	struct vnode *readvn, *writevn;
+	struct openfile *readfile, *writefile, *junk;
+	int kfds[2];
+	int result;
+
+	result = pipe_create(&readvn, &writevn);
+	if (result) {
+		return result;
+	}
+	result = openfile_create(readvn, O_RDONLY, &readfile);
+	if (result) {
+		VOP_DECREF(readvn);
+		VOP_DECREF(writevn);
+		return result;
+	}
+	result = openfile_create(writevn, O_WRONLY, &writefile);
+	if (result) {
+		openfile_decref(readfile);
+		VOP_DECREF(writevn);
+		return result;
+	}
+
+	result = filetable_place(ft, readfile, &kfds[0]);
+	if (result) {
+		goto fail;
+	}
+	result = filetable_place(ft, writefile, &kfds[1]);
+	if (result) {
+		filetable_remove(ft, kfds[0], &junk);
+		goto fail;
+	}
+	result = copyout(kfds, fds, sizeof(kfds));
+	if (result) {
+		filetable_remove(ft, kfds[1], &junk);
+		filetable_remove(ft, kfds[0], &junk);
+		goto fail;
+	}
+	return 0;
+
+ fail:
+	openfile_decref(writefile);
+	openfile_decref(readfile);
+	return result;
+}
+
+int
+sys_ioctl(int fd, int code, userptr_t data)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+	result = VOP_IOCTL(file->of_vnode, code, data);
+	openfile_decref(file);
+	return result;
+}
+
+/*
+ * splice: move up to LEN bytes between a pipe and a file without
+ * copying them through user memory. Exactly one side must be a pipe:
+ * the read end of one to splice out of it, or the write end of one
+ * to splice into it. The file's seek position is used and advanced
+ * the way read or write would.
+ */
+int
+sys_splice(int fromfd, int tofd, size_t len, int32_t *retval)
+{
+	struct openfile *from, *to, *file;
+	struct stat st;
+	bool out, in;
+	off_t pos = 0;
+	size_t moved = 0;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fromfd, &from);
+	if (result) {
+		return result;
+	}
+	result = filetable_get(curproc->p_filetable, tofd, &to);
+	if (result) {
+		openfile_decref(from);
+		return result;
+	}
+	if (from->of_accmode == O_WRONLY || to->of_accmode == O_RDONLY) {
+		result = EBADF;
+		goto done;
+	}
+
+	out = pipe_isreadend(from->of_vnode);
+	in = pipe_iswriteend(to->of_vnode);
+	if (out == in) {
+		result = EINVAL;
+		goto done;
+	}
+	file = out ? to : from;
+
+	if (file->of_seekable) {
+		lock_acquire(file->of_offsetlock);
+		if (out && file->of_append) {
+			result = VOP_STAT(file->of_vnode, &st);
+			if (result) {
+				lock_release(file->of_offsetlock);
+				goto done;
+			}
+			file->of_offset = st.st_size;
+		}
+		pos = file->of_offset;
+	}
+
+	if (out) {
+		result = pipe_drain(from->of_vnode, to->of_vnode, &pos, len,
+				    &moved);
+	}
+	else {
+		result = pipe_fill(to->of_vnode, from->of_vnode, &pos, len,
+				   &moved);
+	}
+
+	if (file->of_seekable) {
+		file->of_offset = pos;
+		lock_release(file->of_offsetlock);
+	}
+
+ done:
+	openfile_decref(to);
+	openfile_decref(from);
+	if (result) {
+		return result;
+	}
+	*retval = moved;
+	return 0;
+}
+
+/*
+ * Check each file in FDS for the events it asks about, counting the
+ * ones with something to report. FILES has the open files, with NULL
+ * for negative descriptors (skipped) and bad ones (already marked
+ * POLLNVAL). Unless PW is NULL, PW is put on each one's queue.
+ */
+static
+unsigned
+poll_scan(struct pollfd *fds, struct openfile **files, unsigned nfds,
+	  struct pollwaiter *pw)
+{
+	unsigned i, n;
+	int events;
+
+	n = 0;
+	for (i=0; i<nfds; i++) {
+		if (files[i] != NULL) {
+			events = fds[i].events & (POLLIN | POLLPRI | POLLOUT);
+			fds[i].revents = VOP_POLL(files[i]->of_vnode, events,
+						  pw);
+		}
+		if (fds[i].revents != 0) {
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * poll: wait until one of the files is ready for what's asked, or
+ * TIMEOUT milliseconds pass (forever if negative). The first pass
+ * puts us on each file's queue; after any wakeup we check them all
+ * again.
+ */
+int
+sys_poll(userptr_t ufds, unsigned nfds, int timeout, int *retval)
+{
+	struct pollfd *fds;
+	struct openfile **files;
+	struct pollwaiter *pw;
+	unsigned i, n;
+	bool timedout;
+	int result;
+
+	if (nfds > OPEN_MAX) {
+		return EINVAL;
+	}
+
+	fds = NULL;
+	files = NULL;
+	if (nfds > 0) {
+		fds = kmalloc(nfds * sizeof(fds[0]));
+		files = kmalloc(nfds * sizeof(files[0]));
+		if (fds == NULL || files == NULL) {
+			kfree(fds);
+			kfree(files);
+			return ENOMEM;
+		}
+		result = copyin(ufds, fds, nfds * sizeof(fds[0]));
+		if (result) {
+			kfree(fds);
+			kfree(files);
+			return result;
+		}
+	}
+
+	for (i=0; i<nfds; i++) {
+		files[i] = NULL;
+		fds[i].revents = 0;
+		if (fds[i].fd >= 0 &&
+		    filetable_get(curproc->p_filetable, fds[i].fd,
+				  &files[i])) {
+			fds[i].revents = POLLNVAL;
+		}
+	}
+
+	pw = pollwaiter_create(nfds, timeout);
+	if (pw == NULL) {
+		result = ENOMEM;
+		goto done;
+	}
+	n = poll_scan(fds, files, nfds, pw);
+	timedout = timeout == 0;
+	result = 0;
+	while (n == 0 && !timedout) {
+		result = pollwaiter_sleep(pw, &timedout);
+		if (result) {
+			break;
+		}
+		pollwaiter_reset(pw);
+		n = poll_scan(fds, files, nfds, NULL);
+	}
+	pollwaiter_destroy(pw);
+	if (result) {
+		goto done;
+	}
+
+	if (nfds > 0) {
+		result = copyout(fds, ufds, nfds * sizeof(fds[0]));
+	}
+	*retval = n;
+
+ done:
+	for (i=0; i<nfds; i++) {
+		if (files[i] != NULL) {
+			openfile_decref(files[i]);
+		}
+	}
+	kfree(fds);
+	kfree(files);
+	return result;
+}
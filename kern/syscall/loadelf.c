@@ -42,8 +42,13 @@
  * circumstances, as_prepare_load and as_complete_load probably don't
  * need to do anything.
  *
- * If you wanted to support memory-mapped executables you would need
- * to rearrange this to map each segment.
+ * With the paged VM, "loading" a chunk just maps it: as_map_file
+ * records where in the file the segment's data is, and vm_fault
+ * reads each page in the first time it is touched. That way exec
+ * costs the same for a big program as for a small one, and text that
+ * is never run is never read. load_elf_eager reads everything in up
+ * front the old way, for comparison; with dumbvm, which can't fault
+ * pages in, load_elf does the same.
  *
  * To support dynamically linked executables with shared libraries
  * you'd need to change this to load the "ELF interpreter" (dynamic
@@ -59,6 +64,7 @@
 #include <addrspace.h>
 #include <vnode.h>
 #include <elf.h>
+#include "opt-dumbvm.h"
 
 /*
  * Load a segment at virtual address VADDR. The segment in memory
@@ -145,13 +151,38 @@ load_segment(struct addrspace *as, struct vnode *v,
 	return result;
 }
 
+#if !OPT_DUMBVM
 /*
- * Load an ELF executable user program into the current address space.
+ * Map a segment instead: same arguments as load_segment, but the
+ * pages are read in by vm_fault as they are touched.
+ */
+static
+int
+map_segment(struct addrspace *as, struct vnode *v,
+	    off_t offset, vaddr_t vaddr,
+	    size_t memsize, size_t filesize)
+{
+	if (filesize > memsize) {
+		kprintf("ELF: warning: segment filesize > segment memsize\n");
+		filesize = memsize;
+	}
+
+	DEBUG(DB_EXEC, "ELF: Mapping %lu bytes at 0x%lx\n",
+	      (unsigned long) filesize, (unsigned long) vaddr);
+
+	return as_map_file(as, vaddr, v, offset, filesize);
+}
+#endif
+
+/*
+ * Load an ELF executable user program into the current address space,
+ * reading each segment in now if EAGER is set and mapping it if not.
  *
  * Returns the entry point (initial PC) for the program in ENTRYPOINT.
  */
+static
 int
-load_elf(struct vnode *v, vaddr_t *entrypoint)
+do_load_elf(struct vnode *v, vaddr_t *entrypoint, bool eager)
 {
 	Elf_Ehdr eh;   /* Executable header */
 	Elf_Phdr ph;   /* "Program header" = segment header */
@@ -160,6 +191,10 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 	struct uio ku;
 	struct addrspace *as;
 
+#if OPT_DUMBVM
+	KASSERT(eager);
+#endif
+
 	as = proc_getas();
 
 	/*
@@ -288,9 +323,17 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 			return ENOEXEC;
 		}
 
-		result = load_segment(as, v, ph.p_offset, ph.p_vaddr,
-				      ph.p_memsz, ph.p_filesz,
-				      ph.p_flags & PF_X);
+		if (eager) {
+			result = load_segment(as, v, ph.p_offset, ph.p_vaddr,
+					      ph.p_memsz, ph.p_filesz,
+					      ph.p_flags & PF_X);
+		}
+#if !OPT_DUMBVM
+		else {
+			result = map_segment(as, v, ph.p_offset, ph.p_vaddr,
+					     ph.p_memsz, ph.p_filesz);
+		}
+#endif
 		if (result) {
 			return result;
 		}
@@ -305,3 +348,19 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 
 	return 0;
 }
+
+int
+load_elf(struct vnode *v, vaddr_t *entrypoint)
+{
+#if OPT_DUMBVM
+	return do_load_elf(v, entrypoint, true);
+#else
+	return do_load_elf(v, entrypoint, false);
+#endif
+}
+
+int
+load_elf_eager(struct vnode *v, vaddr_t *entrypoint)
+{
+	return do_load_elf(v, entrypoint, true);
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Process system calls: fork, vfork, execv, _exit, waitpid, getpid,
+ * and the thread and futex calls. The process table, the exit/wait
+ * handoff, and the thread bookkeeping are in proc.c; the futex wait
+ * queues are in futex.c.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/wait.h>
+#include <limits.h>
+#include <lib.h>
+#include <machine/trapframe.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <futex.h>
+#include <addrspace.h>
+#include <vfs.h>
+#include <argbuf.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * Thread function for the child side of fork.
+ */
+static
+void
+fork_child(void *tf, unsigned long junk)
+{
+	(void)junk;
+	enter_forked_process(tf);
+}
+
+/*
+ * Common code for fork and vfork.
+ */
+static
+int
+dofork(struct trapframe *tf, bool vfork, pid_t *retval)
+{
+	struct trapframe *childtf;
+	struct proc *newproc;
+	pid_t pid;
+	int result;
+
+	/* The child's copy of our trapframe; enter_forked_process frees it. */
+	childtf = kmalloc(sizeof(*childtf));
+	if (childtf == NULL) {
+		return ENOMEM;
+	}
+	*childtf = *tf;
+
+	result = proc_fork(vfork, &newproc);
+	if (result) {
+		kfree(childtf);
+		return result;
+	}
+	pid = newproc->p_pid;
+
+	result = thread_fork(curthread->t_name, newproc,
+			     fork_child, childtf, 0);
+	if (result) {
+		proc_destroy(newproc);
+		kfree(childtf);
+		return result;
+	}
+
+	if (vfork) {
+		proc_vforkwait(pid);
+	}
+
+	*retval = pid;
+	return 0;
+}
+
+int
+sys_fork(struct trapframe *tf, pid_t *retval)
+{
+	return dofork(tf, false, retval);
+}
+
+/*
+ * vfork: like fork, but the child runs in our address space until it
+ * execs or exits, and we don't return until then. This saves copying
+ * the address space only for exec to throw the copy away.
+ */
+int
+sys_vfork(struct trapframe *tf, pid_t *retval)
+{
+	return dofork(tf, true, retval);
+}
+
+/*
+ * execv. The arguments are collected into an argbuf before anything
+ * else, while the old address space is still there to copy them
+ * from; then the program is loaded into a new address space. Until
+ * that's all worked, the old one is kept so that a failed exec can
+ * go back to it.
+ */
+int
+sys_execv(userptr_t prog, userptr_t args)
+{
+	struct argbuf ab;
+	struct addrspace *oldas, *newas;
+	struct vnode *v;
+	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
+	char *path;
+	int result;
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(prog, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = argbuf_init(&ab);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+	result = argbuf_fromuser(&ab, args);
+	if (result) {
+		argbuf_cleanup(&ab);
+		kfree(path);
+		return result;
+	}
+
+	/* vfs_open may destroy the path, but we're done with it anyway. */
+	result = vfs_open(path, O_RDONLY, 0, &v);
+	kfree(path);
+	if (result) {
+		argbuf_cleanup(&ab);
+		return result;
+	}
+
+	/*
+	 * Other threads can't go on running in the address space
+	 * we're about to replace, so they go now, even if loading the
+	 * program then fails. If another thread is exiting or
+	 * exec'ing already, it wins and we go instead.
+	 */
+	result = proc_singlethread();
+	if (result) {
+		vfs_close(v);
+		argbuf_cleanup(&ab);
+		return result;
+	}
+
+	newas = as_create();
+	if (newas == NULL) {
+		vfs_close(v);
+		argbuf_cleanup(&ab);
+		return ENOMEM;
+	}
+	oldas = proc_setas(newas);
+	as_activate();
+
+	result = load_elf(v, &entrypoint);
+	vfs_close(v);
+	if (result == 0) {
+		result = as_define_stack(newas, &stackptr);
+	}
+	if (result == 0) {
+		result = argbuf_copyout(&ab, &stackptr, &argv);
+	}
+	argbuf_cleanup(&ab);
+	if (result) {
+		proc_setas(oldas);
+		as_activate();
+		as_destroy(newas);
+		return result;
+	}
+
+	/* No going back now. If vfork lent us the old one, return it. */
+	if (!proc_vforkdone()) {
+		as_destroy(oldas);
+	}
+
+	enter_new_process(ab.ab_argc, argv, NULL /* environment */,
+			  stackptr, entrypoint);
+}
+
+void
+sys__exit(int code)
+{
+	proc_exit(_MKWAIT_EXIT(code));
+}
+
+int
+sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retval)
+{
+	int kstatus;
+	int result;
+
+	if (options & ~WNOHANG) {
+		return EINVAL;
+	}
+
+	result = proc_wait(pid, (options & WNOHANG) != 0, &kstatus, retval);
+	if (result) {
+		return result;
+	}
+
+	/*
+	 * The child is already gone by now, so a bad status pointer
+	 * loses its status; that's the caller's lookout.
+	 */
+	if (*retval != 0 && status != NULL) {
+		result = copyout(&kstatus, status, sizeof(kstatus));
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+int
+sys_getpid(pid_t *retval)
+{
+	*retval = curproc->p_pid;
+	return 0;
+}
+
+int
+sys___thread_create(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		    userptr_t stack, int32_t *retval)
+{
+	struct trapframe *newtf;
+	int result;
+
+	/* The new thread's copy of our trapframe; enter_new_thread frees it. */
+	newtf = kmalloc(sizeof(*newtf));
+	if (newtf == NULL) {
+		return ENOMEM;
+	}
+	*newtf = *tf;
+
+	result = proc_threadcreate(newtf, entry, arg, stack, retval);
+	if (result) {
+		kfree(newtf);
+	}
+	return result;
+}
+
+void
+sys___thread_exit(userptr_t value)
+{
+	proc_threadexit(value);
+}
+
+int
+sys___thread_join(int tid, userptr_t value)
+{
+	userptr_t kvalue;
+	int result;
+
+	result = proc_threadjoin(tid, &kvalue);
+	if (result) {
+		return result;
+	}
+	/* The thread is collected now, so an error here loses the value. */
+	return copyout(&kvalue, value, sizeof(kvalue));
+}
+
+int
+sys___futex_wait(userptr_t addr, int val)
+{
+	return futex_wait(addr, val);
+}
+
+int
+sys___futex_wake(userptr_t addr, int count, int *retval)
+{
+	return futex_wake(addr, count, retval);
+}
@@ -42,36 +42,92 @@
 #include <addrspace.h>
 #include <vm.h>
 #include <vfs.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <argbuf.h>
 #include <syscall.h>
 #include <test.h>
 
 /*
- * Load program "progname" and start running it in usermode.
+ * Open the console as standard input, output, and error, unless the
+ * process already has them.
+ */
+static
+int
+runprogram_stdio(void)
+{
+	static const int modes[3] = { O_RDONLY, O_WRONLY, O_WRONLY };
+	struct filetable *ft = curproc->p_filetable;
+	struct openfile *file, *oldfile;
+	char path[5];
+	int fd, result;
+
+	for (fd = 0; fd < 3; fd++) {
+		if (filetable_get(ft, fd, &file) == 0) {
+			openfile_decref(file);
+			continue;
+		}
+		/* vfs_open may destroy the path. */
+		strcpy(path, "con:");
+		result = openfile_open(path, modes[fd], 0, &file);
+		if (result) {
+			return result;
+		}
+		result = filetable_placeat(ft, file, fd, &oldfile);
+		KASSERT(result == 0 && oldfile == NULL);
+	}
+	return 0;
+}
+
+/*
+ * Load program "progname" and start running it in usermode, with
+ * the NARGS strings in ARGS as its argv.
  * Does not return except on error.
  *
  * Calls vfs_open on progname and thus may destroy it.
  */
 int
-runprogram(char *progname)
+runprogram(char *progname, char **args, unsigned nargs)
 {
 	struct addrspace *as;
 	struct vnode *v;
+	struct argbuf ab;
 	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
 	int result;
 
+	result = argbuf_init(&ab);
+	if (result) {
+		return result;
+	}
+	result = argbuf_fromkernel(&ab, args, nargs);
+	if (result) {
+		argbuf_cleanup(&ab);
+		return result;
+	}
+
 	/* Open the file. */
 	result = vfs_open(progname, O_RDONLY, 0, &v);
 	if (result) {
+		argbuf_cleanup(&ab);
 		return result;
 	}
 
 	/* We should be a new process. */
 	KASSERT(proc_getas() == NULL);
 
+	result = runprogram_stdio();
+	if (result) {
+		vfs_close(v);
+		argbuf_cleanup(&ab);
+		return result;
+	}
+
 	/* Create a new address space. */
 	as = as_create();
 	if (as == NULL) {
 		vfs_close(v);
+		argbuf_cleanup(&ab);
 		return ENOMEM;
 	}
 
@@ -84,6 +140,7 @@ runprogram(char *progname)
 	if (result) {
 		/* p_addrspace will go away when curproc is destroyed */
 		vfs_close(v);
+		argbuf_cleanup(&ab);
 		return result;
 	}
 
@@ -94,11 +151,19 @@ runprogram(char *progname)
 	result = as_define_stack(as, &stackptr);
 	if (result) {
 		/* p_addrspace will go away when curproc is destroyed */
+		argbuf_cleanup(&ab);
+		return result;
+	}
+
+	/* Put the arguments on the stack. */
+	result = argbuf_copyout(&ab, &stackptr, &argv);
+	argbuf_cleanup(&ab);
+	if (result) {
 		return result;
 	}
 
 	/* Warp to user mode. */
-	enter_new_process(0 /*argc*/, NULL /*userspace addr of argv*/,
+	enter_new_process(ab.ab_argc, argv,
 			  NULL /*userspace addr of environment*/,
 			  stackptr, entrypoint);
 
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * System call statistics and tracing. See syscalltab.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <proc.h>
+#include <current.h>
+#include <syscalltab.h>
+
+void
+syscall_enter(struct syscallent *sc, const uint32_t *args)
+{
+	char buf[32 + SYSCALL_MAXWORDS * 12];
+	size_t len;
+	unsigned i;
+
+	sc->sc_calls++;
+
+	if (sc->sc_trace) {
+		/* Build the line first, so it comes out in one piece. */
+		len = snprintf(buf, sizeof(buf), "%s(", sc->sc_name);
+		for (i=0; i<sc->sc_nwords && len < sizeof(buf); i++) {
+			len += snprintf(buf + len, sizeof(buf) - len, "%s0x%x",
+					i > 0 ? ", " : "", args[i]);
+		}
+		kprintf("[%s] %s)\n", curproc->p_name, buf);
+	}
+}
+
+void
+syscall_leave(struct syscallent *sc, uint32_t cycles, int err,
+	      int64_t retval)
+{
+	unsigned b;
+
+	if (err) {
+		sc->sc_errors++;
+	}
+	sc->sc_cycles += cycles;
+	cycles >>= SYSCALL_HISTSHIFT;
+	for (b = 0; cycles > 0 && b < SYSCALL_HISTSIZE - 1; b++) {
+		cycles >>= 1;
+	}
+	sc->sc_hist[b]++;
+
+	if (sc->sc_trace) {
+		if (err) {
+			kprintf("[%s] %s: %s\n", curproc->p_name, sc->sc_name,
+				strerror(err));
+		}
+		else {
+			kprintf("[%s] %s = %lld\n", curproc->p_name,
+				sc->sc_name, retval);
+		}
+	}
+}
+
+void
+syscall_printstats(void)
+{
+	struct syscallent *sc;
+	unsigned i, b, timed;
+
+	kprintf("%-12s %8s %8s %10s\n", "CALL", "CALLS", "ERRORS",
+		"AVG CYCLES");
+	for (i=0; i<syscalltab_size; i++) {
+		sc = &syscalltab[i];
+		if (sc->sc_func == NULL || sc->sc_calls == 0) {
+			continue;
+		}
+		timed = 0;
+		for (b=0; b<SYSCALL_HISTSIZE; b++) {
+			timed += sc->sc_hist[b];
+		}
+		kprintf("%-12s %8u %8u %10llu\n", sc->sc_name, sc->sc_calls,
+			sc->sc_errors, timed > 0 ? sc->sc_cycles / timed : 0);
+
+		/* Then the histogram buckets that aren't empty. */
+		kprintf("   ");
+		for (b=0; b<SYSCALL_HISTSIZE; b++) {
+			if (sc->sc_hist[b] == 0) {
+				continue;
+			}
+			if (b < SYSCALL_HISTSIZE - 1) {
+				kprintf(" <2^%u:%u", SYSCALL_HISTSHIFT + b,
+					sc->sc_hist[b]);
+			}
+			else {
+				kprintf(" >=2^%u:%u", SYSCALL_HISTSHIFT + b - 1,
+					sc->sc_hist[b]);
+			}
+		}
+		kprintf("\n");
+	}
+}
+
+void
+syscall_resetstats(void)
+{
+	struct syscallent *sc;
+	unsigned i, b;
+
+	for (i=0; i<syscalltab_size; i++) {
+		sc = &syscalltab[i];
+		sc->sc_calls = 0;
+		sc->sc_errors = 0;
+		sc->sc_cycles = 0;
+		for (b=0; b<SYSCALL_HISTSIZE; b++) {
+			sc->sc_hist[b] = 0;
+		}
+	}
+}
+
+int
+syscall_settrace(const char *name, bool on)
+{
+	struct syscallent *sc;
+	unsigned i;
+	bool found = false;
+
+	for (i=0; i<syscalltab_size; i++) {
+		sc = &syscalltab[i];
+		if (sc->sc_func == NULL) {
+			continue;
+		}
+		if (name == NULL || !strcmp(name, sc->sc_name)) {
+			sc->sc_trace = on;
+			found = true;
+		}
+	}
+	return found ? 0 : ENOENT;
+}
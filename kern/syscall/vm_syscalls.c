@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/mman.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <vnode.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <syscall.h>
+
+/*
+ * Memory-management system calls: sbrk and mmap and friends.
+ */
+
+int
+sys_sbrk(intptr_t amount, int32_t *retval)
+{
+	vaddr_t oldbrk;
+	int result;
+
+	result = as_sbrk(proc_getas(), amount, &oldbrk);
+	if (result) {
+		return result;
+	}
+	*retval = (int32_t)oldbrk;
+	return 0;
+}
+
+/*
+ * Get the vnode and open mode (O_ACCMODE bits) of the file open on
+ * FD, with a reference to the vnode.
+ */
+static
+int
+mmap_getfile(int fd, struct vnode **ret, int *accmode)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+	VOP_INCREF(file->of_vnode);
+	*ret = file->of_vnode;
+	*accmode = file->of_accmode;
+	openfile_decref(file);
+	return 0;
+}
+
+int
+sys_mmap(userptr_t addr, size_t len, int prot, int flags, int fd,
+	 off_t offset, int32_t *retval)
+{
+	struct addrspace *as;
+	struct vnode *v;
+	struct stat st;
+	vaddr_t vaddr;
+	size_t filesize;
+	int rgflags, accmode, result;
+
+	as = proc_getas();
+	vaddr = (vaddr_t)addr;
+
+	if (len == 0 || (prot & ~(PROT_READ|PROT_WRITE|PROT_EXEC)) != 0) {
+		return EINVAL;
+	}
+	if ((flags & (MAP_SHARED|MAP_PRIVATE)) == 0 ||
+	    (flags & (MAP_SHARED|MAP_PRIVATE)) == (MAP_SHARED|MAP_PRIVATE)) {
+		return EINVAL;
+	}
+	if ((flags & MAP_FIXED) && (vaddr & ~(vaddr_t)PAGE_FRAME) != 0) {
+		return EINVAL;
+	}
+	if (len > USERSPACETOP) {
+		return ENOMEM;
+	}
+
+	rgflags = 0;
+	if (prot & PROT_READ) {
+		rgflags |= RG_READ;
+	}
+	if (prot & PROT_WRITE) {
+		rgflags |= RG_WRITE;
+	}
+	if (prot & PROT_EXEC) {
+		rgflags |= RG_EXEC;
+	}
+
+	if (flags & MAP_ANON) {
+		/* Shared with no one, so the same as private. */
+		v = NULL;
+		offset = 0;
+		filesize = 0;
+	}
+	else {
+		if (offset < 0 || offset % PAGE_SIZE != 0) {
+			return EINVAL;
+		}
+		result = mmap_getfile(fd, &v, &accmode);
+		if (result) {
+			return result;
+		}
+		if (accmode == O_WRONLY ||
+		    ((flags & MAP_SHARED) && (prot & PROT_WRITE) &&
+		     accmode != O_RDWR)) {
+			result = EACCES;
+			goto out;
+		}
+		result = VOP_MMAP(v);
+		if (result) {
+			goto out;
+		}
+
+		/* Past the end of the file is zeros, not written back. */
+		result = VOP_STAT(v, &st);
+		if (result) {
+			goto out;
+		}
+		filesize = 0;
+		if (st.st_size > offset) {
+			filesize = st.st_size - offset < (off_t)len ?
+				st.st_size - offset : len;
+		}
+		if (flags & MAP_SHARED) {
+			rgflags |= RG_SHARED;
+		}
+	}
+
+	result = as_mmap(as, &vaddr, len, rgflags, (flags & MAP_FIXED) != 0,
+			 v, offset, filesize);
+	if (result == 0) {
+		*retval = (int32_t)vaddr;
+	}
+ out:
+	if (v != NULL) {
+		VOP_DECREF(v);
+	}
+	return result;
+}
+
+int
+sys_munmap(userptr_t addr, size_t len)
+{
+	return as_munmap(proc_getas(), (vaddr_t)addr, len);
+}
+
+int
+sys_msync(userptr_t addr, size_t len, int flags)
+{
+	if ((flags & ~(MS_ASYNC|MS_SYNC|MS_INVALIDATE)) != 0 ||
+	    (flags & (MS_ASYNC|MS_SYNC)) == (MS_ASYNC|MS_SYNC)) {
+		return EINVAL;
+	}
+	return as_msync(proc_getas(), (vaddr_t)addr, len);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * elfbench - exec latency benchmark.
+ *
+ * Loads a program into a scratch address space over and over, first
+ * reading every segment in up front (load_elf_eager) and then mapping
+ * the segments to be paged in as they are touched (load_elf), and
+ * prints the average time per load for each. After each load the
+ * word at the entry point is read, as the program's first instruction
+ * fetch would, so lazy loading pays for the one page every program
+ * touches.
+ *
+ * Usage: elf [program [count]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <clock.h>
+#include <copyinout.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <test.h>
+
+#define ELFBENCH_PROG	"/testbin/huge"
+#define ELFBENCH_COUNT	20
+
+/*
+ * Load PROG once with LOADFUNC into a fresh address space, then throw
+ * the address space away again.
+ */
+static
+int
+elfbench_load1(const char *prog,
+	       int (*loadfunc)(struct vnode *, vaddr_t *))
+{
+	struct addrspace *as, *oldas;
+	struct vnode *v;
+	vaddr_t entrypoint;
+	uint32_t word;
+	char *path;
+	int result;
+
+	/* vfs_open destroys the string it's passed */
+	path = kstrdup(prog);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = vfs_open(path, O_RDONLY, 0, &v);
+	kfree(path);
+	if (result) {
+		return result;
+	}
+
+	as = as_create();
+	if (as == NULL) {
+		vfs_close(v);
+		return ENOMEM;
+	}
+	oldas = proc_setas(as);
+	as_activate();
+
+	result = loadfunc(v, &entrypoint);
+	if (result == 0) {
+		result = copyin((const_userptr_t)entrypoint, &word,
+				sizeof(word));
+	}
+
+	as_deactivate();
+	proc_setas(oldas);
+	as_activate();
+	as_destroy(as);
+	vfs_close(v);
+	return result;
+}
+
+/*
+ * Time COUNT loads of PROG with LOADFUNC and print the average.
+ */
+static
+int
+elfbench_run(const char *name, const char *prog, unsigned count,
+	     int (*loadfunc)(struct vnode *, vaddr_t *))
+{
+	struct timespec before, after;
+	uint32_t us;
+	unsigned i;
+	int result;
+
+	gettime(&before);
+	for (i=0; i<count; i++) {
+		result = elfbench_load1(prog, loadfunc);
+		if (result) {
+			kprintf("elfbench: %s: %s\n", prog, strerror(result));
+			return result;
+		}
+	}
+	gettime(&after);
+
+	/* after -= before */
+	timespec_sub(&after, &before, &after);
+	us = after.tv_sec * 1000000 + after.tv_nsec / 1000;
+	kprintf("elfbench: %s: %u loads, %u us per load\n", name, count,
+		us / count);
+	return 0;
+}
+
+int
+elfbench(int nargs, char **args)
+{
+	const char *prog;
+	unsigned count;
+	int result;
+
+	prog = nargs > 1 ? args[1] : ELFBENCH_PROG;
+	count = nargs > 2 ? atoi(args[2]) : ELFBENCH_COUNT;
+	if (count == 0) {
+		kprintf("Usage: elf [program [count]]\n");
+		return EINVAL;
+	}
+
+	kprintf("Starting ELF load benchmark on %s...\n", prog);
+
+	/* One untimed load, so both runs start with a warm buffer cache. */
+	result = elfbench_load1(prog, load_elf_eager);
+	if (result) {
+		kprintf("elfbench: %s: %s\n", prog, strerror(result));
+		return result;
+	}
+
+	result = elfbench_run("eager", prog, count, load_elf_eager);
+	if (result) {
+		return result;
+	}
+	result = elfbench_run("lazy", prog, count, load_elf);
+	if (result) {
+		return result;
+	}
+
+	kprintf("ELF load benchmark done.\n");
+	return 0;
+}
@@ -379,3 +379,115 @@ kmalloctest4(int nargs, char **args)
 	kprintf("Multipage kmalloc test done\n");
 	return 0;
 }
+
+////////////////////////////////////////////////////////////
+// km5
+
+/*
+ * Fragmented large allocation test. Take every free frame, one at a
+ * time, and give back the ones with even page numbers, so that half
+ * of what was free is free again but no two free frames are next to
+ * each other. Check that a physically contiguous allocation of even
+ * two pages now fails, then ask kmalloc for NPAGES pages, which can
+ * only come from the kva arena. Fill the buffer with a pattern and
+ * check it.
+ *
+ * This needs the frame table: dumbvm never gives frames back.
+ */
+int
+kmalloctest5(int nargs, char **args)
+{
+#if OPT_UNSW
+	unsigned npages, maxframes, nframes, nfree, i;
+	vaddr_t *frames, va;
+	uint32_t *big;
+	size_t nwords;
+	int result;
+
+	if (nargs > 2) {
+		kprintf("kmalloctest5: usage: km5 [npages]\n");
+		return EINVAL;
+	}
+	npages = (nargs == 2) ? (unsigned)atoi(args[1]) : 32;
+	if (npages < 2) {
+		kprintf("kmalloctest5: need at least 2 pages\n");
+		return EINVAL;
+	}
+
+	kprintf("Starting fragmented large kmalloc test...\n");
+
+	maxframes = frame_nframes();
+	frames = kmalloc(maxframes * sizeof(frames[0]));
+	if (frames == NULL) {
+		panic("kmalloctest5: failed on frame array\n");
+	}
+	for (nframes = 0; nframes < maxframes; nframes++) {
+		frames[nframes] = alloc_kpages(1);
+		if (frames[nframes] == 0) {
+			break;
+		}
+	}
+	nfree = 0;
+	for (i=0; i<nframes; i++) {
+		if ((KVADDR_TO_PADDR(frames[i]) / PAGE_SIZE) % 2 == 0) {
+			free_kpages(frames[i]);
+			frames[i] = 0;
+			nfree++;
+		}
+	}
+	kprintf("kmalloctest5: %u of %u free frames left, none adjacent\n",
+		nfree, nframes);
+
+	va = alloc_kpages(2);
+	if (va != 0) {
+		panic("kmalloctest5: got 2 contiguous pages at 0x%x\n", va);
+	}
+
+	if (npages + 8 > nfree) {
+		/* leave some for everyone else */
+		kprintf("kmalloctest5: not enough memory for %u pages\n",
+			npages);
+		result = ENOMEM;
+	}
+	else {
+		big = kmalloc(npages * PAGE_SIZE);
+		if (big == NULL) {
+			panic("kmalloctest5: %u page allocation failed\n",
+			      npages);
+		}
+		kprintf("kmalloctest5: %u pages at %p\n", npages, big);
+
+		nwords = npages * PAGE_SIZE / sizeof(uint32_t);
+		for (i=0; i<nwords; i++) {
+			big[i] = i ^ 0xdeadbeef;
+		}
+		for (i=0; i<nwords; i++) {
+			if (big[i] != (i ^ 0xdeadbeef)) {
+				panic("kmalloctest5: word %u: expected 0x%x, "
+				      "found 0x%x\n", i, i ^ 0xdeadbeef,
+				      big[i]);
+			}
+		}
+		kfree(big);
+		result = 0;
+	}
+
+	for (i=0; i<nframes; i++) {
+		if (frames[i] != 0) {
+			free_kpages(frames[i]);
+		}
+	}
+	kfree(frames);
+
+	if (result == 0) {
+		kprintf("kmalloctest5: passed\n");
+	}
+	return result;
+#else
+	(void)nargs;
+	(void)args;
+	kprintf("kmalloctest5: needs options unsw; dumbvm never frees "
+		"pages\n");
+	return 0;
+#endif
+}
@@ -59,6 +59,13 @@
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+/*
+ * Pending clock timers, soonest first. CPU 0 runs the ones that are
+ * due on each hardclock.
+ */
+static struct clocktimer *clocktimers;
+static struct spinlock clocktimer_lock;
+
 /*
  * Setup.
  */
@@ -66,6 +73,8 @@ void
 hardclock_bootstrap(void)
 {
 	spinlock_init(&lbolt_lock);
+	spinlock_init(&clocktimer_lock);
+	clocktimers = NULL;
 	lbolt = wchan_create("lbolt");
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
@@ -85,6 +94,86 @@ timerclock(void)
 	spinlock_release(&lbolt_lock);
 }
 
+/*
+ * Whether time A is before or at time B.
+ */
+static
+bool
+clock_notafter(const struct timespec *a, const struct timespec *b)
+{
+	if (a->tv_sec != b->tv_sec) {
+		return a->tv_sec < b->tv_sec;
+	}
+	return a->tv_nsec <= b->tv_nsec;
+}
+
+/*
+ * Run the clock timers that are due. The list is usually empty, so
+ * look at it without the lock first.
+ */
+static
+void
+clocktimer_run(void)
+{
+	struct timespec now;
+	struct clocktimer *ct;
+
+	if (clocktimers == NULL) {
+		return;
+	}
+
+	spinlock_acquire(&clocktimer_lock);
+	gettime(&now);
+	while (clocktimers != NULL &&
+	       clock_notafter(&clocktimers->ct_when, &now)) {
+		ct = clocktimers;
+		clocktimers = ct->ct_next;
+		ct->ct_pending = false;
+		ct->ct_func(ct->ct_data);
+	}
+	spinlock_release(&clocktimer_lock);
+}
+
+void
+clocktimer_start(struct clocktimer *ct, const struct timespec *delay,
+		 void (*func)(void *), void *data)
+{
+	struct clocktimer **ctp;
+	struct timespec now;
+
+	gettime(&now);
+	timespec_add(&now, delay, &ct->ct_when);
+	ct->ct_func = func;
+	ct->ct_data = data;
+
+	spinlock_acquire(&clocktimer_lock);
+	ctp = &clocktimers;
+	while (*ctp != NULL && clock_notafter(&(*ctp)->ct_when, &ct->ct_when)) {
+		ctp = &(*ctp)->ct_next;
+	}
+	ct->ct_next = *ctp;
+	*ctp = ct;
+	ct->ct_pending = true;
+	spinlock_release(&clocktimer_lock);
+}
+
+void
+clocktimer_stop(struct clocktimer *ct)
+{
+	struct clocktimer **ctp;
+
+	spinlock_acquire(&clocktimer_lock);
+	if (ct->ct_pending) {
+		ctp = &clocktimers;
+		while (*ctp != ct) {
+			ctp = &(*ctp)->ct_next;
+		}
+		*ctp = ct->ct_next;
+		ct->ct_pending = false;
+	}
+	spinlock_release(&clocktimer_lock);
+}
+
 /*
  * This is called HZ times a second (on each processor) by the timer
  * code.
@@ -97,6 +186,9 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	if (curcpu->c_number == 0) {
+		clocktimer_run();
+	}
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
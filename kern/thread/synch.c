@@ -120,6 +120,28 @@ P(struct semaphore *sem)
 	spinlock_release(&sem->sem_lock);
 }
 
+int
+P_intr(struct semaphore *sem)
+{
+	int result;
+
+	KASSERT(sem != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
+
+	spinlock_acquire(&sem->sem_lock);
+	while (sem->sem_count == 0) {
+		result = wchan_sleep_intr(sem->sem_wchan, &sem->sem_lock);
+		if (result) {
+			spinlock_release(&sem->sem_lock);
+			return result;
+		}
+	}
+	KASSERT(sem->sem_count > 0);
+	sem->sem_count--;
+	spinlock_release(&sem->sem_lock);
+	return 0;
+}
+
 void
 V(struct semaphore *sem)
 {
@@ -298,6 +320,19 @@ cv_wait(struct cv *cv, struct lock *lock)
 	lock_acquire(lock);
 }
 
+int
+cv_wait_intr(struct cv *cv, struct lock *lock)
+{
+	int result;
+
+	spinlock_acquire(&cv->cv_wchanlock);
+	lock_release(lock);
+	result = wchan_sleep_intr(cv->cv_wchan, &cv->cv_wchanlock);
+	spinlock_release(&cv->cv_wchanlock);
+	lock_acquire(lock);
+	return result;
+}
+
 void
 cv_signal(struct cv *cv, struct lock *lock)
 {
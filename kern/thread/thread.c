@@ -149,6 +149,14 @@ thread_create(const char *name)
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
 
+	/* Killing */
+	spinlock_init(&thread->t_killlock);
+	thread->t_killed = false;
+	thread->t_sleepwchan = NULL;
+	thread->t_sleeplock = NULL;
+	thread->t_sleeppins = 0;
+	thread->t_procnext = NULL;
+
 	/* If you add to struct thread, be sure to initialize here */
 
 	return thread;
@@ -181,6 +189,7 @@ cpu_create(unsigned hardware_number)
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
 	c->c_spinlocks = 0;
+	c->c_asidgen = 0;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -188,6 +197,8 @@ cpu_create(unsigned hardware_number)
 
 	c->c_ipi_pending = 0;
 	c->c_numshootdown = 0;
+	c->c_shootdowns_sent = 0;
+	c->c_shootdowns_done = 0;
 	spinlock_init(&c->c_ipi_lock);
 
 	result = cpuarray_add(&allcpus, c, &c->c_number);
@@ -195,6 +206,9 @@ cpu_create(unsigned hardware_number)
 		panic("cpu_create: array_add: %s\n", strerror(result));
 	}
 
+	/* The boot cpu is already running; the others start later. */
+	c->c_ipi_live = c->c_number == 0;
+
 	snprintf(namebuf, sizeof(namebuf), "<boot #%d>", c->c_number);
 	c->c_curthread = thread_create(namebuf);
 	if (c->c_curthread == NULL) {
@@ -282,6 +296,9 @@ thread_destroy(struct thread *thread)
 	threadlistnode_cleanup(&thread->t_listnode);
 	thread_machdep_cleanup(&thread->t_machdep);
 
+	KASSERT(thread->t_sleepwchan == NULL && thread->t_sleeppins == 0);
+	spinlock_cleanup(&thread->t_killlock);
+
 	/* sheer paranoia */
 	thread->t_wchan_name = "DESTROYED";
 
@@ -413,6 +430,10 @@ cpu_hatch(unsigned software_number)
 	KASSERT(curthread != NULL);
 	KASSERT(curcpu->c_number == software_number);
 
+	spinlock_acquire(&curcpu->c_ipi_lock);
+	curcpu->c_ipi_live = true;
+	spinlock_release(&curcpu->c_ipi_lock);
+
 	spl0();
 	cpu_identify(buf, sizeof(buf));
 
@@ -796,10 +817,11 @@ thread_exit(void)
 	cur = curthread;
 
 	/*
-	 * Detach from our process. You might need to move this action
-	 * around, depending on how your wait/exit works.
+	 * Detach from our process, unless proc_exit already has.
 	 */
-	proc_remthread(cur);
+	if (cur->t_proc != NULL) {
+		proc_remthread(cur);
+	}
 
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
@@ -1025,6 +1047,83 @@ wchan_sleep(struct wchan *wc, struct spinlock *lk)
 	spinlock_acquire(lk);
 }
 
+/*
+ * Interruptible sleep. Before sleeping, record where we sleep so that
+ * thread_kill can wake us; it checks t_killed under t_killlock, so
+ * either it sees our record or we see the flag.
+ *
+ * thread_kill uses the record after dropping t_killlock, so it pins
+ * it; the channel mustn't go away while it's pinned, so wait for it
+ * to be unpinned before returning. thread_kill needs LK for that, so
+ * wait without it.
+ */
+int
+wchan_sleep_intr(struct wchan *wc, struct spinlock *lk)
+{
+	struct thread *cur = curthread;
+	bool killed;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	spinlock_acquire(&cur->t_killlock);
+	killed = cur->t_killed;
+	if (!killed) {
+		cur->t_sleepwchan = wc;
+		cur->t_sleeplock = lk;
+	}
+	spinlock_release(&cur->t_killlock);
+	if (killed) {
+		return EINTR;
+	}
+
+	wchan_sleep(wc, lk);
+
+	spinlock_acquire(&cur->t_killlock);
+	cur->t_sleepwchan = NULL;
+	cur->t_sleeplock = NULL;
+	if (cur->t_sleeppins > 0) {
+		spinlock_release(lk);
+		while (cur->t_sleeppins > 0) {
+			spinlock_release(&cur->t_killlock);
+			thread_yield();
+			spinlock_acquire(&cur->t_killlock);
+		}
+		spinlock_release(&cur->t_killlock);
+		spinlock_acquire(lk);
+		spinlock_acquire(&cur->t_killlock);
+	}
+	killed = cur->t_killed;
+	spinlock_release(&cur->t_killlock);
+
+	return killed ? EINTR : 0;
+}
+
+void
+thread_kill(struct thread *t)
+{
+	struct wchan *wc;
+	struct spinlock *lk;
+
+	spinlock_acquire(&t->t_killlock);
+	t->t_killed = true;
+	wc = t->t_sleepwchan;
+	lk = t->t_sleeplock;
+	if (wc != NULL) {
+		t->t_sleeppins++;
+	}
+	spinlock_release(&t->t_killlock);
+
+	if (wc != NULL) {
+		spinlock_acquire(lk);
+		wchan_wakeall(wc, lk);
+		spinlock_release(lk);
+
+		spinlock_acquire(&t->t_killlock);
+		t->t_sleeppins--;
+		spinlock_release(&t->t_killlock);
+	}
+}
+
 /*
  * Wake up one thread sleeping on a wait channel.
  */
@@ -1141,6 +1240,9 @@ ipi_broadcast(int code)
 
 /*
  * Send a TLB shootdown IPI to the specified CPU.
+ *
+ * If too many requests are already queued, the target flushes its
+ * entire TLB instead of handling them one at a time.
  */
 void
 ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
@@ -1150,22 +1252,19 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 	spinlock_acquire(&target->c_ipi_lock);
 
 	n = target->c_numshootdown;
-	if (n == TLBSHOOTDOWN_MAX) {
+	if (n >= TLBSHOOTDOWN_MAX) {
 		/*
-		 * If you have problems with this panic going off,
-		 * consider: (1) increasing the maximum, (2) putting
-		 * logic here to sleep until space appears (may
-		 * interact awkwardly with VM system locking), (3)
-		 * putting logic here to coalesce requests together,
-		 * and/or (4) improving VM system state tracking to
-		 * reduce the number of unnecessary shootdowns.
+		 * The queue is full. Rather than wait for space,
+		 * coalesce everything into a flush of the whole TLB;
+		 * c_numshootdown > TLBSHOOTDOWN_MAX says to do that.
 		 */
-		panic("ipi_tlbshootdown: Too many shootdowns queued\n");
+		target->c_numshootdown = TLBSHOOTDOWN_MAX + 1;
 	}
 	else {
 		target->c_shootdown[n] = *mapping;
 		target->c_numshootdown = n+1;
 	}
+	target->c_shootdowns_sent++;
 
 	target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
 	mainbus_send_ipi(target);
@@ -1173,6 +1272,109 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 	spinlock_release(&target->c_ipi_lock);
 }
 
+/*
+ * Carry out the shootdowns queued for the current CPU. Called with
+ * its IPI lock held.
+ */
+static
+void
+ipi_doshootdowns(void)
+{
+	unsigned i;
+
+	KASSERT(spinlock_do_i_hold(&curcpu->c_ipi_lock));
+
+	if (curcpu->c_numshootdown > TLBSHOOTDOWN_MAX) {
+		vm_tlbshootdown_all();
+	}
+	else {
+		for (i=0; i<curcpu->c_numshootdown; i++) {
+			vm_tlbshootdown(&curcpu->c_shootdown[i]);
+		}
+	}
+	curcpu->c_numshootdown = 0;
+	curcpu->c_shootdowns_done = curcpu->c_shootdowns_sent;
+	curcpu->c_ipi_pending &= ~((uint32_t)1 << IPI_TLBSHOOTDOWN);
+}
+
+/*
+ * Send a TLB shootdown IPI to all CPUs except the current one.
+ */
+void
+ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping)
+{
+	unsigned i;
+	struct cpu *c;
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self) {
+			ipi_tlbshootdown(c, mapping);
+		}
+	}
+}
+
+/*
+ * Send a TLB shootdown IPI to the CPUs in the bitmask CPUS.
+ */
+void
+ipi_tlbshootdown_some(uint32_t cpus, const struct tlbshootdown *mapping)
+{
+	unsigned i;
+	struct cpu *c;
+
+	for (i=0; i < cpuarray_num(&allcpus) && i < 32; i++) {
+		if ((cpus & ((uint32_t)1 << i)) == 0) {
+			continue;
+		}
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self) {
+			ipi_tlbshootdown(c, mapping);
+		}
+	}
+}
+
+/*
+ * Wait for every other CPU to carry out the shootdowns sent to it so
+ * far. Another CPU may be waiting for us in the same way, possibly
+ * with interrupts off, so handle our own while we wait.
+ */
+void
+ipi_tlbshootdown_wait(void)
+{
+	unsigned i, sent;
+	struct cpu *c;
+	bool done;
+	int spl;
+
+	KASSERT(curcpu->c_spinlocks == 0);
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+
+		spinlock_acquire(&c->c_ipi_lock);
+		sent = c->c_shootdowns_sent;
+		spinlock_release(&c->c_ipi_lock);
+
+		do {
+			/* splhigh so we stay on the cpu we looked at */
+			spl = splhigh();
+			spinlock_acquire(&curcpu->c_ipi_lock);
+			if (curcpu->c_ipi_pending &
+			    (1U << IPI_TLBSHOOTDOWN)) {
+				ipi_doshootdowns();
+			}
+			spinlock_release(&curcpu->c_ipi_lock);
+			splx(spl);
+
+			spinlock_acquire(&c->c_ipi_lock);
+			done = !c->c_ipi_live ||
+				(int)(c->c_shootdowns_done - sent) >= 0;
+			spinlock_release(&c->c_ipi_lock);
+		} while (!done);
+	}
+}
+
 /*
  * Handle an incoming interprocessor interrupt.
  */
@@ -1180,18 +1382,19 @@ void
 interprocessor_interrupt(void)
 {
 	uint32_t bits;
-	unsigned i;
 
 	spinlock_acquire(&curcpu->c_ipi_lock);
 	bits = curcpu->c_ipi_pending;
 
 	if (bits & (1U << IPI_PANIC)) {
 		/* panic on another cpu - just stop dead */
+		curcpu->c_ipi_live = false;
 		spinlock_release(&curcpu->c_ipi_lock);
 		cpu_halt();
 	}
 	if (bits & (1U << IPI_OFFLINE)) {
 		/* offline request */
+		curcpu->c_ipi_live = false;
 		spinlock_release(&curcpu->c_ipi_lock);
 		spinlock_acquire(&curcpu->c_runqueue_lock);
 		if (!curcpu->c_isidle) {
@@ -1214,10 +1417,7 @@ interprocessor_interrupt(void)
 		 * need to release the ipi lock while calling
 		 * vm_tlbshootdown.
 		 */
-		for (i=0; i<curcpu->c_numshootdown; i++) {
-			vm_tlbshootdown(&curcpu->c_shootdown[i]);
-		}
-		curcpu->c_numshootdown = 0;
+		ipi_doshootdowns();
 	}
 
 	curcpu->c_ipi_pending = 0;
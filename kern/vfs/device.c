@@ -41,6 +41,7 @@
 #include <uio.h>
 #include <synch.h>
 #include <vnode.h>
+#include <poll.h>
 #include <device.h>
 
 /*
@@ -236,13 +237,29 @@ null_fsync(struct vnode *v)
 	return 0;
 }
 
+/*
+ * For poll(). Pass through if the device waits for anything;
+ * otherwise it's always ready.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, struct pollwaiter *pw)
+{
+	struct device *d = v->vn_data;
+
+	if (d->d_ops->devop_poll == NULL) {
+		return vopready_poll(v, events, pw);
+	}
+	return DEVOP_POLL(d, events, pw);
+}
+
 /*
  * For mmap. If you want this to do anything, you have to write it
  * yourself. Some devices may not make sense to map. Others do.
  */
 static
 int
-dev_mmap(struct vnode *v  /* add stuff as needed */)
+dev_mmap(struct vnode *v)
 {
 	(void)v;
 	return ENOSYS;
@@ -336,6 +353,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	.vop_gettype = dev_gettype,
 	.vop_isseekable = dev_isseekable,
 	.vop_fsync = null_fsync,
+	.vop_poll = dev_poll,
 	.vop_mmap = dev_mmap,
 	.vop_truncate = dev_truncate,
 	.vop_namefile = dev_namefile,
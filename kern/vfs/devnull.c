@@ -92,6 +92,7 @@ static const struct device_ops null_devops = {
 	.devop_eachopen = nullopen,
 	.devop_io = nullio,
 	.devop_ioctl = nullioctl,
+	.devop_poll = NULL,
 };
 
 /*
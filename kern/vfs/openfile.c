@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Open file objects. See openfile.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <synch.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <openfile.h>
+
+int
+openfile_open(char *path, int openflags, mode_t mode, struct openfile **ret)
+{
+	struct vnode *v;
+	int result;
+
+	result = vfs_open(path, openflags, mode, &v);
+	if (result) {
+		return result;
+	}
+
+	result = openfile_create(v, openflags, ret);
+	if (result) {
+		vfs_close(v);
+		return result;
+	}
+	return 0;
+}
+
+int
+openfile_create(struct vnode *v, int openflags, struct openfile **ret)
+{
+	struct openfile *file;
+
+	file = kmalloc(sizeof(*file));
+	if (file == NULL) {
+		return ENOMEM;
+	}
+	file->of_offsetlock = lock_create("openfile");
+	if (file->of_offsetlock == NULL) {
+		kfree(file);
+		return ENOMEM;
+	}
+
+	file->of_vnode = v;
+	file->of_accmode = openflags & O_ACCMODE;
+	file->of_append = (openflags & O_APPEND) != 0;
+	file->of_seekable = VOP_ISSEEKABLE(v);
+	file->of_offset = 0;
+	spinlock_init(&file->of_countlock);
+	file->of_refcount = 1;
+
+	*ret = file;
+	return 0;
+}
+
+void
+openfile_incref(struct openfile *file)
+{
+	spinlock_acquire(&file->of_countlock);
+	file->of_refcount++;
+	spinlock_release(&file->of_countlock);
+}
+
+void
+openfile_decref(struct openfile *file)
+{
+	bool last;
+
+	spinlock_acquire(&file->of_countlock);
+	KASSERT(file->of_refcount > 0);
+	file->of_refcount--;
+	last = file->of_refcount == 0;
+	spinlock_release(&file->of_countlock);
+
+	if (last) {
+		vfs_close(file->of_vnode);
+		lock_destroy(file->of_offsetlock);
+		spinlock_cleanup(&file->of_countlock);
+		kfree(file);
+	}
+}
@@ -0,0 +1,739 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Pipes.
+ *
+ * The data lives in a one-page ring buffer. Readers and writers sleep
+ * on a condition variable apiece, but a sleeping writer is only woken
+ * once there's as much room as it asked for (half the ring for a big
+ * write), and readers are woken once per write rather than once per
+ * byte, so a steady stream moves about a page per context switch.
+ * Each end also has a pollqueue, woken along with the CVs.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/ioctl.h>
+#include <kern/poll.h>
+#include <limits.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <vm.h>
+#include <vnode.h>
+#include <poll.h>
+#include <pipe.h>
+
+#define PIPE_SIZE	PAGE_SIZE
+#define PIPE_LOWAT	(PIPE_SIZE / 2)	/* least room a big write waits for */
+
+struct pipe {
+	struct lock *pp_lock;		/* protects everything below */
+	struct cv *pp_readcv;		/* readers wait here for data */
+	struct cv *pp_writecv;		/* writers wait here for room */
+	char *pp_buf;			/* the ring */
+	unsigned pp_head;		/* where the oldest byte is */
+	unsigned pp_count;		/* how many bytes are in the ring */
+	unsigned pp_readwaiters;	/* threads asleep on pp_readcv */
+	unsigned pp_writewaiters;	/* threads asleep on pp_writecv */
+	unsigned pp_writeneed;		/* least room a sleeping writer wants */
+	bool pp_readopen;		/* read end still has references */
+	bool pp_writeopen;		/* write end still has references */
+	bool pp_rnonblock;		/* read end is non-blocking */
+	bool pp_wnonblock;		/* write end is non-blocking */
+	struct pollqueue pp_readpoll;	/* poll() waits here for data */
+	struct pollqueue pp_writepoll;	/* poll() waits here for room */
+	struct vnode pp_readend;
+	struct vnode pp_writeend;
+};
+
+static const struct vnode_ops pipe_readops;
+static const struct vnode_ops pipe_writeops;
+
+////////////////////////////////////////////////////////////
+// the ring
+
+/*
+ * Wake readers if any are asleep and there's something for them.
+ * Writers call this when they finish (or are about to sleep), not
+ * after every chunk.
+ */
+static
+void
+pipe_wakereaders(struct pipe *pp)
+{
+	if (pp->pp_count == 0) {
+		return;
+	}
+	if (pp->pp_readwaiters > 0) {
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+	}
+	pollqueue_wakeup(&pp->pp_readpoll);
+}
+
+/*
+ * Wake writers if any are asleep and there's now as much room as the
+ * least demanding of them wants. Any that still don't fit lower
+ * pp_writeneed again when they go back to sleep. Pollers count the
+ * pipe writable once PIPE_BUF bytes fit.
+ */
+static
+void
+pipe_wakewriters(struct pipe *pp)
+{
+	if (PIPE_SIZE - pp->pp_count >= PIPE_BUF) {
+		pollqueue_wakeup(&pp->pp_writepoll);
+	}
+	if (pp->pp_writewaiters > 0 &&
+	    PIPE_SIZE - pp->pp_count >= pp->pp_writeneed) {
+		pp->pp_writeneed = PIPE_SIZE;
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+	}
+}
+
+/*
+ * Wait until there's data to read or the write end is gone. Returns
+ * with pp_count 0 only at end of file. Fails with EINTR if the thread
+ * is killed (see thread_kill).
+ */
+static
+int
+pipe_waitdata(struct pipe *pp)
+{
+	int result;
+
+	while (pp->pp_count == 0 && pp->pp_writeopen) {
+		if (pp->pp_rnonblock) {
+			return EAGAIN;
+		}
+		pp->pp_readwaiters++;
+		result = cv_wait_intr(pp->pp_readcv, pp->pp_lock);
+		pp->pp_readwaiters--;
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * How much room a write with RESID bytes left should wait for. Writes
+ * of PIPE_BUF or less go in all at once, as POSIX requires. Bigger
+ * ones wait for half the ring, so they move a decent chunk per
+ * wakeup, except that a non-blocking one takes whatever there is.
+ */
+static
+unsigned
+pipe_writeneed(struct pipe *pp, size_t resid)
+{
+	if (resid <= PIPE_BUF) {
+		return resid;
+	}
+	if (pp->pp_wnonblock) {
+		return 1;
+	}
+	return resid < PIPE_LOWAT ? resid : PIPE_LOWAT;
+}
+
+/*
+ * Wait until there are NEED bytes of room. Fails with EPIPE if the
+ * read end goes away, or EINTR if the thread is killed.
+ */
+static
+int
+pipe_waitroom(struct pipe *pp, unsigned need)
+{
+	int result;
+
+	while (pp->pp_readopen && PIPE_SIZE - pp->pp_count < need) {
+		if (pp->pp_wnonblock) {
+			return EAGAIN;
+		}
+		/* Let the reader at what's already there. */
+		pipe_wakereaders(pp);
+		if (need < pp->pp_writeneed) {
+			pp->pp_writeneed = need;
+		}
+		pp->pp_writewaiters++;
+		result = cv_wait_intr(pp->pp_writecv, pp->pp_lock);
+		pp->pp_writewaiters--;
+		if (result) {
+			return result;
+		}
+	}
+	return pp->pp_readopen ? 0 : EPIPE;
+}
+
+/*
+ * Set up UIO with IOV (two entries) to cover LEN bytes of the ring
+ * starting at START, for VOP_READ or VOP_WRITE on another vnode.
+ */
+static
+void
+pipe_ringuio(struct pipe *pp, unsigned start, size_t len, off_t pos,
+	     enum uio_rw rw, struct iovec *iov, struct uio *uio)
+{
+	size_t first;
+
+	first = PIPE_SIZE - start;
+	if (first > len) {
+		first = len;
+	}
+	iov[0].iov_kbase = pp->pp_buf + start;
+	iov[0].iov_len = first;
+	iov[1].iov_kbase = pp->pp_buf;
+	iov[1].iov_len = len - first;
+	uio->uio_iov = iov;
+	uio->uio_iovcnt = len > first ? 2 : 1;
+	uio->uio_offset = pos;
+	uio->uio_resid = len;
+	uio->uio_segflg = UIO_SYSSPACE;
+	uio->uio_rw = rw;
+	uio->uio_space = NULL;
+}
+
+/*
+ * Move LEN bytes between the ring, starting at START, and UIO.
+ */
+static
+int
+pipe_uiomove(struct pipe *pp, unsigned start, size_t len, struct uio *uio)
+{
+	size_t first;
+	int result;
+
+	first = PIPE_SIZE - start;
+	if (first > len) {
+		first = len;
+	}
+	result = uiomove(pp->pp_buf + start, first, uio);
+	if (result == 0 && len > first) {
+		result = uiomove(pp->pp_buf, len - first, uio);
+	}
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// vnode operations
+
+/*
+ * Read: wait for data, then take as much as there is, up to the
+ * size of the request.
+ */
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe *pp = v->vn_data;
+	size_t len, before, moved;
+	int result;
+
+	KASSERT(v == &pp->pp_readend);
+
+	lock_acquire(pp->pp_lock);
+	result = pipe_waitdata(pp);
+	if (result == 0 && pp->pp_count > 0) {
+		len = pp->pp_count;
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		before = uio->uio_resid;
+		result = pipe_uiomove(pp, pp->pp_head, len, uio);
+		moved = before - uio->uio_resid;
+		pp->pp_head = (pp->pp_head + moved) % PIPE_SIZE;
+		pp->pp_count -= moved;
+		pipe_wakewriters(pp);
+	}
+	lock_release(pp->pp_lock);
+	return result;
+}
+
+/*
+ * Write: keep filling the ring until everything's in, waiting for
+ * room as pipe_writeneed says. A short write is only an error if
+ * nothing at all went in.
+ */
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe *pp = v->vn_data;
+	size_t start, len, before;
+	unsigned tail;
+	int result = 0;
+
+	KASSERT(v == &pp->pp_writeend);
+
+	lock_acquire(pp->pp_lock);
+	start = uio->uio_resid;
+	while (uio->uio_resid > 0) {
+		result = pipe_waitroom(pp,
+				       pipe_writeneed(pp, uio->uio_resid));
+		if (result) {
+			break;
+		}
+		len = PIPE_SIZE - pp->pp_count;
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		tail = (pp->pp_head + pp->pp_count) % PIPE_SIZE;
+		before = uio->uio_resid;
+		result = pipe_uiomove(pp, tail, len, uio);
+		pp->pp_count += before - uio->uio_resid;
+		if (result) {
+			break;
+		}
+	}
+	pipe_wakereaders(pp);
+	lock_release(pp->pp_lock);
+
+	if ((result == EAGAIN || result == EPIPE || result == EINTR) &&
+	    uio->uio_resid < start) {
+		result = 0;
+	}
+	return result;
+}
+
+/*
+ * Free a pipe. Also used to clean up after a failed pipe_create, so
+ * it copes with a partly made one.
+ */
+static
+void
+pipe_destroy(struct pipe *pp)
+{
+	pollqueue_cleanup(&pp->pp_writepoll);
+	pollqueue_cleanup(&pp->pp_readpoll);
+	if (pp->pp_writecv != NULL) {
+		cv_destroy(pp->pp_writecv);
+	}
+	if (pp->pp_readcv != NULL) {
+		cv_destroy(pp->pp_readcv);
+	}
+	if (pp->pp_lock != NULL) {
+		lock_destroy(pp->pp_lock);
+	}
+	if (pp->pp_buf != NULL) {
+		free_kpages((vaddr_t)pp->pp_buf);
+	}
+	kfree(pp);
+}
+
+/*
+ * The last reference to one end has gone. Wake up whoever's waiting
+ * at the other end: readers to see end of file, writers to get EPIPE.
+ * Once both ends are gone, so is the pipe.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe *pp = v->vn_data;
+	bool gone;
+
+	lock_acquire(pp->pp_lock);
+	/*
+	 * Both ends are inside PP, so once the other end sees ours is
+	 * gone it may free PP and V with it; finish with V first.
+	 */
+	vnode_cleanup(v);
+	if (v == &pp->pp_readend) {
+		pp->pp_readopen = false;
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+		pollqueue_wakeup(&pp->pp_writepoll);
+	}
+	else {
+		pp->pp_writeopen = false;
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+		pollqueue_wakeup(&pp->pp_readpoll);
+	}
+	gone = !pp->pp_readopen && !pp->pp_writeopen;
+	lock_release(pp->pp_lock);
+
+	if (gone) {
+		pipe_destroy(pp);
+	}
+	return 0;
+}
+
+/*
+ * Pipes aren't in the namespace, so they can't be opened by name.
+ */
+static
+int
+pipe_eachopen(struct vnode *v, int flags)
+{
+	(void)v;
+	(void)flags;
+	return EINVAL;
+}
+
+/*
+ * ioctl: FIONBIO sets or clears non-blocking mode for this end.
+ */
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	struct pipe *pp = v->vn_data;
+	int on, result;
+
+	if (op != FIONBIO) {
+		return EIOCTL;
+	}
+	result = copyin(data, &on, sizeof(on));
+	if (result) {
+		return result;
+	}
+
+	lock_acquire(pp->pp_lock);
+	if (v == &pp->pp_readend) {
+		pp->pp_rnonblock = on != 0;
+	}
+	else {
+		pp->pp_wnonblock = on != 0;
+	}
+	lock_release(pp->pp_lock);
+	return 0;
+}
+
+/*
+ * stat: the size is how much is waiting to be read.
+ */
+static
+int
+pipe_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct pipe *pp = v->vn_data;
+
+	bzero(statbuf, sizeof(struct stat));
+	statbuf->st_mode = S_IFIFO | 0600;
+	statbuf->st_nlink = 1;
+	statbuf->st_blksize = PIPE_SIZE;
+
+	lock_acquire(pp->pp_lock);
+	statbuf->st_size = pp->pp_count;
+	lock_release(pp->pp_lock);
+
+	return 0;
+}
+
+/*
+ * poll: the read end is readable when there's data, and hung up
+ * once the write end is gone (with or without data left). The write
+ * end is writable when a PIPE_BUF write would go straight in, and
+ * gets an error once the read end is gone.
+ */
+static
+int
+pipe_poll(struct vnode *v, int events, struct pollwaiter *pw)
+{
+	struct pipe *pp = v->vn_data;
+	int revents = 0;
+
+	lock_acquire(pp->pp_lock);
+	if (v == &pp->pp_readend) {
+		pollqueue_add(&pp->pp_readpoll, pw);
+		if (pp->pp_count > 0) {
+			revents |= events & POLLIN;
+		}
+		if (!pp->pp_writeopen) {
+			revents |= POLLHUP;
+		}
+	}
+	else {
+		pollqueue_add(&pp->pp_writepoll, pw);
+		if (!pp->pp_readopen) {
+			revents |= POLLERR;
+		}
+		else if (PIPE_SIZE - pp->pp_count >= PIPE_BUF) {
+			revents |= events & POLLOUT;
+		}
+	}
+	lock_release(pp->pp_lock);
+	return revents;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, mode_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+bool
+pipe_isseekable(struct vnode *v)
+{
+	(void)v;
+	return false;
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return EINVAL;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+/*
+ * Can't be reached: there's no way to chdir to a pipe.
+ */
+static
+int
+pipe_namefile(struct vnode *v, struct uio *uio)
+{
+	(void)v;
+	(void)uio;
+	return EINVAL;
+}
+
+/*
+ * Function tables for the two ends. Each fails the other's transfer
+ * operation, though the file table doesn't let that get this far.
+ */
+static const struct vnode_ops pipe_readops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+	.vop_read = pipe_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = vopfail_uio_inval,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_poll = pipe_poll,
+	.vop_mmap = vopfail_mmap_nosys,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = pipe_namefile,
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+static const struct vnode_ops pipe_writeops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+	.vop_read = vopfail_uio_inval,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = pipe_write,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_poll = pipe_poll,
+	.vop_mmap = vopfail_mmap_nosys,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = pipe_namefile,
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+////////////////////////////////////////////////////////////
+// interface
+
+/*
+ * Make a pipe. Each end comes back with one reference.
+ */
+int
+pipe_create(struct vnode **readend, struct vnode **writeend)
+{
+	struct pipe *pp;
+	int result;
+
+	pp = kmalloc(sizeof(*pp));
+	if (pp == NULL) {
+		return ENOMEM;
+	}
+	pollqueue_init(&pp->pp_readpoll);
+	pollqueue_init(&pp->pp_writepoll);
+	pp->pp_buf = (char *)alloc_kpages(1);
+	pp->pp_lock = lock_create("pipe");
+	pp->pp_readcv = cv_create("piperead");
+	pp->pp_writecv = cv_create("pipewrite");
+	if (pp->pp_buf == NULL || pp->pp_lock == NULL ||
+	    pp->pp_readcv == NULL || pp->pp_writecv == NULL) {
+		pipe_destroy(pp);
+		return ENOMEM;
+	}
+	pp->pp_head = 0;
+	pp->pp_count = 0;
+	pp->pp_readwaiters = 0;
+	pp->pp_writewaiters = 0;
+	pp->pp_writeneed = PIPE_SIZE;
+	pp->pp_readopen = true;
+	pp->pp_writeopen = true;
+	pp->pp_rnonblock = false;
+	pp->pp_wnonblock = false;
+
+	result = vnode_init(&pp->pp_readend, &pipe_readops, NULL, pp);
+	if (result) {
+		pipe_destroy(pp);
+		return result;
+	}
+	result = vnode_init(&pp->pp_writeend, &pipe_writeops, NULL, pp);
+	if (result) {
+		vnode_cleanup(&pp->pp_readend);
+		pipe_destroy(pp);
+		return result;
+	}
+
+	*readend = &pp->pp_readend;
+	*writeend = &pp->pp_writeend;
+	return 0;
+}
+
+bool
+pipe_isreadend(struct vnode *v)
+{
+	return v->vn_ops == &pipe_readops;
+}
+
+bool
+pipe_iswriteend(struct vnode *v)
+{
+	return v->vn_ops == &pipe_writeops;
+}
+
+/*
+ * Splice from a file into a pipe: wait for room as a write of LEN
+ * bytes would, then have SRC read straight into the free part of the
+ * ring. Moves at most one ringful per call.
+ */
+int
+pipe_fill(struct vnode *pipevn, struct vnode *src, off_t *pos,
+	  size_t len, size_t *moved)
+{
+	struct pipe *pp = pipevn->vn_data;
+	struct iovec iov[2];
+	struct uio ku;
+	unsigned tail;
+	int result;
+
+	KASSERT(pipe_iswriteend(pipevn));
+
+	*moved = 0;
+	if (len == 0) {
+		return 0;
+	}
+
+	lock_acquire(pp->pp_lock);
+	result = pipe_waitroom(pp, pipe_writeneed(pp, len));
+	if (result == 0) {
+		if (len > PIPE_SIZE - pp->pp_count) {
+			len = PIPE_SIZE - pp->pp_count;
+		}
+		tail = (pp->pp_head + pp->pp_count) % PIPE_SIZE;
+		pipe_ringuio(pp, tail, len, *pos, UIO_READ, iov, &ku);
+		result = VOP_READ(src, &ku);
+		*moved = len - ku.uio_resid;
+		*pos = ku.uio_offset;
+		pp->pp_count += *moved;
+		pipe_wakereaders(pp);
+	}
+	lock_release(pp->pp_lock);
+	return result;
+}
+
+/*
+ * Splice from a pipe into a file: wait for data as a read would, then
+ * have DST write straight out of the ring. At end of file, moves
+ * nothing.
+ */
+int
+pipe_drain(struct vnode *pipevn, struct vnode *dst, off_t *pos,
+	   size_t len, size_t *moved)
+{
+	struct pipe *pp = pipevn->vn_data;
+	struct iovec iov[2];
+	struct uio ku;
+	int result;
+
+	KASSERT(pipe_isreadend(pipevn));
+
+	*moved = 0;
+	if (len == 0) {
+		return 0;
+	}
+
+	lock_acquire(pp->pp_lock);
+	result = pipe_waitdata(pp);
+	if (result == 0 && pp->pp_count > 0) {
+		if (len > pp->pp_count) {
+			len = pp->pp_count;
+		}
+		pipe_ringuio(pp, pp->pp_head, len, *pos, UIO_WRITE, iov, &ku);
+		result = VOP_WRITE(dst, &ku);
+		*moved = len - ku.uio_resid;
+		*pos = ku.uio_offset;
+		pp->pp_head = (pp->pp_head + *moved) % PIPE_SIZE;
+		pp->pp_count -= *moved;
+		pipe_wakewriters(pp);
+	}
+	lock_release(pp->pp_lock);
+	if (*moved > 0) {
+		vm_filechanged(dst);
+	}
+	return result;
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Poll wait queues.
+ *
+ * A pollwaiter belongs to one poll() call. It has an entry for each
+ * queue it's on, allocated up front, and sleeps on a wchan of its
+ * own, so a wakeup goes straight to the threads that care. The lock
+ * order is queue, then waiter; the clock timer's lock comes before
+ * both.
+ */
+
+#include <types.h>
+#include <kern/poll.h>
+#include <lib.h>
+#include <clock.h>
+#include <wchan.h>
+#include <vnode.h>
+#include <poll.h>
+
+struct pollentry {
+	struct pollqueue *pe_queue;	/* queue this entry is on */
+	struct pollwaiter *pe_waiter;	/* waiter it belongs to */
+	struct pollentry *pe_next;	/* next on pe_queue */
+};
+
+struct pollwaiter {
+	struct spinlock pw_lock;	/* protects the flags */
+	struct wchan *pw_wchan;		/* sleep here */
+	bool pw_ready;			/* woken since the last reset */
+	bool pw_timedout;		/* the timeout has passed */
+	bool pw_timed;			/* there is a timeout */
+	struct clocktimer pw_timer;
+	unsigned pw_numentries;		/* entries in use */
+	unsigned pw_maxentries;		/* entries allocated */
+	struct pollentry *pw_entries;
+};
+
+////////////////////////////////////////////////////////////
+// queues
+
+void
+pollqueue_init(struct pollqueue *pq)
+{
+	spinlock_init(&pq->pq_lock);
+	pq->pq_entries = NULL;
+}
+
+void
+pollqueue_cleanup(struct pollqueue *pq)
+{
+	KASSERT(pq->pq_entries == NULL);
+	spinlock_cleanup(&pq->pq_lock);
+}
+
+void
+pollqueue_add(struct pollqueue *pq, struct pollwaiter *pw)
+{
+	struct pollentry *pe;
+
+	if (pw == NULL) {
+		return;
+	}
+	KASSERT(pw->pw_numentries < pw->pw_maxentries);
+	pe = &pw->pw_entries[pw->pw_numentries++];
+	pe->pe_queue = pq;
+	pe->pe_waiter = pw;
+
+	spinlock_acquire(&pq->pq_lock);
+	pe->pe_next = pq->pq_entries;
+	pq->pq_entries = pe;
+	spinlock_release(&pq->pq_lock);
+}
+
+void
+pollqueue_wakeup(struct pollqueue *pq)
+{
+	struct pollentry *pe;
+	struct pollwaiter *pw;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pe = pq->pq_entries; pe != NULL; pe = pe->pe_next) {
+		pw = pe->pe_waiter;
+		spinlock_acquire(&pw->pw_lock);
+		pw->pw_ready = true;
+		wchan_wakeall(pw->pw_wchan, &pw->pw_lock);
+		spinlock_release(&pw->pw_lock);
+	}
+	spinlock_release(&pq->pq_lock);
+}
+
+/*
+ * Take PE off its queue.
+ */
+static
+void
+pollqueue_remove(struct pollentry *pe)
+{
+	struct pollqueue *pq = pe->pe_queue;
+	struct pollentry **pep;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pep = &pq->pq_entries; *pep != pe; pep = &(*pep)->pe_next) {
+		KASSERT(*pep != NULL);
+	}
+	*pep = pe->pe_next;
+	spinlock_release(&pq->pq_lock);
+}
+
+////////////////////////////////////////////////////////////
+// waiters
+
+/*
+ * Clock timer function: the timeout has passed.
+ */
+static
+void
+pollwaiter_timeout(void *data)
+{
+	struct pollwaiter *pw = data;
+
+	spinlock_acquire(&pw->pw_lock);
+	pw->pw_timedout = true;
+	wchan_wakeall(pw->pw_wchan, &pw->pw_lock);
+	spinlock_release(&pw->pw_lock);
+}
+
+struct pollwaiter *
+pollwaiter_create(unsigned maxqueues, int msecs)
+{
+	struct pollwaiter *pw;
+	struct timespec delay;
+
+	pw = kmalloc(sizeof(*pw));
+	if (pw == NULL) {
+		return NULL;
+	}
+	pw->pw_entries = NULL;
+	if (maxqueues > 0) {
+		pw->pw_entries = kmalloc(maxqueues * sizeof(pw->pw_entries[0]));
+		if (pw->pw_entries == NULL) {
+			kfree(pw);
+			return NULL;
+		}
+	}
+	pw->pw_wchan = wchan_create("poll");
+	if (pw->pw_wchan == NULL) {
+		kfree(pw->pw_entries);
+		kfree(pw);
+		return NULL;
+	}
+	spinlock_init(&pw->pw_lock);
+	pw->pw_ready = false;
+	pw->pw_timedout = false;
+	pw->pw_numentries = 0;
+	pw->pw_maxentries = maxqueues;
+
+	pw->pw_timed = msecs > 0;
+	if (pw->pw_timed) {
+		delay.tv_sec = msecs / 1000;
+		delay.tv_nsec = (msecs % 1000) * 1000000;
+		clocktimer_start(&pw->pw_timer, &delay,
+				 pollwaiter_timeout, pw);
+	}
+	return pw;
+}
+
+void
+pollwaiter_destroy(struct pollwaiter *pw)
+{
+	unsigned i;
+
+	if (pw->pw_timed) {
+		clocktimer_stop(&pw->pw_timer);
+	}
+	for (i=0; i<pw->pw_numentries; i++) {
+		pollqueue_remove(&pw->pw_entries[i]);
+	}
+	wchan_destroy(pw->pw_wchan);
+	spinlock_cleanup(&pw->pw_lock);
+	kfree(pw->pw_entries);
+	kfree(pw);
+}
+
+void
+pollwaiter_reset(struct pollwaiter *pw)
+{
+	spinlock_acquire(&pw->pw_lock);
+	pw->pw_ready = false;
+	spinlock_release(&pw->pw_lock);
+}
+
+int
+pollwaiter_sleep(struct pollwaiter *pw, bool *timedout)
+{
+	int result;
+
+	result = 0;
+	spinlock_acquire(&pw->pw_lock);
+	while (!pw->pw_ready && !pw->pw_timedout && result == 0) {
+		result = wchan_sleep_intr(pw->pw_wchan, &pw->pw_lock);
+	}
+	*timedout = pw->pw_timedout;
+	spinlock_release(&pw->pw_lock);
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// generic vop_poll
+
+/*
+ * Files, directories, and devices that don't wait for anything are
+ * always ready for whatever was asked.
+ */
+int
+vopready_poll(struct vnode *v, int events, struct pollwaiter *pw)
+{
+	(void)v;
+	(void)pw;
+	return events & (POLLIN | POLLOUT);
+}
@@ -37,6 +37,7 @@
 #include <limits.h>
 #include <lib.h>
 #include <vfs.h>
+#include <vm.h>
 #include <vnode.h>
 
 
@@ -99,6 +100,7 @@ vfs_open(char *path, int openflags, mode_t mode, struct vnode **ret)
 		}
 		else {
 			result = VOP_TRUNCATE(vn, 0);
+			vm_filechanged(vn);
 		}
 		if (result) {
 			VOP_DECREF(vn);
@@ -29,15 +29,42 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
 #include <lib.h>
+#include <cpu.h>
+#include <synch.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <vmprivate.h>
 #include <proc.h>
+#include <current.h>
+#include <vnode.h>
 
 /*
  * Note! If OPT_DUMBVM is set, as is the case until you start the VM
  * assignment, this file is not compiled or linked or in any way
  * used. The cheesy hack versions in dumbvm.c are used instead.
+ *
+ * An address space is a sorted list of regions plus a page table.
+ * Regions only describe what may be mapped where; pages are filled
+ * in by vm_fault as they are touched, so memory use is proportional
+ * to the pages a program actually uses rather than to its size.
+ *
+ * as_copy does not copy any pages that are in memory. Both address
+ * spaces end up mapping the same frames read-only, and vm_fault makes
+ * the copies on the first write to each page (copy-on-write). Pages
+ * out on swap are read in for the new address space.
+ *
+ * A region can be backed in part by a file (as_map_file); this is
+ * how program text and data get loaded. The region holds a reference
+ * to the vnode, and vm_fault reads the file's pages in on demand.
+ * mmap makes regions like that too (RG_MMAP); with MAP_SHARED
+ * (RG_SHARED) the pages written are written back to the file by
+ * as_msync, as_munmap, and as_destroy, and as_copy shares them with
+ * the new address space instead of copying them on write.
+ *
+ * Page table entries are protected by vm_ptlock; see vmprivate.h.
  */
 
 struct addrspace *
@@ -50,40 +77,319 @@ as_create(void)
 		return NULL;
 	}
 
-	/*
-	 * Initialize as needed.
-	 */
+	as->as_lock = lock_create("addrspace");
+	if (as->as_lock == NULL) {
+		kfree(as);
+		return NULL;
+	}
+	as->as_pt = pt_create();
+	if (as->as_pt == NULL) {
+		lock_destroy(as->as_lock);
+		kfree(as);
+		return NULL;
+	}
+	as->as_regions = NULL;
+	as->as_loading = false;
+	as->as_heap = NULL;
+	as->as_heapbrk = 0;
+	as->as_faultnext = 0;
+	as->as_faultwin = 1;
+	as->as_minflt = 0;
+	as->as_majflt = 0;
+	as->as_ncowbreaks = 0;
+	as->as_nswapins = 0;
+	as->as_nprefaults = 0;
+	as->as_rss = 0;
+	as->as_maxrss = 0;
+	as->as_pageouts = 0;
+	as->as_asid = 0;
+	as->as_tlbcpus = 0;
 
 	return as;
 }
 
+/*
+ * Add a region to the list, keeping it sorted. Fails if the new
+ * region overlaps an existing one. Hands back the new region in
+ * RET, if not NULL.
+ */
+static
+int
+as_addregion(struct addrspace *as, vaddr_t base, size_t npages, int flags,
+	     struct region **ret)
+{
+	struct region *rg, **prevp;
+
+	for (prevp = &as->as_regions; *prevp != NULL;
+	     prevp = &(*prevp)->rg_next) {
+		if ((*prevp)->rg_base >= base + npages * PAGE_SIZE) {
+			break;
+		}
+		if (RG_TOP(*prevp) > base) {
+			return EINVAL;
+		}
+	}
+
+	rg = kmalloc(sizeof(*rg));
+	if (rg == NULL) {
+		return ENOMEM;
+	}
+	rg->rg_base = base;
+	rg->rg_npages = npages;
+	rg->rg_flags = flags;
+	rg->rg_vnode = NULL;
+	rg->rg_fileva = 0;
+	rg->rg_filesize = 0;
+	rg->rg_fileoff = 0;
+	rg->rg_next = *prevp;
+	*prevp = rg;
+	if (ret != NULL) {
+		*ret = rg;
+	}
+	return 0;
+}
+
+/*
+ * Give region TO the same file backing as FROM.
+ */
+static
+void
+as_copybacking(struct region *to, const struct region *from)
+{
+	if (from->rg_vnode != NULL) {
+		VOP_INCREF(from->rg_vnode);
+	}
+	to->rg_vnode = from->rg_vnode;
+	to->rg_fileva = from->rg_fileva;
+	to->rg_filesize = from->rg_filesize;
+	to->rg_fileoff = from->rg_fileoff;
+}
+
+static
+void
+as_freeregion(struct region *rg)
+{
+	if (rg->rg_vnode != NULL) {
+		VOP_DECREF(rg->rg_vnode);
+	}
+	kfree(rg);
+}
+
+struct region *
+as_findregion(struct addrspace *as, vaddr_t vaddr)
+{
+	struct region *rg;
+
+	KASSERT(lock_do_i_hold(as->as_lock));
+
+	for (rg = as->as_regions; rg != NULL; rg = rg->rg_next) {
+		if (vaddr < rg->rg_base) {
+			break;
+		}
+		if (vaddr < RG_TOP(rg)) {
+			return rg;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Give NEWAS a private copy of the swapped-out page at VADDR in OLD,
+ * by reading it into a new frame. Called and returns with vm_ptlock
+ * held, but drops it to do the I/O; the slot can't go away meanwhile
+ * because only faults in OLD, which we lock out, release it.
+ */
+static
+int
+as_copyswapped(struct addrspace *newas, vaddr_t vaddr, unsigned slot,
+	       pte_t *newpte, bool writeable)
+{
+	pte_t pte;
+	int result;
+
+	spinlock_release(&vm_ptlock);
+	result = vm_newpage(&pte);
+	if (result == 0) {
+		result = swap_in(slot, pte & PTE_FRAME);
+		if (result) {
+			spinlock_acquire(&vm_ptlock);
+			vm_freepage(NULL, pte);
+			return result;
+		}
+	}
+	spinlock_acquire(&vm_ptlock);
+	if (result) {
+		return result;
+	}
+	if (writeable) {
+		pte |= PTE_DIRTY;
+	}
+	*newpte = pte;
+	vm_rssadjust(newas, 1);
+	frame_setowner(pte & PTE_FRAME, newas, vaddr);
+	return 0;
+}
+
+/*
+ * After as_copy has write-protected pages of OLD (the current address
+ * space) to share them, drop the writeable TLB entries for them. They
+ * may be on any CPU OLD has run on, with other threads or before we
+ * moved, so it has to be done there too, and finished before the
+ * child can see the pages.
+ */
+static
+void
+as_dropstale(struct addrspace *old)
+{
+	vm_tlbflushas(old);
+	ipi_tlbshootdown_wait();
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *newas;
+	struct region *rg, *newrg;
+	pte_t *oldpte, *newpte;
+	vaddr_t va;
+	size_t i;
+	int result;
+	bool shared = false;
 
 	newas = as_create();
 	if (newas==NULL) {
 		return ENOMEM;
 	}
 
-	/*
-	 * Write this.
-	 */
+	lock_acquire(old->as_lock);
+	for (rg = old->as_regions; rg != NULL; rg = rg->rg_next) {
+		result = as_addregion(newas, rg->rg_base, rg->rg_npages,
+				      rg->rg_flags, &newrg);
+		if (result) {
+			goto fail;
+		}
+		as_copybacking(newrg, rg);
+		if (rg == old->as_heap) {
+			newas->as_heap = newrg;
+			newas->as_heapbrk = old->as_heapbrk;
+		}
+		spinlock_acquire(&vm_ptlock);
+		for (i=0; i<rg->rg_npages; i++) {
+			va = rg->rg_base + i * PAGE_SIZE;
+			oldpte = pt_lookup(old->as_pt, va, false);
+			if (oldpte == NULL) {
+				/* Never touched; stays untouched. */
+				continue;
+			}
+			while (*oldpte & PTE_BUSY) {
+				vm_pagewait();
+			}
+			if (*oldpte == 0) {
+				continue;
+			}
+			newpte = pt_lookup(newas->as_pt, va, true);
+			if (newpte == NULL) {
+				spinlock_release(&vm_ptlock);
+				result = ENOMEM;
+				goto fail;
+			}
+			if ((*oldpte & PTE_SWAPPED) &&
+			    (rg->rg_flags & RG_SHARED)) {
+				/* Bring it in to share it; see below. */
+				result = vm_swapin(old, va, oldpte);
+				if (result) {
+					spinlock_release(&vm_ptlock);
+					goto fail;
+				}
+			}
+			if (*oldpte & PTE_SWAPPED) {
+				result = as_copyswapped(newas, va,
+					PTE_SLOT(*oldpte), newpte,
+					(rg->rg_flags & RG_WRITE) != 0);
+				if (result) {
+					spinlock_release(&vm_ptlock);
+					goto fail;
+				}
+				continue;
+			}
+			/*
+			 * Share the frame. The first write copies it,
+			 * unless the mapping is MAP_SHARED, where both
+			 * go on writing the same frame.
+			 */
+			if ((rg->rg_flags & RG_SHARED) == 0) {
+				*oldpte &= ~(pte_t)PTE_DIRTY;
+				shared = true;
+			}
+			frame_incref(*oldpte & PTE_FRAME);
+			frame_setowner(*oldpte & PTE_FRAME, newas, va);
+			*newpte = *oldpte;
+			vm_rssadjust(newas, 1);
+		}
+		spinlock_release(&vm_ptlock);
+	}
+	lock_release(old->as_lock);
 
-	(void)old;
+	if (shared) {
+		/* Get rid of the old space's now stale writeable entries. */
+		as_dropstale(old);
+	}
 
 	*ret = newas;
 	return 0;
+
+ fail:
+	lock_release(old->as_lock);
+	if (shared) {
+		as_dropstale(old);
+	}
+	as_destroy(newas);
+	return result;
+}
+
+/*
+ * pt_destroy callback for as_destroy.
+ */
+static
+void
+as_freepte(void *as, pte_t pte)
+{
+	vm_freepage(as, pte);
 }
 
 void
 as_destroy(struct addrspace *as)
 {
-	/*
-	 * Clean up as needed.
-	 */
+	struct region *rg;
+	size_t i;
+
+	/* Write back shared mappings; there's no one to report errors to. */
+	lock_acquire(as->as_lock);
+	for (rg = as->as_regions; rg != NULL; rg = rg->rg_next) {
+		if (rg->rg_flags & RG_SHARED) {
+			for (i=0; i<rg->rg_npages; i++) {
+				(void)vm_syncpage(as, rg,
+						  rg->rg_base + i * PAGE_SIZE);
+			}
+		}
+	}
+	lock_release(as->as_lock);
+
+	spinlock_acquire(&vm_ptlock);
+	while (as->as_pageouts > 0) {
+		/* Let the pageout finish with our page. */
+		vm_pagewait();
+	}
+	pt_destroy(as->as_pt, as_freepte, as);
+	spinlock_release(&vm_ptlock);
+	textcache_reap();
 
+	while (as->as_regions != NULL) {
+		rg = as->as_regions;
+		as->as_regions = rg->rg_next;
+		as_freeregion(rg);
+	}
+	lock_destroy(as->as_lock);
 	kfree(as);
 }
 
@@ -96,24 +402,30 @@ as_activate(void)
 	if (as == NULL) {
 		/*
 		 * Kernel thread without an address space; leave the
-		 * prior address space in place.
+		 * prior address space's TLB entries in place, but
+		 * don't let the refill handler load any more.
 		 */
+		vm_tlbactivate(NULL);
 		return;
 	}
 
 	/*
-	 * Write this.
+	 * No flush: the TLB tags entries with an address space ID, so
+	 * entries for other address spaces can stay.
 	 */
+	vm_tlbactivate(as);
 }
 
 void
 as_deactivate(void)
 {
 	/*
-	 * Write this. For many designs it won't need to actually do
-	 * anything. See proc.c for an explanation of why it (might)
-	 * be needed.
+	 * Just stop the refill handler from walking the page table,
+	 * which may be about to go away. Kernel-only threads never
+	 * touch user addresses, and the address space's entries are
+	 * tagged with its address space ID.
 	 */
+	vm_tlbactivate(NULL);
 }
 
 /*
@@ -122,57 +434,438 @@ as_deactivate(void)
  * VADDR+MEMSIZE.
  *
  * The READABLE, WRITEABLE, and EXECUTABLE flags are set if read,
- * write, or execute permission should be set on the segment. At the
- * moment, these are ignored. When you write the VM system, you may
- * want to implement them.
+ * write, or execute permission should be set on the segment. Writes
+ * to a segment without WRITEABLE fault (once loading is complete);
+ * the MIPS TLB cannot enforce the other two.
  */
 int
 as_define_region(struct addrspace *as, vaddr_t vaddr, size_t memsize,
 		 int readable, int writeable, int executable)
 {
-	/*
-	 * Write this.
-	 */
+	size_t npages;
+	int flags, result;
 
-	(void)as;
-	(void)vaddr;
-	(void)memsize;
-	(void)readable;
-	(void)writeable;
-	(void)executable;
-	return ENOSYS;
+	/* Align the region. First, the base... */
+	memsize += vaddr & ~(vaddr_t)PAGE_FRAME;
+	vaddr &= PAGE_FRAME;
+
+	/* ...and now the length. */
+	memsize = (memsize + PAGE_SIZE - 1) & PAGE_FRAME;
+
+	if (vaddr + memsize > USERSPACETOP || vaddr + memsize < vaddr) {
+		return EFAULT;
+	}
+	npages = memsize / PAGE_SIZE;
+
+	flags = 0;
+	if (readable) {
+		flags |= RG_READ;
+	}
+	if (writeable) {
+		flags |= RG_WRITE;
+	}
+	if (executable) {
+		flags |= RG_EXEC;
+	}
+
+	lock_acquire(as->as_lock);
+	result = as_addregion(as, vaddr, npages, flags, NULL);
+	lock_release(as->as_lock);
+	return result;
+}
+
+/*
+ * Back FILESIZE bytes of the region containing VADDR, starting at
+ * VADDR, with the file V from offset OFFSET on. The region has to
+ * have been defined already and not be mapped from anything yet.
+ */
+int
+as_map_file(struct addrspace *as, vaddr_t vaddr, struct vnode *v,
+	    off_t offset, size_t filesize)
+{
+	struct region *rg;
+
+	lock_acquire(as->as_lock);
+	rg = as_findregion(as, vaddr);
+	if (rg == NULL || rg->rg_vnode != NULL ||
+	    filesize > RG_TOP(rg) - vaddr || offset < 0) {
+		lock_release(as->as_lock);
+		return EINVAL;
+	}
+	VOP_INCREF(v);
+	rg->rg_vnode = v;
+	rg->rg_fileva = vaddr;
+	rg->rg_filesize = filesize;
+	rg->rg_fileoff = offset;
+	lock_release(as->as_lock);
+	return 0;
+}
+
+/*
+ * Find room for NPAGES pages that aren't in any region, as high as
+ * possible (that is, just below the stack, going down), so as to
+ * stay out of the way of the heap. Returns 0 if there isn't any.
+ */
+static
+vaddr_t
+as_findspace(struct addrspace *as, size_t npages)
+{
+	struct region *rg;
+	vaddr_t bottom, found;
+	size_t len;
+
+	len = npages * PAGE_SIZE;
+	found = 0;
+	/* Leave page 0 alone, so null pointers still fault. */
+	bottom = PAGE_SIZE;
+	for (rg = as->as_regions; rg != NULL; rg = rg->rg_next) {
+		if (rg->rg_base >= bottom && rg->rg_base - bottom >= len) {
+			found = rg->rg_base - len;
+		}
+		bottom = RG_TOP(rg);
+	}
+	if (USERSPACETOP - bottom >= len) {
+		found = USERSPACETOP - len;
+	}
+	return found;
+}
+
+int
+as_mmap(struct addrspace *as, vaddr_t *vaddr, size_t len, int flags,
+	bool fixed, struct vnode *v, off_t offset, size_t filesize)
+{
+	struct region *rg;
+	vaddr_t base;
+	size_t npages;
+	int result;
+
+	KASSERT(len > 0 && filesize <= len);
+
+	npages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	lock_acquire(as->as_lock);
+	if (fixed) {
+		base = *vaddr;
+		KASSERT((base & ~(vaddr_t)PAGE_FRAME) == 0);
+		if (base + npages * PAGE_SIZE > USERSPACETOP ||
+		    base + npages * PAGE_SIZE < base) {
+			lock_release(as->as_lock);
+			return EINVAL;
+		}
+	}
+	else {
+		base = as_findspace(as, npages);
+		if (base == 0) {
+			lock_release(as->as_lock);
+			return ENOMEM;
+		}
+	}
+
+	result = as_addregion(as, base, npages, flags | RG_MMAP, &rg);
+	if (result) {
+		lock_release(as->as_lock);
+		return result;
+	}
+	if (v != NULL) {
+		VOP_INCREF(v);
+		rg->rg_vnode = v;
+		rg->rg_fileva = base;
+		rg->rg_filesize = filesize;
+		rg->rg_fileoff = offset;
+	}
+	lock_release(as->as_lock);
+
+	*vaddr = base;
+	return 0;
+}
+
+/*
+ * Check that the pages [VADDR, END) are all in regions, and if
+ * MMAPONLY is set, that those regions were all made by mmap.
+ */
+static
+bool
+as_rangeok(struct addrspace *as, vaddr_t vaddr, vaddr_t end, bool mmaponly)
+{
+	struct region *rg;
+
+	for (rg = as->as_regions; rg != NULL && vaddr < end;
+	     rg = rg->rg_next) {
+		if (RG_TOP(rg) <= vaddr) {
+			continue;
+		}
+		if (rg->rg_base > vaddr) {
+			/* Hole. */
+			return false;
+		}
+		if (mmaponly && (rg->rg_flags & RG_MMAP) == 0) {
+			return false;
+		}
+		vaddr = RG_TOP(rg);
+	}
+	return vaddr >= end;
+}
+
+/*
+ * Write back the MAP_SHARED pages in [VADDR, END). Returns the first
+ * error, but tries them all.
+ */
+static
+int
+as_syncrange(struct addrspace *as, vaddr_t vaddr, vaddr_t end)
+{
+	struct region *rg;
+	vaddr_t va, top;
+	int result, ret;
+
+	ret = 0;
+	for (rg = as->as_regions; rg != NULL && rg->rg_base < end;
+	     rg = rg->rg_next) {
+		if ((rg->rg_flags & RG_SHARED) == 0 || RG_TOP(rg) <= vaddr) {
+			continue;
+		}
+		va = rg->rg_base > vaddr ? rg->rg_base : vaddr;
+		top = RG_TOP(rg) < end ? RG_TOP(rg) : end;
+		for (; va < top; va += PAGE_SIZE) {
+			result = vm_syncpage(as, rg, va);
+			if (result && ret == 0) {
+				ret = result;
+			}
+		}
+	}
+	return ret;
+}
+
+int
+as_munmap(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	struct region *rg, **prevp, *spare;
+	vaddr_t end, va, lo, hi;
+
+	if ((vaddr & ~(vaddr_t)PAGE_FRAME) != 0 || len == 0) {
+		return EINVAL;
+	}
+	end = vaddr + ((len + PAGE_SIZE - 1) & PAGE_FRAME);
+	if (end > USERSPACETOP || end < vaddr) {
+		return EINVAL;
+	}
+
+	/* Unmapping the middle of a region splits it in two. */
+	spare = kmalloc(sizeof(*spare));
+	if (spare == NULL) {
+		return ENOMEM;
+	}
+
+	lock_acquire(as->as_lock);
+	if (!as_rangeok(as, vaddr, end, true)) {
+		lock_release(as->as_lock);
+		kfree(spare);
+		return EINVAL;
+	}
+
+	/* Nobody to report writeback errors to once the pages are gone. */
+	(void)as_syncrange(as, vaddr, end);
+	for (va = vaddr; va < end; va += PAGE_SIZE) {
+		vm_droppage(as, va);
+	}
+
+	prevp = &as->as_regions;
+	while ((rg = *prevp) != NULL && rg->rg_base < end) {
+		if (RG_TOP(rg) <= vaddr) {
+			prevp = &rg->rg_next;
+			continue;
+		}
+		lo = rg->rg_base > vaddr ? rg->rg_base : vaddr;
+		hi = RG_TOP(rg) < end ? RG_TOP(rg) : end;
+		if (lo == rg->rg_base && hi == RG_TOP(rg)) {
+			/* All of it. */
+			*prevp = rg->rg_next;
+			as_freeregion(rg);
+			continue;
+		}
+		if (lo > rg->rg_base && hi < RG_TOP(rg)) {
+			/* The middle; the part above becomes SPARE. */
+			KASSERT(spare != NULL);
+			spare->rg_base = hi;
+			spare->rg_npages = (RG_TOP(rg) - hi) / PAGE_SIZE;
+			spare->rg_flags = rg->rg_flags;
+			as_copybacking(spare, rg);
+			spare->rg_next = rg->rg_next;
+			rg->rg_next = spare;
+			spare = NULL;
+		}
+		/*
+		 * Trim the end or the start. The file backing still
+		 * describes the rest correctly as it is.
+		 */
+		if (lo > rg->rg_base) {
+			rg->rg_npages = (lo - rg->rg_base) / PAGE_SIZE;
+		}
+		else {
+			rg->rg_npages = (RG_TOP(rg) - hi) / PAGE_SIZE;
+			rg->rg_base = hi;
+		}
+		prevp = &rg->rg_next;
+	}
+	lock_release(as->as_lock);
+
+	if (spare != NULL) {
+		kfree(spare);
+	}
+	return 0;
+}
+
+int
+as_sbrk(struct addrspace *as, intptr_t amount, vaddr_t *oldbrk)
+{
+	struct region *rg;
+	vaddr_t newbrk, newtop, va;
+
+	lock_acquire(as->as_lock);
+	rg = as->as_heap;
+	if (rg == NULL) {
+		lock_release(as->as_lock);
+		return ENOMEM;
+	}
+
+	if (amount < 0 &&
+	    (vaddr_t)0 - (vaddr_t)amount > as->as_heapbrk - rg->rg_base) {
+		/* Would go below the start of the heap. */
+		lock_release(as->as_lock);
+		return EINVAL;
+	}
+	newbrk = as->as_heapbrk + amount;
+	if (amount > 0 && newbrk < as->as_heapbrk) {
+		lock_release(as->as_lock);
+		return ENOMEM;
+	}
+
+	newtop = (newbrk + PAGE_SIZE - 1) & PAGE_FRAME;
+	if (newtop > RG_TOP(rg)) {
+		/* Grow, if there's room before whatever is next. */
+		if (newtop < newbrk || newtop > USERSPACETOP ||
+		    (rg->rg_next != NULL && newtop > rg->rg_next->rg_base)) {
+			lock_release(as->as_lock);
+			return ENOMEM;
+		}
+		rg->rg_npages = (newtop - rg->rg_base) / PAGE_SIZE;
+	}
+	else if (newtop < RG_TOP(rg)) {
+		/* Shrink, throwing away the pages given back. */
+		for (va = newtop; va < RG_TOP(rg); va += PAGE_SIZE) {
+			vm_droppage(as, va);
+		}
+		rg->rg_npages = (newtop - rg->rg_base) / PAGE_SIZE;
+	}
+
+	*oldbrk = as->as_heapbrk;
+	as->as_heapbrk = newbrk;
+	lock_release(as->as_lock);
+	return 0;
+}
+
+int
+as_msync(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	vaddr_t end;
+	int result;
+
+	if ((vaddr & ~(vaddr_t)PAGE_FRAME) != 0) {
+		return EINVAL;
+	}
+	end = vaddr + ((len + PAGE_SIZE - 1) & PAGE_FRAME);
+	if (end > USERSPACETOP || end < vaddr) {
+		return ENOMEM;
+	}
+
+	lock_acquire(as->as_lock);
+	if (!as_rangeok(as, vaddr, end, false)) {
+		lock_release(as->as_lock);
+		return ENOMEM;
+	}
+	result = as_syncrange(as, vaddr, end);
+	lock_release(as->as_lock);
+	return result;
 }
 
 int
 as_prepare_load(struct addrspace *as)
 {
 	/*
-	 * Write this.
+	 * Let the loader write into read-only segments. Nothing is
+	 * allocated here; the pages fault in as they are loaded.
 	 */
-
-	(void)as;
+	as->as_loading = true;
 	return 0;
 }
 
 int
 as_complete_load(struct addrspace *as)
 {
+	struct region *rg;
+	vaddr_t heapbase;
+	pte_t *pte;
+	size_t i;
+	int result;
+
 	/*
-	 * Write this.
+	 * Take write permission back from the pages of read-only
+	 * regions that were written during loading.
 	 */
+	lock_acquire(as->as_lock);
+	as->as_loading = false;
+	spinlock_acquire(&vm_ptlock);
+	for (rg = as->as_regions; rg != NULL; rg = rg->rg_next) {
+		if (rg->rg_flags & RG_WRITE) {
+			continue;
+		}
+		for (i=0; i<rg->rg_npages; i++) {
+			pte = pt_lookup(as->as_pt,
+					rg->rg_base + i * PAGE_SIZE, false);
+			if (pte != NULL && (*pte & PTE_INCORE)) {
+				*pte &= ~(pte_t)PTE_DIRTY;
+			}
+		}
+	}
+	spinlock_release(&vm_ptlock);
 
-	(void)as;
-	return 0;
+	/*
+	 * Start the heap, empty, above the last segment. (The stack
+	 * isn't there yet.)
+	 */
+	result = 0;
+	if (as->as_heap == NULL) {
+		heapbase = PAGE_SIZE;
+		for (rg = as->as_regions; rg != NULL; rg = rg->rg_next) {
+			heapbase = RG_TOP(rg);
+		}
+		result = as_addregion(as, heapbase, 0, RG_READ | RG_WRITE,
+				      &as->as_heap);
+		as->as_heapbrk = heapbase;
+	}
+	lock_release(as->as_lock);
+
+	/*
+	 * The writeable entries may be on any CPU we loaded on, not
+	 * just this one.
+	 */
+	vm_tlbflushas(as);
+	ipi_tlbshootdown_wait();
+	return result;
 }
 
 int
 as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 {
-	/*
-	 * Write this.
-	 */
+	int result;
 
-	(void)as;
+	lock_acquire(as->as_lock);
+	result = as_addregion(as, USERSTACK - VM_STACKPAGES * PAGE_SIZE,
+			      VM_STACKPAGES, RG_READ | RG_WRITE, NULL);
+	lock_release(as->as_lock);
+	if (result) {
+		return result;
+	}
 
 	/* Initial user-level stack pointer */
 	*stackptr = USERSTACK;
@@ -180,3 +873,17 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * The counters are read without locking; they're only statistics.
+ */
+void
+as_getusage(struct addrspace *as, struct rusage *ru)
+{
+	ru->ru_rss = as->as_rss * (PAGE_SIZE / 1024);
+	ru->ru_maxrss = as->as_maxrss * (PAGE_SIZE / 1024);
+	ru->ru_minflt = as->as_minflt;
+	ru->ru_majflt = as->as_majflt;
+	ru->ru_ncow = as->as_ncowbreaks;
+	ru->ru_nswapin = as->as_nswapins;
+	ru->ru_nprefault = as->as_nprefaults;
+}
@@ -33,8 +33,13 @@
 #include <setjmp.h>
 #include <thread.h>
 #include <current.h>
+#include <proc.h>
 #include <vm.h>
 #include <copyinout.h>
+#include "opt-dumbvm.h"
+#if !OPT_DUMBVM
+#include <vmprivate.h>
+#endif
 
 /*
  * User/kernel memory copying functions.
@@ -84,6 +89,11 @@
  * To make use of this code, in addition to tm_badfaultfunc the
  * thread_machdep structure should contain a jmp_buf called
  * "tm_copyjmp".
+ *
+ * With the paged VM system, large copies take a shortcut: pages that
+ * are already mapped are pinned and copied through kseg0 instead
+ * (see copypages below), and only pages that would fault are copied
+ * through their user addresses in the ordinary way.
  */
 
 /*
@@ -142,6 +152,99 @@ copycheck(const_userptr_t userptr, size_t len, size_t *stoplen)
 	return 0;
 }
 
+/*
+ * Copy LEN bytes with memcpy under the protection of the
+ * tm_badfaultfunc/copyfail logic. Returns EFAULT if a fatal fault
+ * happens partway.
+ */
+static
+int
+copymem(void *dest, const void *src, size_t len)
+{
+	int result;
+
+	curthread->t_machdep.tm_badfaultfunc = copyfail;
+
+	result = setjmp(curthread->t_machdep.tm_copyjmp);
+	if (result) {
+		curthread->t_machdep.tm_badfaultfunc = NULL;
+		return EFAULT;
+	}
+
+	memcpy(dest, src, len);
+
+	curthread->t_machdep.tm_badfaultfunc = NULL;
+	return 0;
+}
+
+#if !OPT_DUMBVM
+
+/*
+ * Copies at least this big go through copypages.
+ */
+#define COPY_PINMIN	PAGE_SIZE
+
+/*
+ * Copy LEN bytes between user address UADDR and kernel address KADDR,
+ * in the direction given by TOUSER, a page at a time. Each page that
+ * vm_pinpage says is ready is copied through its kseg0 address, which
+ * takes no TLB misses and, more to the point, doesn't load a TLB entry
+ * per page: copying through the user mapping would push out the
+ * entries the process was using, and with 64 of them a 256K transfer
+ * replaces nearly all. Pages that aren't ready (not in core, not
+ * referenced lately, or not yet writeable) go through copymem, which
+ * faults them in.
+ */
+static
+int
+copypages(vaddr_t uaddr, void *kaddr, size_t len, bool touser)
+{
+	struct addrspace *as;
+	char *kp = kaddr;
+	vaddr_t pageva, kva;
+	paddr_t frame;
+	size_t n;
+	int result;
+
+	as = proc_getas();
+	while (len > 0) {
+		pageva = uaddr & PAGE_FRAME;
+		n = PAGE_SIZE - (uaddr - pageva);
+		if (n > len) {
+			n = len;
+		}
+
+		if (as != NULL && vm_pinpage(as, pageva, touser, &frame)) {
+			kva = PADDR_TO_KVADDR(frame) + (uaddr - pageva);
+			if (touser) {
+				memcpy((void *)kva, kp, n);
+			}
+			else {
+				memcpy(kp, (const void *)kva, n);
+			}
+			vm_unpinpage(as, pageva);
+		}
+		else {
+			if (touser) {
+				result = copymem((void *)uaddr, kp, n);
+			}
+			else {
+				result = copymem(kp, (const void *)uaddr, n);
+			}
+			if (result) {
+				return result;
+			}
+		}
+
+		uaddr += n;
+		kp += n;
+		len -= n;
+	}
+	return 0;
+}
+
+#endif /* !OPT_DUMBVM */
+
 /*
  * copyin
  *
@@ -164,18 +267,12 @@ copyin(const_userptr_t usersrc, void *dest, size_t len)
 		return EFAULT;
 	}
 
-	curthread->t_machdep.tm_badfaultfunc = copyfail;
-
-	result = setjmp(curthread->t_machdep.tm_copyjmp);
-	if (result) {
-		curthread->t_machdep.tm_badfaultfunc = NULL;
-		return EFAULT;
+#if !OPT_DUMBVM
+	if (len >= COPY_PINMIN) {
+		return copypages((vaddr_t)usersrc, dest, len, false);
 	}
-
-	memcpy(dest, (const void *)usersrc, len);
-
-	curthread->t_machdep.tm_badfaultfunc = NULL;
-	return 0;
+#endif
+	return copymem(dest, (const void *)usersrc, len);
 }
 
 /*
@@ -200,20 +297,22 @@ copyout(const void *src, userptr_t userdest, size_t len)
 		return EFAULT;
 	}
 
-	curthread->t_machdep.tm_badfaultfunc = copyfail;
-
-	result = setjmp(curthread->t_machdep.tm_copyjmp);
-	if (result) {
-		curthread->t_machdep.tm_badfaultfunc = NULL;
-		return EFAULT;
+#if !OPT_DUMBVM
+	if (len >= COPY_PINMIN) {
+		return copypages((vaddr_t)userdest, (void *)src, len, true);
 	}
-
-	memcpy((void *)userdest, src, len);
-
-	curthread->t_machdep.tm_badfaultfunc = NULL;
-	return 0;
+#endif
+	return copymem((void *)userdest, src, len);
 }
 
+/*
+ * Nonzero exactly when the 32-bit word W contains a zero byte. (The
+ * usual trick: subtracting 1 from each byte sets the high bit of
+ * the lowest byte that was 0, and ~W discards bytes whose high bit
+ * was set to begin with.)
+ */
+#define HASZERO(w)	(((w) - 0x01010101U) & ~(w) & 0x80808080U)
+
 /*
  * Common string copying function that behaves the way that's desired
  * for copyinstr and copyoutstr.
@@ -235,9 +334,33 @@ int
 copystr(char *dest, const char *src, size_t maxlen, size_t stoplen,
 	size_t *gotlen)
 {
-	size_t i;
-
-	for (i=0; i<maxlen && i<stoplen; i++) {
+	size_t i, limit;
+	uint32_t w;
+	bool samealign;
+
+	limit = maxlen < stoplen ? maxlen : stoplen;
+	samealign = ((uintptr_t)dest - (uintptr_t)src) % sizeof(w) == 0;
+
+	for (i=0; i<limit; i++) {
+		/*
+		 * When both sides are word-aligned, copy whole words
+		 * until one holds the terminator. An aligned word never
+		 * crosses a page or USERSPACETOP, so reading all of it
+		 * can't fault where reading its first byte wouldn't.
+		 */
+		if (samealign && (uintptr_t)(src + i) % sizeof(w) == 0) {
+			while (i + sizeof(w) <= limit) {
+				w = *(const uint32_t *)(src + i);
+				if (HASZERO(w)) {
+					break;
+				}
+				*(uint32_t *)(dest + i) = w;
+				i += sizeof(w);
+			}
+			if (i >= limit) {
+				break;
+			}
+		}
 		dest[i] = src[i];
 		if (src[i] == 0) {
 			if (gotlen != NULL) {
@@ -131,6 +131,14 @@ static const size_t sizes[NSIZES] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
 #define SMALLEST_SUBPAGE_SIZE 16
 #define LARGEST_SUBPAGE_SIZE 2048
 
+/*
+ * Allocations of at least this many pages are mapped through the kva
+ * arena, so they do not need physically contiguous frames. Smaller
+ * ones (notably single pages, which thread stacks and page tables
+ * rely on being in kseg0) come straight from alloc_kpages.
+ */
+#define KVA_MINPAGES 4
+
 #elif PAGE_SIZE == 8192
 #error "No support for 8k pages (yet?)"
 #else
@@ -812,6 +820,8 @@ kheap_printstats(void)
 	}
 
 	spinlock_release(&kmalloc_spinlock);
+
+	kva_printstats();
 }
 
 ////////////////////////////////////////
@@ -1189,7 +1199,14 @@ kmalloc(size_t sz)
 
 		/* Round up to a whole number of pages. */
 		npages = (sz + PAGE_SIZE - 1)/PAGE_SIZE;
-		address = alloc_kpages(npages);
+		address = 0;
+		if (npages >= KVA_MINPAGES) {
+			address = kva_alloc(npages);
+		}
+		if (address==0) {
+			/* Small, or the arena is full: use contiguous frames. */
+			address = alloc_kpages(npages);
+		}
 		if (address==0) {
 			return NULL;
 		}
@@ -1216,6 +1233,8 @@ kfree(void *ptr)
 	 */
 	if (ptr == NULL) {
 		return;
+	} else if (KVA_OWNS((vaddr_t)ptr)) {
+		kva_free((vaddr_t)ptr);
 	} else if (subpage_kfree(ptr)) {
 		KASSERT((vaddr_t)ptr%PAGE_SIZE==0);
 		free_kpages((vaddr_t)ptr);
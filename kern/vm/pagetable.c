@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <vm.h>
+#include <pagetable.h>
+
+/*
+ * Two-level page tables. See pagetable.h.
+ *
+ * Both levels are exactly one page, so they are allocated with
+ * alloc_kpages(1) rather than kmalloc: that guarantees they come
+ * from kseg0 and never from the kva arena.
+ */
+
+#if PT_NENTRIES * 4 != PAGE_SIZE
+#error "Page table levels must be exactly one page"
+#endif
+
+struct pagetable *
+pt_create(void)
+{
+	struct pagetable *pt;
+	vaddr_t page;
+
+	page = alloc_kpages(1);
+	if (page == 0) {
+		return NULL;
+	}
+	pt = (struct pagetable *)page;
+	bzero(pt, sizeof(*pt));
+	return pt;
+}
+
+void
+pt_destroy(struct pagetable *pt, void (*release)(void *, pte_t), void *data)
+{
+	unsigned i, j;
+	pte_t *l2;
+
+	for (i=0; i<PT_NENTRIES; i++) {
+		l2 = pt->pt_dir[i];
+		if (l2 == NULL) {
+			continue;
+		}
+		if (release != NULL) {
+			for (j=0; j<PT_NENTRIES; j++) {
+				if (l2[j] != 0) {
+					release(data, l2[j]);
+				}
+			}
+		}
+		free_kpages((vaddr_t)l2);
+	}
+	free_kpages((vaddr_t)pt);
+}
+
+pte_t *
+pt_lookup(struct pagetable *pt, vaddr_t vaddr, bool create)
+{
+	pte_t *l2;
+	vaddr_t page;
+
+	KASSERT(vaddr < USERSPACETOP);
+
+	l2 = pt->pt_dir[PT_L1_INDEX(vaddr)];
+	if (l2 == NULL) {
+		if (!create) {
+			return NULL;
+		}
+		page = alloc_kpages(1);
+		if (page == 0) {
+			return NULL;
+		}
+		l2 = (pte_t *)page;
+		bzero(l2, PAGE_SIZE);
+		pt->pt_dir[PT_L1_INDEX(vaddr)] = l2;
+	}
+	return &l2[PT_L2_INDEX(vaddr)];
+}
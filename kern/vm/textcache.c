@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <vnode.h>
+#include <vm.h>
+#include <vmprivate.h>
+
+/*
+ * Text page cache.
+ *
+ * Pages of read-only file-backed regions (program text and read-only
+ * data) are the same in every process that maps the same part of the
+ * same file, so they are kept here, by vnode and file offset, and
+ * shared: the second process to run a program maps the frames the
+ * first one read in, and only its data and stack cost it memory.
+ *
+ * A page's identity is the vnode, the file offset corresponding to
+ * the start of the page, and the range of the page [lo, hi) that
+ * comes from the file; the rest is zero. (The last page of the text
+ * and the first of the data segment can hold the same file bytes
+ * with different amounts of zeros around them.)
+ *
+ * The cache doesn't hold a reference to its frames. Each mapping
+ * holds one, as with any shared frame, and mappings of cached frames
+ * carry PTE_CACHED so that the last one to go calls textcache_release,
+ * which removes the entry when the frame is freed. An entry does hold
+ * a reference to its vnode, so the vnode can't be recycled under it.
+ * That reference can't be dropped where the entry is removed, since
+ * vm_ptlock is usually held then and dropping it may reclaim the
+ * vnode, so the entry goes on a list for textcache_reap to finish
+ * off later.
+ *
+ * When a file is written or truncated, textcache_invalidate takes its
+ * entries out of the lookup table, so programs started afterwards
+ * read the new contents. Processes already mapping the old pages
+ * keep them. vn_textpages in the vnode counts its entries, so files
+ * that aren't cached cost nothing more than a look at it.
+ *
+ * Entries are found by key for lookups and by frame for releases, so
+ * each is on two hash chains (invalidated ones only on the second,
+ * with tp_vnode NULL). tc_lock protects both tables, the dead list,
+ * and vn_textpages, and orders after vm_ptlock.
+ */
+
+#define TC_NBUCKETS	64
+
+struct tcpage {
+	struct vnode *tp_vnode;		/* file */
+	off_t tp_offset;		/* file offset of the page's start */
+	unsigned tp_lo, tp_hi;		/* part of the page from the file */
+	paddr_t tp_frame;		/* the page */
+	struct tcpage *tp_keynext;	/* next on tc_bykey chain */
+	struct tcpage *tp_framenext;	/* next on tc_byframe chain */
+};
+
+static struct spinlock tc_lock = SPINLOCK_INITIALIZER;
+static struct tcpage *tc_bykey[TC_NBUCKETS];
+static struct tcpage *tc_byframe[TC_NBUCKETS];
+static struct tcpage *tc_dead;		/* removed; see textcache_reap */
+static unsigned tc_npages, tc_hits, tc_misses;
+
+static
+unsigned
+tc_keyhash(struct vnode *v, off_t offset)
+{
+	return ((uintptr_t)v / sizeof(void *) +
+		(unsigned)(offset / PAGE_SIZE)) % TC_NBUCKETS;
+}
+
+static
+unsigned
+tc_framehash(paddr_t frame)
+{
+	return (frame / PAGE_SIZE) % TC_NBUCKETS;
+}
+
+/*
+ * Find an entry by key. Call with tc_lock held.
+ */
+static
+struct tcpage *
+tc_find(struct vnode *v, off_t offset, unsigned lo, unsigned hi)
+{
+	struct tcpage *tp;
+
+	for (tp = tc_bykey[tc_keyhash(v, offset)]; tp != NULL;
+	     tp = tp->tp_keynext) {
+		if (tp->tp_vnode == v && tp->tp_offset == offset &&
+		    tp->tp_lo == lo && tp->tp_hi == hi) {
+			return tp;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Take entry TP off its tc_bykey chain. Call with tc_lock held.
+ */
+static
+void
+tc_unkey(struct tcpage *tp)
+{
+	struct tcpage **pp;
+
+	for (pp = &tc_bykey[tc_keyhash(tp->tp_vnode, tp->tp_offset)];
+	     *pp != tp; pp = &(*pp)->tp_keynext) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = tp->tp_keynext;
+	KASSERT(tp->tp_vnode->vn_textpages > 0);
+	tp->tp_vnode->vn_textpages--;
+}
+
+/*
+ * Finish off removed entries: drop their vnode references and free
+ * them. Call without spinlocks held.
+ */
+void
+textcache_reap(void)
+{
+	struct tcpage *tp;
+
+	spinlock_acquire(&tc_lock);
+	while (tc_dead != NULL) {
+		tp = tc_dead;
+		tc_dead = tp->tp_keynext;
+		spinlock_release(&tc_lock);
+		if (tp->tp_vnode != NULL) {
+			VOP_DECREF(tp->tp_vnode);
+		}
+		kfree(tp);
+		spinlock_acquire(&tc_lock);
+	}
+	spinlock_release(&tc_lock);
+}
+
+/*
+ * Return the cached frame holding the page, with a reference added
+ * for the caller, or 0 if it isn't cached.
+ */
+paddr_t
+textcache_lookup(struct vnode *v, off_t offset, unsigned lo, unsigned hi)
+{
+	struct tcpage *tp;
+	paddr_t frame;
+
+	textcache_reap();
+
+	spinlock_acquire(&tc_lock);
+	tp = tc_find(v, offset, lo, hi);
+	if (tp == NULL) {
+		tc_misses++;
+		frame = 0;
+	}
+	else {
+		tc_hits++;
+		frame = tp->tp_frame;
+		frame_incref(frame);
+	}
+	spinlock_release(&tc_lock);
+	return frame;
+}
+
+/*
+ * Add the page the caller just read into *FRAMEP. If someone else
+ * got there first, *FRAMEP is changed to their frame (with a
+ * reference for the caller), and the caller should free its own.
+ * ENOMEM means the page couldn't be cached; the caller can still use
+ * it as a private page.
+ */
+int
+textcache_insert(struct vnode *v, off_t offset, unsigned lo, unsigned hi,
+		 paddr_t *framep)
+{
+	struct tcpage *tp, *other;
+	unsigned b;
+
+	KASSERT(lo <= hi && hi <= PAGE_SIZE);
+
+	tp = kmalloc(sizeof(*tp));
+	if (tp == NULL) {
+		return ENOMEM;
+	}
+	tp->tp_vnode = v;
+	tp->tp_offset = offset;
+	tp->tp_lo = lo;
+	tp->tp_hi = hi;
+	tp->tp_frame = *framep;
+	VOP_INCREF(v);
+
+	spinlock_acquire(&tc_lock);
+	other = tc_find(v, offset, lo, hi);
+	if (other != NULL) {
+		frame_incref(other->tp_frame);
+		*framep = other->tp_frame;
+		spinlock_release(&tc_lock);
+		/* The caller's region holds a reference too. */
+		VOP_DECREF(v);
+		kfree(tp);
+		return 0;
+	}
+	b = tc_keyhash(v, offset);
+	tp->tp_keynext = tc_bykey[b];
+	tc_bykey[b] = tp;
+	b = tc_framehash(tp->tp_frame);
+	tp->tp_framenext = tc_byframe[b];
+	tc_byframe[b] = tp;
+	v->vn_textpages++;
+	tc_npages++;
+	spinlock_release(&tc_lock);
+	return 0;
+}
+
+/*
+ * Drop AS's reference to the cached frame FRAME, removing it from the
+ * cache if it was the last. The entry is left for textcache_reap.
+ */
+void
+textcache_release(paddr_t frame, struct addrspace *as)
+{
+	struct tcpage *tp, **pp;
+
+	spinlock_acquire(&tc_lock);
+	if (frame_unmap(frame, as) > 0) {
+		spinlock_release(&tc_lock);
+		return;
+	}
+
+	for (pp = &tc_byframe[tc_framehash(frame)]; *pp != NULL;
+	     pp = &(*pp)->tp_framenext) {
+		if ((*pp)->tp_frame == frame) {
+			break;
+		}
+	}
+	tp = *pp;
+	KASSERT(tp != NULL);
+	*pp = tp->tp_framenext;
+
+	if (tp->tp_vnode != NULL) {
+		tc_unkey(tp);
+	}
+	tp->tp_keynext = tc_dead;
+	tc_dead = tp;
+	tc_npages--;
+	spinlock_release(&tc_lock);
+}
+
+/*
+ * File V is being written or truncated: forget the pages cached from
+ * it, so they're read again. The caller holds a reference to V.
+ */
+void
+textcache_invalidate(struct vnode *v)
+{
+	struct tcpage *tp;
+	unsigned b, n;
+
+	if (v->vn_textpages == 0) {
+		/* Nothing cached; no need to look (or lock). */
+		return;
+	}
+
+	n = 0;
+	spinlock_acquire(&tc_lock);
+	for (b = 0; b < TC_NBUCKETS && v->vn_textpages > 0; b++) {
+		for (tp = tc_bykey[b]; tp != NULL; tp = tp->tp_keynext) {
+			if (tp->tp_vnode == v) {
+				tc_unkey(tp);
+				tp->tp_vnode = NULL;
+				n++;
+			}
+		}
+	}
+	spinlock_release(&tc_lock);
+
+	/* None of these can be the last reference. */
+	while (n-- > 0) {
+		VOP_DECREF(v);
+	}
+}
+
+void
+textcache_printstats(void)
+{
+	unsigned npages, hits, misses;
+
+	spinlock_acquire(&tc_lock);
+	npages = tc_npages;
+	hits = tc_hits;
+	misses = tc_misses;
+	spinlock_release(&tc_lock);
+
+	kprintf("vm: %u text pages cached, %u hits, %u misses\n",
+		npages, hits, misses);
+}
@@ -0,0 +1,1477 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <proc.h>
+#include <current.h>
+#include <synch.h>
+#include <wchan.h>
+#include <thread.h>
+#include <uio.h>
+#include <vnode.h>
+#include <machine/tlb.h>
+#include <machine/trapframe.h>
+#include <platform/maxcpus.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <vmprivate.h>
+#include <clock.h>
+#include "opt-unsw.h"
+
+/*
+ * Paged virtual memory system.
+ *
+ * Each address space has a list of regions and a two-level page
+ * table (see addrspace.c and pagetable.c). Nothing is allocated for
+ * a page until it is first touched: vm_fault finds the region the
+ * faulting address belongs to, checks the access against the
+ * region's permissions, fills in the page table entry if there is
+ * none yet, and loads it into the TLB. A new page is zero-filled,
+ * except for whatever part of it the region maps from a file, which
+ * is read in (vm_fillpage); this is how programs get loaded.
+ *
+ * Most TLB misses never get here: the UTLB handler in
+ * exception-mips1.S walks the page table of the running address
+ * space (published in cputlbs[] by vm_tlbactivate) and loads
+ * entries with PTE_VALID set itself. vm_fault sees the rest: pages
+ * not yet touched, out on swap, or unreferenced since the clock hand
+ * passed, plus writes to pages mapped read-only.
+ *
+ * Pages of writeable regions are shared copy-on-write after as_copy:
+ * both address spaces map the same frame without PTE_DIRTY and the
+ * frame's reference count (in the frame table) goes up. The first
+ * write takes a VM_FAULT_READONLY fault, and vm_cowbreak gives the
+ * writer its own copy, unless it turns out to hold the last
+ * reference, in which case it can just have write permission back.
+ * Shared frames can't be paged out, but the frame table remembers
+ * who maps them (frame_setowner), so when all but one mapping go
+ * away, as when a child execs or exits, it becomes pageable again.
+ *
+ * When memory runs short, pages are written to swap (swap.c) and
+ * their frames reused. Victims are chosen by the clock algorithm:
+ * frame_nextvictim sweeps the frame table, and a page whose
+ * referenced bit (PTE_VALID) is set gets it cleared and a second
+ * chance. A page that is still unreferenced when the hand comes
+ * round again is evicted. A page read back in keeps its swap slot
+ * and is mapped without PTE_DIRTY until it is written; the slot is
+ * given up then, so a page that still has one is clean and can be
+ * evicted without writing it. Pages of read-only regions that came
+ * from the file (or are zero) are marked PTE_CLEAN and never go to
+ * swap at all: evicting one just empties its entry, and the next
+ * touch reads it from the file again. Only unshared pages are
+ * candidates.
+ *
+ * Those same read-only file pages are shared between all the address
+ * spaces that map them, through the text page cache (textcache.c):
+ * a fault on one looks in the cache before reading the file, so
+ * every process running a program uses the same frames for its text.
+ * Their entries carry PTE_CACHED, and their references are dropped
+ * with textcache_release, which removes the page from the cache when
+ * the last one goes.
+ *
+ * Regions made by mmap (RG_MMAP) are filled from their files the same
+ * way, but never through the text page cache, since the file can be
+ * written. Pages of MAP_SHARED mappings (RG_SHARED) start out clean
+ * and write-protected even though the region is writeable, so the
+ * first write to each is noticed; vm_syncpage writes changed ones
+ * back to the file for msync, munmap, and when the address space is
+ * destroyed. Their frames stay shared across fork, writes and all,
+ * so parent and child see each other's changes; but there's no page
+ * cache for files, so unrelated processes mapping the same file see
+ * each other's writes only once they're written back.
+ *
+ * A fault that lands just past the pages the previous one mapped
+ * looks like a sequential scan, and vm_faultaround maps the next few
+ * pages along with it, as long as that takes no I/O, so the scan
+ * doesn't trap once per page. The window doubles with each such
+ * fault and drops back to nothing on any other.
+ *
+ * New pages are zero-filled, but not usually on the spot: a zeroing
+ * thread, which yields after each frame so it mostly uses otherwise
+ * idle time, keeps a pool of frames zeroed ahead (see unsw.c). A read
+ * fault on a page that would be all zeros doesn't even take one of
+ * those; it maps the one shared zero page read-only, and only a write
+ * gets the page a frame of its own, through vm_cowbreak. So untouched
+ * BSS, heap, and stack that is only read costs a mapping and nothing
+ * else.
+ *
+ * A pageout thread keeps a reserve of free frames: it is woken when
+ * fewer than vm_freelow are free and evicts until vm_freehigh are.
+ * User pages are never allocated out of the last vm_freemin frames;
+ * a faulting process evicts pages itself instead, which leaves the
+ * remainder for the kernel, which can't wait for disk I/O.
+ *
+ * Physical frames come from the frame table in arch/mips/vm/unsw.c,
+ * via alloc_kpages, which is why this VM requires "options unsw".
+ */
+
+#if !OPT_UNSW
+#error "The paged VM system needs the frame table: add options unsw"
+#endif
+
+/* Largest fault-around window, in pages; see vm_faultaround. */
+#define VM_FAULTAROUND_MAX	16
+
+/* Free frame watermarks; see above. */
+#define VM_FREEMIN_MIN	4
+static unsigned vm_freemin;
+static unsigned vm_freelow;
+static unsigned vm_freehigh;
+
+struct spinlock vm_ptlock = SPINLOCK_INITIALIZER;
+static struct wchan *vm_pagewchan;	/* for PTE_BUSY pages */
+
+static struct lock *vm_pageout_lock;
+static struct cv *vm_pageout_cv;
+
+static paddr_t vm_zeroframe;		/* the shared zero page */
+static struct lock *vm_zero_lock;
+static struct cv *vm_zero_cv;
+
+static void vm_pageout_thread(void *, unsigned long);
+static void vm_zero_thread(void *, unsigned long);
+
+void
+vm_bootstrap(void)
+{
+	vaddr_t zeropage;
+	int result;
+
+	vm_freemin = frame_nframes() / 64;
+	if (vm_freemin < VM_FREEMIN_MIN) {
+		vm_freemin = VM_FREEMIN_MIN;
+	}
+	vm_freelow = vm_freemin * 2;
+	vm_freehigh = vm_freemin * 4;
+
+	vm_pagewchan = wchan_create("vmpage");
+	vm_pageout_lock = lock_create("pageout");
+	vm_pageout_cv = cv_create("pageout");
+	vm_zero_lock = lock_create("vmzero");
+	vm_zero_cv = cv_create("vmzero");
+	zeropage = alloc_zeroed_kpage();
+	if (vm_pagewchan == NULL || vm_pageout_lock == NULL ||
+	    vm_pageout_cv == NULL || vm_zero_lock == NULL ||
+	    vm_zero_cv == NULL || zeropage == 0) {
+		panic("vm_bootstrap: Out of memory\n");
+	}
+	/* Our reference keeps it from ever looking unshared. */
+	vm_zeroframe = KVADDR_TO_PADDR(zeropage);
+
+	swap_bootstrap();
+
+	result = thread_fork("pageout", NULL, vm_pageout_thread, NULL, 0);
+	if (result) {
+		panic("vm_bootstrap: thread_fork failed: %s\n",
+		      strerror(result));
+	}
+	result = thread_fork("vmzero", NULL, vm_zero_thread, NULL, 0);
+	if (result) {
+		panic("vm_bootstrap: thread_fork failed: %s\n",
+		      strerror(result));
+	}
+}
+
+////////////////////////////////////////////////////////////
+//
+// TLB management
+
+/*
+ * Address space IDs.
+ *
+ * Each address space gets one of the NUM_TLBPIDS PIDs the TLB can
+ * tag entries with, so switching between processes doesn't mean
+ * flushing the TLB. PIDs are handed out in order; when they run out,
+ * a new generation starts and they are all handed out again. An
+ * address space's as_asid holds the generation in the bits above the
+ * PID; one from an old generation gets a new PID the next time it is
+ * activated. Each CPU flushes its TLB once per generation, the first
+ * time it activates an address space in a new one, because its TLB
+ * may still have entries tagged with the reused PIDs.
+ *
+ * A shootdown on a CPU that hasn't caught up with the current
+ * generation yet flushes everything, since the PID it names may
+ * have meant some other address space there.
+ *
+ * Because entries stay behind when a process moves on, an address
+ * space can have entries on any CPU it ever ran on, even with one
+ * thread. as_tlbcpus remembers those CPUs (it's never cleared), and
+ * shootdowns for the address space go to them and no others.
+ */
+
+#if MAXCPUS > 32
+#error "as_tlbcpus needs more bits"
+#endif
+
+#define ASID_PID(asid)	((asid) & (NUM_TLBPIDS - 1))
+#define ASID_GEN(asid)	((asid) & ~(uint32_t)(NUM_TLBPIDS - 1))
+
+static struct spinlock vm_asidlock = SPINLOCK_INITIALIZER;
+static uint32_t vm_asidgen = NUM_TLBPIDS;	/* current generation */
+static uint32_t vm_asidnext = 0;		/* next PID in it */
+static unsigned vm_asidflushes = 0;		/* new-generation flushes */
+
+void
+vm_tlbload(vaddr_t vaddr, pte_t pte)
+{
+	struct cputlb *ct;
+	uint32_t ehi;
+	int index, spl;
+
+	KASSERT((vaddr & PAGE_FRAME) == vaddr);
+	KASSERT(pte & PTE_VALID);
+
+	spl = splhigh();
+	ct = &cputlbs[curcpu->c_number];
+	ehi = vaddr | (ct->ct_pid << TLBHI_PIDSHIFT);
+	index = tlb_probe(ehi, 0);
+	if (index >= 0) {
+		tlb_write(ehi, PTE_TLBLO(pte), index);
+	}
+	else {
+		tlb_random(ehi, PTE_TLBLO(pte));
+	}
+	ct->ct_faults++;
+	splx(spl);
+}
+
+void
+vm_tlbinvalidate(vaddr_t vaddr, uint32_t pid)
+{
+	int index, spl;
+
+	spl = splhigh();
+	index = tlb_probe((vaddr & PAGE_FRAME) | (pid << TLBHI_PIDSHIFT), 0);
+	if (index >= 0) {
+		tlb_write(TLBHI_INVALID(index), TLBLO_INVALID(), index);
+	}
+	splx(spl);
+}
+
+void
+vm_tlbflush(void)
+{
+	int i, spl;
+
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	splx(spl);
+}
+
+void
+vm_tlbactivate(struct addrspace *as)
+{
+	struct cputlb *ct;
+	int spl;
+
+	spl = splhigh();
+	ct = &cputlbs[curcpu->c_number];
+	if (as == NULL) {
+		ct->ct_pagetable = 0;
+		splx(spl);
+		return;
+	}
+
+	spinlock_acquire(&vm_asidlock);
+	if (ASID_GEN(as->as_asid) != vm_asidgen) {
+		if (vm_asidnext == NUM_TLBPIDS) {
+			/* Out of PIDs; start over in a new generation. */
+			vm_asidgen += NUM_TLBPIDS;
+			vm_asidnext = 0;
+		}
+		as->as_asid = vm_asidgen | vm_asidnext++;
+	}
+	if (curcpu->c_asidgen != vm_asidgen) {
+		vm_tlbflush();
+		curcpu->c_asidgen = vm_asidgen;
+		vm_asidflushes++;
+	}
+	ct->ct_pid = ASID_PID(as->as_asid);
+	as->as_tlbcpus |= (uint32_t)1 << curcpu->c_number;
+	spinlock_release(&vm_asidlock);
+
+	ct->ct_pagetable = (vaddr_t)as->as_pt;
+	tlb_setpid(ct->ct_pid);
+	splx(spl);
+}
+
+void
+vm_tlbshootdown_all(void)
+{
+	vm_tlbflush();
+}
+
+void
+vm_tlbshootdown(const struct tlbshootdown *ts)
+{
+	unsigned i;
+	bool stale;
+
+	if (KVA_OWNS(ts->ts_vaddr)) {
+		kva_tlbshootdown(ts);
+		return;
+	}
+
+	spinlock_acquire(&vm_asidlock);
+	stale = curcpu->c_asidgen != vm_asidgen;
+	spinlock_release(&vm_asidlock);
+	if (stale || ts->ts_npages > NUM_TLB) {
+		/* (or it's cheaper to drop the lot than probe each page) */
+		vm_tlbflush();
+		return;
+	}
+
+	for (i=0; i<ts->ts_npages; i++) {
+		vm_tlbinvalidate(ts->ts_vaddr + i * PAGE_SIZE, ts->ts_pid);
+	}
+}
+
+/*
+ * Total the user TLB misses and the entries vm_fault loaded, over all
+ * CPUs. The counts aren't synchronized; they're only for reporting.
+ */
+static
+void
+vm_tlbcounts(unsigned *misses, unsigned *faults)
+{
+	unsigned i;
+
+	*misses = *faults = 0;
+	for (i=0; i<MAXCPUS; i++) {
+		*misses += cputlbs[i].ct_misses;
+		*faults += cputlbs[i].ct_faults;
+	}
+}
+
+/*
+ * Print TLB and page cache statistics.
+ */
+void
+vm_printstats(void)
+{
+	unsigned misses, faults;
+
+	vm_tlbcounts(&misses, &faults);
+	kprintf("vm: %u user TLB misses, %u handled by vm_fault\n",
+		misses, faults);
+	kprintf("vm: %u ASID generations, %u TLB flushes for them\n",
+		vm_asidgen / NUM_TLBPIDS, vm_asidflushes);
+	kprintf("vm: %u mappings of the zero page\n",
+		frame_refcount(vm_zeroframe) - 1);
+	frame_printstats();
+	textcache_printstats();
+}
+
+/*
+ * Note the TLB counts and the time, for vm_printrates.
+ */
+void
+vm_sample(struct vmsample *vs)
+{
+	vm_tlbcounts(&vs->vs_misses, &vs->vs_faults);
+	gettime(&vs->vs_when);
+}
+
+/*
+ * Print the user TLB misses and vm_fault calls since SINCE was taken,
+ * and their rates.
+ */
+void
+vm_printrates(const struct vmsample *since)
+{
+	struct vmsample now;
+	struct timespec elapsed;
+	unsigned misses, faults;
+	uint64_t msecs;
+
+	vm_sample(&now);
+	misses = now.vs_misses - since->vs_misses;
+	faults = now.vs_faults - since->vs_faults;
+	timespec_sub(&now.vs_when, &since->vs_when, &elapsed);
+	msecs = (uint64_t)elapsed.tv_sec * 1000 + elapsed.tv_nsec / 1000000;
+	if (msecs == 0) {
+		msecs = 1;
+	}
+
+	kprintf("vm: %u user TLB misses in %llu.%03u seconds (%u/sec)\n",
+		misses, (unsigned long long)(msecs / 1000),
+		(unsigned)(msecs % 1000),
+		(unsigned)((uint64_t)misses * 1000 / msecs));
+	kprintf("vm: %u handled by vm_fault (%u/sec)\n",
+		faults, (unsigned)((uint64_t)faults * 1000 / msecs));
+}
+
+/*
+ * File V was written or truncated. Pages of it already mapped stay as
+ * they are, but the text cache must not hand them out again.
+ */
+void
+vm_filechanged(struct vnode *v)
+{
+	textcache_invalidate(v);
+}
+
+/*
+ * Count pages of AS coming into or leaving core.
+ */
+void
+vm_rssadjust(struct addrspace *as, int delta)
+{
+	KASSERT(spinlock_do_i_hold(&vm_ptlock));
+	KASSERT(delta >= 0 || as->as_rss >= (unsigned)-delta);
+
+	as->as_rss += delta;
+	if (as->as_rss > as->as_maxrss) {
+		as->as_maxrss = as->as_rss;
+	}
+}
+
+////////////////////////////////////////////////////////////
+//
+// Page replacement
+
+/*
+ * Drop any TLB entries for VADDR in address space AS, on every CPU
+ * that may have them. This doesn't wait for the other CPUs; use
+ * ipi_tlbshootdown_wait before reusing the page's frame.
+ */
+static
+void
+vm_unmap(struct addrspace *as, vaddr_t vaddr)
+{
+	struct tlbshootdown ts;
+	uint32_t cpus;
+
+	ts.ts_vaddr = vaddr;
+	ts.ts_npages = 1;
+	spinlock_acquire(&vm_asidlock);
+	ts.ts_pid = ASID_PID(as->as_asid);
+	cpus = as->as_tlbcpus;
+	spinlock_release(&vm_asidlock);
+
+	vm_tlbshootdown(&ts);
+	ipi_tlbshootdown_some(cpus, &ts);
+}
+
+/*
+ * Drop every TLB entry for address space AS, on every CPU that may
+ * have some. As with vm_unmap, this doesn't wait.
+ */
+void
+vm_tlbflushas(struct addrspace *as)
+{
+	struct tlbshootdown ts;
+	uint32_t cpus;
+
+	ts.ts_vaddr = 0;
+	ts.ts_npages = USERSPACETOP / PAGE_SIZE;
+	spinlock_acquire(&vm_asidlock);
+	ts.ts_pid = ASID_PID(as->as_asid);
+	cpus = as->as_tlbcpus;
+	spinlock_release(&vm_asidlock);
+
+	vm_tlbshootdown(&ts);
+	ipi_tlbshootdown_some(cpus, &ts);
+}
+
+/*
+ * Evict one page. Returns ENOMEM if there are no pages that could be
+ * evicted, or an error from swap if writing the page out failed.
+ */
+static
+int
+vm_evict(void)
+{
+	struct addrspace *as;
+	vaddr_t vaddr;
+	paddr_t frame;
+	pte_t *ptep;
+	unsigned n, slot;
+	bool cached;
+	int result;
+
+	spinlock_acquire(&vm_ptlock);
+
+	/* Two revolutions: one to clear referenced bits, one to evict. */
+	for (n = 0; ; n++) {
+		if (n >= 2 * frame_nframes()) {
+			spinlock_release(&vm_ptlock);
+			return ENOMEM;
+		}
+		frame = frame_nextvictim(&as, &vaddr);
+		if (frame == 0) {
+			spinlock_release(&vm_ptlock);
+			return ENOMEM;
+		}
+		ptep = pt_lookup(as->as_pt, vaddr, false);
+		KASSERT(ptep != NULL);
+		KASSERT((*ptep & PTE_INCORE) && (*ptep & PTE_FRAME) == frame);
+		if (*ptep & PTE_BUSY) {
+			continue;
+		}
+		if (*ptep & PTE_VALID) {
+			/* Referenced since the hand last passed. */
+			*ptep &= ~(pte_t)PTE_VALID;
+			vm_unmap(as, vaddr);
+			continue;
+		}
+		break;
+	}
+
+	/*
+	 * The page's TLB entries were shot down when its referenced bit
+	 * was cleared, but that doesn't wait for the other CPUs. Before
+	 * the frame is written out or reused (below), make sure they
+	 * have all dropped them; otherwise one could go on reading the
+	 * frame, or writing it after we've copied it.
+	 */
+
+	if (*ptep & PTE_CLEAN) {
+		/* Still as read from the file; just let it go. */
+		KASSERT(frame_getslot(frame) == SWAP_NOSLOT);
+		cached = (*ptep & PTE_CACHED) != 0;
+		*ptep = 0;
+		vm_rssadjust(as, -1);
+		frame_setowner(frame, NULL, 0);
+		spinlock_release(&vm_ptlock);
+		ipi_tlbshootdown_wait();
+		if (cached) {
+			textcache_release(frame, as);
+		}
+		else {
+			frame_decref(frame);
+		}
+		return 0;
+	}
+
+	/*
+	 * The page has been unmapped since the last pass. Mark it busy,
+	 * so anyone touching it waits, and write it out if need be.
+	 */
+	*ptep |= PTE_BUSY;
+	as->as_pageouts++;
+	slot = frame_getslot(frame);
+	spinlock_release(&vm_ptlock);
+	ipi_tlbshootdown_wait();
+
+	result = 0;
+	if (slot == SWAP_NOSLOT) {
+		result = swap_alloc(&slot);
+		if (result == 0) {
+			result = swap_out(slot, frame);
+			if (result) {
+				swap_free(slot);
+			}
+		}
+	}
+
+	spinlock_acquire(&vm_ptlock);
+	if (result) {
+		*ptep &= ~(pte_t)PTE_BUSY;
+	}
+	else {
+		*ptep = PTE_MKSLOT(slot);
+		vm_rssadjust(as, -1);
+		frame_setowner(frame, NULL, 0);
+		frame_setslot(frame, SWAP_NOSLOT);
+	}
+	as->as_pageouts--;
+	wchan_wakeall(vm_pagewchan, &vm_ptlock);
+	spinlock_release(&vm_ptlock);
+
+	if (result == 0) {
+		frame_decref(frame);
+	}
+	return result;
+}
+
+/*
+ * Keep the free frame count between the watermarks.
+ */
+static
+void
+vm_pageout_thread(void *unused1, unsigned long unused2)
+{
+	(void)unused1;
+	(void)unused2;
+
+	while (1) {
+		lock_acquire(vm_pageout_lock);
+		cv_wait(vm_pageout_cv, vm_pageout_lock);
+		lock_release(vm_pageout_lock);
+
+		while (frame_nfree() < vm_freehigh) {
+			if (vm_evict()) {
+				/* Nothing (more) to evict; wait to be asked. */
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Keep the zero pool filled. Yielding after every frame means this
+ * mostly runs on CPUs that have nothing else to do: when there's
+ * other work, it gets no more than a page's worth of time per turn.
+ */
+static
+void
+vm_zero_thread(void *unused1, unsigned long unused2)
+{
+	(void)unused1;
+	(void)unused2;
+
+	while (1) {
+		lock_acquire(vm_zero_lock);
+		cv_wait(vm_zero_cv, vm_zero_lock);
+		lock_release(vm_zero_lock);
+
+		while (frame_nfree() > vm_freehigh && frame_prezero()) {
+			thread_yield();
+		}
+	}
+}
+
+void
+vm_pagewait(void)
+{
+	KASSERT(spinlock_do_i_hold(&vm_ptlock));
+	wchan_sleep(vm_pagewchan, &vm_ptlock);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Pages
+
+/*
+ * Get a frame for a user page, evicting if needed. If ZERO is set it
+ * comes zero-filled (from the zeroing thread's pool if possible);
+ * otherwise the contents are garbage.
+ */
+static
+int
+vm_getframe(paddr_t *ret, bool zero)
+{
+	vaddr_t kva;
+
+	if (frame_nfree() < vm_freelow) {
+		lock_acquire(vm_pageout_lock);
+		cv_signal(vm_pageout_cv, vm_pageout_lock);
+		lock_release(vm_pageout_lock);
+	}
+
+	/* Leave the last few frames to the kernel. */
+	while (frame_nfree() <= vm_freemin) {
+		if (vm_evict()) {
+			break;
+		}
+	}
+
+	if (zero && frame_nzeroed() < ZERO_POOL_SIZE / 2) {
+		/* Half empty; have it refilled. */
+		lock_acquire(vm_zero_lock);
+		cv_signal(vm_zero_cv, vm_zero_lock);
+		lock_release(vm_zero_lock);
+	}
+
+	while ((kva = (zero ? alloc_zeroed_kpage() : alloc_kpages(1))) == 0) {
+		if (vm_evict()) {
+			return ENOMEM;
+		}
+	}
+	*ret = KVADDR_TO_PADDR(kva);
+	return 0;
+}
+
+int
+vm_newpage(pte_t *ret)
+{
+	paddr_t frame;
+	int result;
+
+	KASSERT(!spinlock_do_i_hold(&vm_ptlock));
+
+	result = vm_getframe(&frame, true);
+	if (result) {
+		return result;
+	}
+	*ret = frame | PTE_INCORE | PTE_VALID;
+	return 0;
+}
+
+/*
+ * Get a reference to the shared zero page, as a PTE for mapping it
+ * read-only.
+ */
+static
+pte_t
+vm_zeropage(void)
+{
+	frame_incref(vm_zeroframe);
+	return vm_zeroframe | PTE_INCORE | PTE_VALID;
+}
+
+void
+vm_freepage(struct addrspace *as, pte_t pte)
+{
+	paddr_t frame;
+	unsigned slot;
+
+	KASSERT(spinlock_do_i_hold(&vm_ptlock));
+	KASSERT((pte & PTE_BUSY) == 0);
+
+	if (pte & PTE_CACHED) {
+		textcache_release(pte & PTE_FRAME, as);
+	}
+	else if (pte & PTE_INCORE) {
+		frame = pte & PTE_FRAME;
+		slot = frame_getslot(frame);
+		if (frame_unmap(frame, as) == 0 && slot != SWAP_NOSLOT) {
+			swap_free(slot);
+		}
+	}
+	else if (pte & PTE_SWAPPED) {
+		swap_free(PTE_SLOT(pte));
+	}
+}
+
+/*
+ * Find the part [*START, *END) of the page at VADDR in region RG that
+ * comes from the region's file, and the file offset of VADDR itself.
+ * Returns false if none of it does.
+ */
+static
+bool
+vm_fileextent(struct region *rg, vaddr_t vaddr,
+	      vaddr_t *start, vaddr_t *end, off_t *offset)
+{
+	if (rg->rg_vnode == NULL) {
+		return false;
+	}
+	*start = vaddr > rg->rg_fileva ? vaddr : rg->rg_fileva;
+	*end = rg->rg_fileva + rg->rg_filesize;
+	if (*end > vaddr + PAGE_SIZE) {
+		*end = vaddr + PAGE_SIZE;
+	}
+	*offset = rg->rg_fileoff + ((off_t)vaddr - (off_t)rg->rg_fileva);
+	return *start < *end;
+}
+
+/*
+ * Make a new page for VADDR in region RG: zeros, with the part of the
+ * region's file that belongs there, if any, read on top. If SHARE is
+ * set the page won't ever be written, so use (or add) the copy in the
+ * text page cache. If ZERO is set and the page is all zeros, just map
+ * the shared zero page; the first write, if any, copies it. Sets *IO
+ * if the file had to be read.
+ */
+static
+int
+vm_fillpage(struct region *rg, vaddr_t vaddr, bool share, bool zero,
+	    pte_t *ret, bool *io)
+{
+	struct iovec iov;
+	struct uio ku;
+	vaddr_t start, end;
+	off_t offset;
+	paddr_t frame;
+	pte_t pte;
+	int result;
+
+	if (!vm_fileextent(rg, vaddr, &start, &end, &offset)) {
+		/* No file data here; not worth caching. */
+		if (zero || share) {
+			*ret = vm_zeropage();
+			return 0;
+		}
+		return vm_newpage(ret);
+	}
+
+	if (share) {
+		frame = textcache_lookup(rg->rg_vnode, offset,
+					 start - vaddr, end - vaddr);
+		if (frame != 0) {
+			*ret = frame | PTE_INCORE | PTE_VALID | PTE_CACHED;
+			return 0;
+		}
+	}
+
+	result = vm_newpage(&pte);
+	if (result) {
+		return result;
+	}
+	*io = true;
+	uio_kinit(&iov, &ku,
+		  (void *)(PADDR_TO_KVADDR(pte & PTE_FRAME) + (start - vaddr)),
+		  end - start, offset + (start - vaddr), UIO_READ);
+	result = VOP_READ(rg->rg_vnode, &ku);
+	if (result == 0 && ku.uio_resid != 0) {
+		/* The file got truncated under us. */
+		result = EIO;
+	}
+	if (result) {
+		spinlock_acquire(&vm_ptlock);
+		vm_freepage(NULL, pte);
+		spinlock_release(&vm_ptlock);
+		return result;
+	}
+
+	if (share) {
+		frame = pte & PTE_FRAME;
+		if (textcache_insert(rg->rg_vnode, offset,
+				     start - vaddr, end - vaddr, &frame) == 0) {
+			if (frame != (pte & PTE_FRAME)) {
+				/* Someone else read it in first. */
+				spinlock_acquire(&vm_ptlock);
+				vm_freepage(NULL, pte);
+				spinlock_release(&vm_ptlock);
+			}
+			pte = frame | PTE_INCORE | PTE_VALID | PTE_CACHED;
+		}
+		/* else we couldn't cache it, but can use it anyway. */
+	}
+	*ret = pte;
+	return 0;
+}
+
+/*
+ * Write the part of the page at VADDR in region RG that belongs to
+ * the file, from FRAME, back to the file.
+ */
+static
+int
+vm_writeback(struct region *rg, vaddr_t vaddr, paddr_t frame)
+{
+	struct iovec iov;
+	struct uio ku;
+	vaddr_t start, end;
+	off_t offset;
+	int result;
+
+	if (!vm_fileextent(rg, vaddr, &start, &end, &offset)) {
+		return 0;
+	}
+	uio_kinit(&iov, &ku,
+		  (void *)(PADDR_TO_KVADDR(frame) + (start - vaddr)),
+		  end - start, offset + (start - vaddr), UIO_WRITE);
+	result = VOP_WRITE(rg->rg_vnode, &ku);
+	vm_filechanged(rg->rg_vnode);
+	if (result == 0 && ku.uio_resid != 0) {
+		result = EIO;
+	}
+	return result;
+}
+
+/*
+ * Write the page at VADDR in region RG of AS, which is a MAP_SHARED
+ * mapping, back to the file if it has been changed. Afterwards the
+ * page is clean again: write-protected, and if it was out on swap,
+ * dropped, so it will be read back from the file. The caller holds
+ * as_lock.
+ */
+int
+vm_syncpage(struct addrspace *as, struct region *rg, vaddr_t vaddr)
+{
+	pte_t *ptep, pte;
+	paddr_t frame;
+	unsigned slot;
+	int result;
+
+	KASSERT(lock_do_i_hold(as->as_lock));
+	KASSERT(rg->rg_flags & RG_SHARED);
+
+	spinlock_acquire(&vm_ptlock);
+	ptep = pt_lookup(as->as_pt, vaddr, false);
+	if (ptep == NULL) {
+		spinlock_release(&vm_ptlock);
+		return 0;
+	}
+	while (*ptep & PTE_BUSY) {
+		vm_pagewait();
+	}
+	pte = *ptep;
+	if (pte == 0 || (pte & PTE_CLEAN)) {
+		/* Untouched, or the same as the file. */
+		spinlock_release(&vm_ptlock);
+		return 0;
+	}
+
+	*ptep |= PTE_BUSY;
+	if (pte & PTE_SWAPPED) {
+		/* Read it into a scratch frame to write it out. */
+		spinlock_release(&vm_ptlock);
+		slot = PTE_SLOT(pte);
+		result = vm_getframe(&frame, false);
+		if (result == 0) {
+			result = swap_in(slot, frame);
+			if (result == 0) {
+				result = vm_writeback(rg, vaddr, frame);
+			}
+			frame_decref(frame);
+		}
+		spinlock_acquire(&vm_ptlock);
+		if (result == 0) {
+			*ptep = 0;
+			swap_free(slot);
+		}
+		else {
+			*ptep &= ~(pte_t)PTE_BUSY;
+		}
+	}
+	else {
+		/*
+		 * Write-protect it first, so any write while we're
+		 * writing it out faults (and waits for us) and makes
+		 * it dirty again.
+		 */
+		frame = pte & PTE_FRAME;
+		if (pte & PTE_DIRTY) {
+			*ptep &= ~(pte_t)PTE_DIRTY;
+			vm_unmap(as, vaddr);
+		}
+		spinlock_release(&vm_ptlock);
+		if (pte & PTE_DIRTY) {
+			/* No CPU may still be writing it as we copy it. */
+			ipi_tlbshootdown_wait();
+		}
+		result = vm_writeback(rg, vaddr, frame);
+		spinlock_acquire(&vm_ptlock);
+		*ptep &= ~(pte_t)PTE_BUSY;
+		if (result == 0) {
+			*ptep |= PTE_CLEAN;
+			slot = frame_getslot(frame);
+			if (slot != SWAP_NOSLOT) {
+				frame_setslot(frame, SWAP_NOSLOT);
+				swap_free(slot);
+			}
+		}
+	}
+	wchan_wakeall(vm_pagewchan, &vm_ptlock);
+	spinlock_release(&vm_ptlock);
+	return result;
+}
+
+/*
+ * Throw away the page at VADDR in AS, if there is one, and any TLB
+ * entries for it. The caller holds as_lock.
+ */
+void
+vm_droppage(struct addrspace *as, vaddr_t vaddr)
+{
+	pte_t *ptep, pte;
+
+	KASSERT(lock_do_i_hold(as->as_lock));
+
+	spinlock_acquire(&vm_ptlock);
+	ptep = pt_lookup(as->as_pt, vaddr, false);
+	if (ptep != NULL) {
+		while (*ptep & PTE_BUSY) {
+			vm_pagewait();
+		}
+		if (*ptep & PTE_INCORE) {
+			/*
+			 * Every CPU must drop it from its TLB before
+			 * the frame can be reused. Keep it busy while
+			 * we wait, so no one maps or pages it out.
+			 */
+			*ptep &= ~(pte_t)(PTE_VALID | PTE_DIRTY);
+			*ptep |= PTE_BUSY;
+			vm_unmap(as, vaddr);
+			spinlock_release(&vm_ptlock);
+			ipi_tlbshootdown_wait();
+			spinlock_acquire(&vm_ptlock);
+			*ptep &= ~(pte_t)PTE_BUSY;
+			vm_rssadjust(as, -1);
+			wchan_wakeall(vm_pagewchan, &vm_ptlock);
+		}
+		pte = *ptep;
+		if (pte != 0) {
+			*ptep = 0;
+			vm_freepage(as, pte);
+		}
+	}
+	spinlock_release(&vm_ptlock);
+	textcache_reap();
+}
+
+/*
+ * Bring the page *PTEP refers to in from swap. Called and returns
+ * with vm_ptlock held, but drops it to do the I/O.
+ */
+int
+vm_swapin(struct addrspace *as, vaddr_t vaddr, pte_t *ptep)
+{
+	paddr_t frame;
+	unsigned slot;
+	int result;
+
+	KASSERT(*ptep & PTE_SWAPPED);
+	slot = PTE_SLOT(*ptep);
+	*ptep |= PTE_BUSY;
+	spinlock_release(&vm_ptlock);
+
+	result = vm_getframe(&frame, false);
+	if (result == 0) {
+		result = swap_in(slot, frame);
+		if (result) {
+			frame_decref(frame);
+		}
+	}
+
+	spinlock_acquire(&vm_ptlock);
+	if (result) {
+		*ptep &= ~(pte_t)PTE_BUSY;
+	}
+	else {
+		/* Keep the slot; the page is clean until written. */
+		*ptep = frame | PTE_INCORE | PTE_VALID;
+		frame_setslot(frame, slot);
+		frame_setowner(frame, as, vaddr);
+		vm_rssadjust(as, 1);
+		as->as_nswapins++;
+	}
+	wchan_wakeall(vm_pagewchan, &vm_ptlock);
+	return result;
+}
+
+/*
+ * Handle a write to a page of region RG that is mapped read-only
+ * because it may be shared copy-on-write, or because it is clean. On
+ * success *PTEP allows writes, and maps a frame only this address
+ * space refers to, unless RG is MAP_SHARED, whose frames are shared
+ * with forked copies for real. Called and returns with vm_ptlock
+ * held.
+ */
+static
+int
+vm_cowbreak(struct addrspace *as, struct region *rg, vaddr_t vaddr,
+	    pte_t *ptep)
+{
+	paddr_t oldframe, newframe;
+	unsigned slot;
+	pte_t newpte;
+	bool copy;
+	int result;
+
+	KASSERT(*ptep & PTE_INCORE);
+	oldframe = *ptep & PTE_FRAME;
+
+	if (*ptep & PTE_CACHED) {
+		copy = true;
+	}
+	else if (frame_refcount(oldframe) > 1) {
+		copy = (rg->rg_flags & RG_SHARED) == 0 ||
+			oldframe == vm_zeroframe;
+	}
+	else {
+		copy = false;
+	}
+
+	if (copy) {
+		/*
+		 * Copy it. The frame is shared, so it can't be evicted
+		 * (or is cached, and can be evicted only through our
+		 * entry); marking our entry busy keeps it that way if
+		 * the others go away while we're at it.
+		 *
+		 * Our other threads may have the old frame in their
+		 * TLBs, and would go on reading it after we switch to
+		 * the copy, so it comes out of every TLB first. Until
+		 * the copy is in, the entry is invalid as well as busy,
+		 * so they fault and wait for us if they touch it.
+		 */
+		*ptep = (*ptep & ~(pte_t)PTE_VALID) | PTE_BUSY;
+		vm_unmap(as, vaddr);
+		spinlock_release(&vm_ptlock);
+		ipi_tlbshootdown_wait();
+		if (oldframe == vm_zeroframe) {
+			/* No need to copy zeros. */
+			result = vm_newpage(&newpte);
+		}
+		else {
+			result = vm_getframe(&newframe, false);
+			if (result == 0) {
+				memmove((void *)PADDR_TO_KVADDR(newframe),
+					(const void *)PADDR_TO_KVADDR(oldframe),
+					PAGE_SIZE);
+				newpte = newframe | PTE_INCORE | PTE_VALID;
+			}
+		}
+		spinlock_acquire(&vm_ptlock);
+		*ptep = (*ptep & ~(pte_t)PTE_BUSY) | PTE_VALID;
+		wchan_wakeall(vm_pagewchan, &vm_ptlock);
+		if (result) {
+			return result;
+		}
+		/*
+		 * If the other sharers dropped their references while
+		 * we were copying, this frees the frame; that's fine.
+		 */
+		vm_freepage(as, *ptep);
+		*ptep = newpte | (*ptep & ~(pte_t)PTE_FRAME);
+		as->as_ncowbreaks++;
+	}
+	else {
+		/* The swap copy is about to be out of date. */
+		slot = frame_getslot(oldframe);
+		if (slot != SWAP_NOSLOT) {
+			frame_setslot(oldframe, SWAP_NOSLOT);
+			swap_free(slot);
+		}
+	}
+	frame_setowner(*ptep & PTE_FRAME, as, vaddr);
+	*ptep = (*ptep & ~(pte_t)(PTE_CLEAN | PTE_CACHED)) | PTE_DIRTY;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Direct access for copyin/copyout
+
+/*
+ * Pin the page at VADDR in AS so the kernel can copy to or from it
+ * through kseg0, and hand back its frame. This only works when the
+ * access wouldn't fault anyway: the page must be in core and
+ * referenced, and for WRITE already writeable. Otherwise return
+ * false; the caller should go through the user address and let
+ * vm_fault sort it out. Marking the page busy keeps it from being
+ * evicted, shared by as_copy, or dropped until vm_unpinpage.
+ */
+bool
+vm_pinpage(struct addrspace *as, vaddr_t vaddr, bool write, paddr_t *ret)
+{
+	pte_t *ptep, need;
+
+	need = PTE_INCORE | PTE_VALID | (write ? PTE_DIRTY : 0);
+
+	spinlock_acquire(&vm_ptlock);
+	ptep = pt_lookup(as->as_pt, vaddr, false);
+	if (ptep == NULL || (*ptep & (need | PTE_BUSY)) != need) {
+		spinlock_release(&vm_ptlock);
+		return false;
+	}
+	*ptep |= PTE_BUSY;
+	*ret = *ptep & PTE_FRAME;
+	spinlock_release(&vm_ptlock);
+	return true;
+}
+
+void
+vm_unpinpage(struct addrspace *as, vaddr_t vaddr)
+{
+	pte_t *ptep;
+
+	spinlock_acquire(&vm_ptlock);
+	ptep = pt_lookup(as->as_pt, vaddr, false);
+	KASSERT(ptep != NULL && (*ptep & PTE_BUSY));
+	*ptep &= ~(pte_t)PTE_BUSY;
+	wchan_wakeall(vm_pagewchan, &vm_ptlock);
+	spinlock_release(&vm_ptlock);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Faults
+
+/*
+ * Put PTE, fresh from vm_fillpage, into the empty entry *PTEP for
+ * VADDR in region RG of AS, with the permissions the region calls
+ * for. WRITEABLE says whether the region can be written just now.
+ * Called with vm_ptlock held.
+ */
+static
+void
+vm_setpage(struct addrspace *as, struct region *rg, vaddr_t vaddr,
+	   bool writeable, pte_t *ptep, pte_t pte)
+{
+	KASSERT(*ptep == 0);
+
+	if (writeable && !(rg->rg_flags & RG_SHARED) &&
+	    (pte & PTE_FRAME) != vm_zeroframe) {
+		pte |= PTE_DIRTY;
+	}
+	else {
+		/*
+		 * Read-only, the zero page, or a shared mapping whose
+		 * first write should be noticed; in each case, until
+		 * written it can always be read again.
+		 */
+		pte |= PTE_CLEAN;
+	}
+	*ptep = pte;
+	vm_rssadjust(as, 1);
+	if ((pte & PTE_FRAME) != vm_zeroframe) {
+		frame_setowner(pte & PTE_FRAME, as, vaddr);
+	}
+}
+
+/*
+ * Fill a page as vm_fillpage would, but only if that needs no I/O:
+ * the page has no file data, or it's shared text that's in the text
+ * page cache. Returns false, having done nothing, otherwise or if
+ * there's no memory.
+ */
+static
+bool
+vm_fillpage_noio(struct region *rg, vaddr_t vaddr, bool share, bool zero,
+		 pte_t *ret)
+{
+	vaddr_t start, end;
+	off_t offset;
+	paddr_t frame;
+
+	if (!vm_fileextent(rg, vaddr, &start, &end, &offset)) {
+		if (zero || share) {
+			*ret = vm_zeropage();
+			return true;
+		}
+		return vm_newpage(ret) == 0;
+	}
+	if (share) {
+		frame = textcache_lookup(rg->rg_vnode, offset,
+					 start - vaddr, end - vaddr);
+		if (frame != 0) {
+			*ret = frame | PTE_INCORE | PTE_VALID | PTE_CACHED;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Fault-around, after a successful fault at FAULTADDRESS in region RG.
+ *
+ * If the fault is where the last one left off, double the window (up
+ * to VM_FAULTAROUND_MAX), otherwise go back to a window of just the
+ * faulting page. Then make the rest of the window, the pages after
+ * FAULTADDRESS, ready to use: pages in core that the clock hand has
+ * marked unreferenced are marked referenced again, and empty pages
+ * are filled if that takes no I/O (with the zero page, if ZERO says
+ * the fault was a read and the page is all zeros). The UTLB handler
+ * loads them when
+ * they're touched. Stop at the first page that needs I/O (out on
+ * swap, or to be read from the file) or is busy, and when free memory
+ * gets low, since evicting for pages that may not be used is a bad
+ * trade. Called with the address space lock held.
+ */
+static
+void
+vm_faultaround(struct addrspace *as, struct region *rg,
+	       vaddr_t faultaddress, bool writeable, bool zero)
+{
+	vaddr_t va, top;
+	pte_t *ptep, pte;
+	bool share;
+
+	KASSERT(lock_do_i_hold(as->as_lock));
+
+	if (faultaddress == as->as_faultnext) {
+		if (as->as_faultwin < VM_FAULTAROUND_MAX) {
+			as->as_faultwin *= 2;
+		}
+	}
+	else {
+		as->as_faultwin = 1;
+	}
+
+	top = RG_TOP(rg);
+	if (top - faultaddress > as->as_faultwin * PAGE_SIZE) {
+		top = faultaddress + as->as_faultwin * PAGE_SIZE;
+	}
+	share = !writeable && !(rg->rg_flags & RG_MMAP);
+
+	for (va = faultaddress + PAGE_SIZE; va < top; va += PAGE_SIZE) {
+		if (frame_nfree() < vm_freelow) {
+			break;
+		}
+
+		spinlock_acquire(&vm_ptlock);
+		ptep = pt_lookup(as->as_pt, va, true);
+		if (ptep == NULL || (*ptep & (PTE_BUSY | PTE_SWAPPED))) {
+			spinlock_release(&vm_ptlock);
+			break;
+		}
+		if (*ptep & PTE_INCORE) {
+			if ((*ptep & PTE_VALID) == 0) {
+				*ptep |= PTE_VALID;
+				as->as_nprefaults++;
+			}
+			spinlock_release(&vm_ptlock);
+			continue;
+		}
+		/* Empty; as in vm_fault, it stays that way unless we fill it. */
+		spinlock_release(&vm_ptlock);
+
+		if (!vm_fillpage_noio(rg, va, share, zero, &pte)) {
+			break;
+		}
+		spinlock_acquire(&vm_ptlock);
+		vm_setpage(as, rg, va, writeable, ptep, pte);
+		spinlock_release(&vm_ptlock);
+		as->as_nprefaults++;
+	}
+	as->as_faultnext = va;
+}
+
+int
+vm_fault(int faulttype, vaddr_t faultaddress)
+{
+	struct addrspace *as;
+	struct region *rg;
+	pte_t *ptep, pte;
+	bool writeable, io;
+	int result;
+
+	faultaddress &= PAGE_FRAME;
+
+	DEBUG(DB_VM, "vm: fault: 0x%x\n", faultaddress);
+
+	if (KVA_OWNS(faultaddress)) {
+		/* Large kernel allocation, mapped through kseg2. */
+		if (faulttype == VM_FAULT_READONLY) {
+			return EFAULT;
+		}
+		return kva_fault(faultaddress);
+	}
+	if (faultaddress >= USERSPACETOP) {
+		return EFAULT;
+	}
+
+	switch (faulttype) {
+	    case VM_FAULT_READONLY:
+	    case VM_FAULT_READ:
+	    case VM_FAULT_WRITE:
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	if (curproc == NULL) {
+		/*
+		 * No process. This is probably a kernel fault early
+		 * in boot. Return EFAULT so as to panic instead of
+		 * getting into an infinite faulting loop.
+		 */
+		return EFAULT;
+	}
+
+	as = proc_getas();
+	if (as == NULL) {
+		/*
+		 * No address space set up. This is probably also a
+		 * kernel fault early in boot.
+		 */
+		return EFAULT;
+	}
+
+	lock_acquire(as->as_lock);
+
+	rg = as_findregion(as, faultaddress);
+	if (rg == NULL) {
+		lock_release(as->as_lock);
+		return EFAULT;
+	}
+	writeable = (rg->rg_flags & RG_WRITE) != 0 || as->as_loading;
+	if (faulttype != VM_FAULT_READ && !writeable) {
+		lock_release(as->as_lock);
+		return EFAULT;
+	}
+
+	spinlock_acquire(&vm_ptlock);
+	ptep = pt_lookup(as->as_pt, faultaddress, true);
+	if (ptep == NULL) {
+		result = ENOMEM;
+		goto done;
+	}
+	while (*ptep & PTE_BUSY) {
+		/* Being paged out. */
+		vm_pagewait();
+	}
+
+	io = false;
+	if (*ptep == 0) {
+		/*
+		 * First touch: fill it in. Nobody else changes an
+		 * empty entry, so it's safe to let go while allocating
+		 * and reading.
+		 */
+		spinlock_release(&vm_ptlock);
+		result = vm_fillpage(rg, faultaddress,
+				     !writeable && !(rg->rg_flags & RG_MMAP),
+				     faulttype == VM_FAULT_READ, &pte, &io);
+		spinlock_acquire(&vm_ptlock);
+		if (result) {
+			goto done;
+		}
+		vm_setpage(as, rg, faultaddress, writeable, ptep, pte);
+	}
+	else if (*ptep & PTE_SWAPPED) {
+		result = vm_swapin(as, faultaddress, ptep);
+		if (result) {
+			goto done;
+		}
+		io = true;
+	}
+	else {
+		/* Mark it referenced. */
+		*ptep |= PTE_VALID;
+	}
+
+	if (faulttype != VM_FAULT_READ && (*ptep & PTE_DIRTY) == 0) {
+		/* First write since the page was shared or read in. */
+		result = vm_cowbreak(as, rg, faultaddress, ptep);
+		if (result) {
+			goto done;
+		}
+	}
+
+	vm_tlbload(faultaddress, *ptep);
+	result = 0;
+	if (io) {
+		as->as_majflt++;
+	}
+	else {
+		as->as_minflt++;
+	}
+
+ done:
+	spinlock_release(&vm_ptlock);
+	if (result == 0) {
+		vm_faultaround(as, rg, faultaddress, writeable,
+			       faulttype == VM_FAULT_READ);
+	}
+	lock_release(as->as_lock);
+	return result;
+}
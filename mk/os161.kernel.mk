@@ -22,6 +22,9 @@
 # Additional defs for building a kernel.
 #
 
+# The system call table is generated in the build directory; see below.
+SRCS+=syscalltab.c
+
 # All sources.
 ALLSRCS=$(SRCS) $(SRCS.MACHINE.$(MACHINE)) $(SRCS.PLATFORM.$(PLATFORM))
 
@@ -104,6 +107,19 @@ $(KERNEL):
 	@echo '*** This is $(CONFNAME) build #'`cat version`' ***'
 	$(SIZE) $(KERNEL)
 
+#
+# syscalltab.c is the system call table, made from the call numbers
+# in <kern/syscall.h> and the sys_* prototypes in <syscall.h>. See
+# gensyscalltab.sh and syscalltab.h.
+#
+SYSCALLTAB_DEPS=$(KTOP)/include/kern/syscall.h $(KTOP)/include/syscall.h \
+	$(KTOP)/conf/gensyscalltab.sh
+syscalltab.c: $(SYSCALLTAB_DEPS)
+	-rm -f $@ $@.tmp
+	$(KTOP)/conf/gensyscalltab.sh $(KTOP)/include/kern/syscall.h \
+		$(KTOP)/include/syscall.h > $@.tmp
+	mv -f $@.tmp $@
+
 #
 # Use the -M argument to gcc to get it to output dependency information.
 # Note that we use -M, which includes deps for #include <...> files,
@@ -130,6 +146,9 @@ DEPFILES+=.depend.$(_S_:T)
 realdepend: $(DEPFILES)
 	cat $(DEPFILES) > .depend
 
+# The generated table has to exist before its dependencies can be found.
+.depend.syscalltab.c: syscalltab.c
+
 # our make does this implicitly
 #.-include ".depend"
 
@@ -161,7 +180,7 @@ includelinks:
 # blow away the whole compile directory.)
 #
 clean:
-	rm -f *.o *.a tags $(KERNEL)
+	rm -f *.o *.a tags $(KERNEL) syscalltab.c
 	rm -rf includelinks
 
 distclean cleandir: clean
@@ -27,6 +27,9 @@
  * SUCH DAMAGE.
  */
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
 #include <err.h>
@@ -74,6 +77,37 @@ docat(const char *name, int fd)
 	}
 }
 
+/*
+ * Print a file that's already been opened by mapping it, which saves
+ * copying it through a buffer. Returns -1 if it can't be mapped (it
+ * isn't a plain file, say); then use docat.
+ */
+static
+int
+domapcat(int fd)
+{
+	struct stat st;
+	char *p;
+	off_t pos;
+	int wr;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		return -1;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		return -1;
+	}
+	for (pos = 0; pos < st.st_size; pos += wr) {
+		wr = write(STDOUT_FILENO, p + pos, st.st_size - pos);
+		if (wr<0) {
+			err(1, "stdout");
+		}
+	}
+	munmap(p, st.st_size);
+	return 0;
+}
+
 /* Print a file by name. */
 static
 void
@@ -97,7 +131,9 @@ cat(const char *file)
 	if (fd<0) {
 		err(1, "%s", file);
 	}
-	docat(file, fd);
+	if (domapcat(fd) < 0) {
+		docat(file, fd);
+	}
 	close(fd);
 }
 
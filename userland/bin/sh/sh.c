@@ -38,6 +38,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <assert.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -73,6 +74,11 @@ static int timing = 0;
 #define MAXBG 128
 static pid_t bgpids[MAXBG];
 
+/* how often to check on background jobs while waiting for input */
+#define BGPOLL_MSECS 1000
+
+#define PROMPT "OS/161$ "
+
 /*
  * can_bg
  * just checks for an open slot.
@@ -237,20 +243,68 @@ dowaitpoll(pid_t pid)
 
 /*
  * waitpoll
- * poll all background jobs for having exited.
+ * poll all background jobs for having exited. returns how many had.
  */
 static
-void
+int
 waitpoll(void)
 {
-	int i;
+	int i, n = 0;
 	for (i=0; i < MAXBG; i++) {
 		if (bgpids[i] != 0) {
 			if (dowaitpoll(bgpids[i])) {
 				bgpids[i] = 0;
+				n++;
 			}
 		}
 	}
+	return n;
+}
+
+/*
+ * have_bg
+ * checks for any background jobs.
+ */
+static
+int
+have_bg(void)
+{
+	int i;
+
+	for (i = 0; i < MAXBG; i++) {
+		if (bgpids[i] != 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * waitinput
+ * wait for the next command to start arriving. while there are
+ * background jobs, wake up every BGPOLL_MSECS to collect any that
+ * have finished, so they're reported without the user having to
+ * press return; with none, just let the read wait.
+ */
+static
+void
+waitinput(void)
+{
+	struct pollfd pfd;
+
+	while (have_bg()) {
+		pfd.fd = STDIN_FILENO;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, BGPOLL_MSECS) != 0) {
+			/* input is waiting, or poll failed; go read */
+			return;
+		}
+		if (waitpoll() > 0) {
+			printf(PROMPT);
+		}
+	}
 }
 #endif /* WNOHANG */
 
@@ -371,7 +425,7 @@ docommand(char *buf, struct exitinfo *ei)
 	char *s;
 	pid_t pid;
 	int status;
-	int bg=0;
+	volatile int bg=0;	/* live across vfork */
 	time_t startsecs, endsecs;
 	unsigned long startnsecs, endnsecs;
 
@@ -421,11 +475,17 @@ docommand(char *buf, struct exitinfo *ei)
 		__time(&startsecs, &startnsecs);
 	}
 
-	pid = fork();
+	/*
+	 * The child only execs, so use vfork to avoid copying our
+	 * address space for it. It runs in our memory until the exec
+	 * (or _exit), so it must not return or change anything we
+	 * use; errno and the message from warn() are fine.
+	 */
+	pid = vfork();
 	switch (pid) {
 		case -1:
 			/* error */
-			warn("fork");
+			warn("vfork");
 			exitinfo_exit(ei, 255);
 			return;
 		case 0:
@@ -534,7 +594,10 @@ interactive(void)
 	struct exitinfo ei;
 
 	while (1) {
-		printf("OS/161$ ");
+		printf(PROMPT);
+#ifdef WNOHANG
+		waitinput();
+#endif
 		getcmd(buf, sizeof(buf));
 		docommand(buf, &ei);
 		printstatus(&ei, 0);
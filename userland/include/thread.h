@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+/*
+ * User threads. Each one is a kernel thread in the same process,
+ * sharing its memory and open files, with a stack of its own.
+ *
+ * thread_create starts FUNC(ARG) in a new thread and stores its id in
+ * *TID. When FUNC returns, the thread exits; thread_join waits for
+ * that and stores FUNC's return value in *RET (if RET isn't NULL).
+ * Every thread that's created should be joined exactly once, or its
+ * stack is never freed. The thread the program started with can't be
+ * joined; if it returns from main, the process exits, taking the
+ * other threads with it.
+ *
+ * These return 0 on success, and -1 with errno set on error.
+ */
+
+int thread_create(int *tid, void *(*func)(void *), void *arg);
+int thread_join(int tid, void **ret);
+
+/*
+ * Mutexes, for threads of one process. Locking a free mutex and
+ * unlocking one nobody is waiting for are done in user space; only
+ * a thread that has to wait, and the unlock that wakes it, make a
+ * system call (__futex_wait and __futex_wake).
+ *
+ * A mutex can be set up either with MUTEX_INITIALIZER or mutex_init.
+ * mutex_trylock returns 0 if it got the lock and -1 if not.
+ */
+
+struct mutex {
+	volatile int mx_state;	/* 0 free, 1 locked, 2 locked with waiters */
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init(struct mutex *mx);
+void mutex_lock(struct mutex *mx);
+int mutex_trylock(struct mutex *mx);
+void mutex_unlock(struct mutex *mx);
+
+#endif /* _THREAD_H_ */
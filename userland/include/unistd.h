@@ -57,6 +57,18 @@
  *     fstat:    sys/stat.h
  *     lstat:    sys/stat.h
  *     mkdir:    sys/stat.h
+ *     mmap:     sys/mman.h
+ *     munmap:   sys/mman.h
+ *     msync:    sys/mman.h
+ *     readv:    sys/uio.h
+ *     writev:   sys/uio.h
+ *     preadv:   sys/uio.h
+ *     pwritev:  sys/uio.h
+ *     poll:     poll.h
+ *
+ * The __thread and __futex calls are the kernel side of the thread
+ * library; use thread_create, thread_join, and the mutex functions
+ * from thread.h instead.
  *
  * If this were standard Unix, more prototypes would go in other
  * header files as well, as follows:
@@ -141,13 +153,22 @@ int chdir(const char *path);
 
 /* Optional. */
 void *sbrk(__intptr_t change);
+pid_t vfork(void);
 ssize_t getdirentry(int filehandle, char *buf, size_t buflen);
 int symlink(const char *target, const char *linkname);
 ssize_t readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
+ssize_t splice(int fromhandle, int tohandle, size_t len);
+ssize_t pread(int filehandle, void *buf, size_t size, off_t pos);
+ssize_t pwrite(int filehandle, const void *buf, size_t size, off_t pos);
 int __time(time_t *seconds, unsigned long *nanoseconds);
 ssize_t __getcwd(char *buf, size_t buflen);
+int __thread_create(void (*entry)(void *), void *arg, void *stack);
+__DEAD void __thread_exit(void *value);
+int __thread_join(int tid, void **value);
+int __futex_wait(volatile int *addr, int val);
+int __futex_wake(volatile int *addr, int count);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
@@ -30,10 +30,12 @@
 /*
  * User-level malloc and free implementation.
  *
- * This is a basic first-fit allocator. It's intended to be simple and
- * easy to follow. It performs abysmally if the heap becomes larger than
- * physical memory. To get (much) better out-of-core performance, port
- * the kernel's malloc. :-)
+ * This is a segregated-fit allocator. Free blocks are kept on
+ * doubly-linked lists ("bins") sorted by size, so malloc only looks
+ * at blocks that are about the right size instead of walking the
+ * whole heap, and free is constant-time. Adjacent free blocks are
+ * still merged immediately using the boundary tags in the headers.
+ * See design/usermalloc.txt for more.
  */
 
 #include <stdlib.h>
@@ -147,12 +149,44 @@ static size_t __malloc_pagesize;
 #define PAGE_SIZE 4096
 #endif
 
+/*
+ * Free-list links. A free block keeps the links for its bin's list in
+ * its data area, which is always at least MBLOCKSIZE bytes and thus
+ * big enough for two pointers.
+ */
+struct mfree {
+	struct mheader *mf_next;
+	struct mheader *mf_prev;
+};
+
+#define M_FREE(mh)	((struct mfree *)M_DATA(mh))
+
+/*
+ * Bins.
+ *
+ * Small blocks (up to SMALLMAX bytes of data) get one bin per size, so
+ * any block in the right bin fits exactly. Larger blocks are binned by
+ * powers of two: bin NSMALLBINS holds sizes above SMALLMAX up to
+ * twice that, the next bin up to four times that, and so on, with the
+ * last bin taking everything bigger. A bitmap records which bins are
+ * nonempty so finding the next bin up with something in it doesn't
+ * require looking at each one.
+ */
+#define NSMALLBINS	32
+#define NBINS		64
+#define SMALLMAX	(NSMALLBINS * MBLOCKSIZE)
+#define BINMAPWORDS	(NBINS / 32)
+
 ////////////////////////////////////////////////////////////
 
 /*
- * Static variables - the bottom and top addresses of the heap.
+ * Static variables - the bottom and top addresses of the heap, the
+ * highest block in the heap (NULL if the heap is empty), and the bins.
  */
 static uintptr_t __heapbase, __heaptop;
+static struct mheader *__malloc_top;
+static struct mheader *__malloc_bins[NBINS];
+static uint32_t __malloc_binmap[BINMAPWORDS];
 
 /*
  * Setup function.
@@ -298,16 +332,136 @@ __malloc_sbrk(size_t size)
 	return x;
 }
 
+////////////////////////////////////////////////////////////
+
+/*
+ * Clear a range of memory with 0xdeadbeef.
+ * ptr must be suitably aligned.
+ */
+static
+void
+__malloc_deadbeef(void *ptr, size_t size)
+{
+	uint32_t *x = ptr;
+	size_t i, n = size/sizeof(uint32_t);
+	for (i=0; i<n; i++) {
+		x[i] = 0xdeadbeef;
+	}
+}
+
+/*
+ * Return the bin for a block of the given data size. size must be a
+ * nonzero multiple of MBLOCKSIZE.
+ */
+static
+unsigned
+__malloc_binof(size_t size)
+{
+	unsigned bin;
+
+	if (size <= SMALLMAX) {
+		return size / MBLOCKSIZE - 1;
+	}
+	bin = NSMALLBINS;
+	for (size /= 2*SMALLMAX; size > 0 && bin < NBINS-1; size /= 2) {
+		bin++;
+	}
+	return bin;
+}
+
+/*
+ * Return the lowest nonempty bin at or above BIN, or NBINS if there
+ * isn't one.
+ */
+static
+unsigned
+__malloc_nextbin(unsigned bin)
+{
+	unsigned word;
+	uint32_t bits;
+
+	for (word = bin/32; word < BINMAPWORDS; word++) {
+		bits = __malloc_binmap[word];
+		if (word == bin/32) {
+			bits &= ~(uint32_t)0 << (bin%32);
+		}
+		if (bits != 0) {
+			bin = word*32;
+			while ((bits & 1) == 0) {
+				bits >>= 1;
+				bin++;
+			}
+			return bin;
+		}
+	}
+	return NBINS;
+}
+
+/*
+ * Put a free block on the list for its bin.
+ */
+static
+void
+__malloc_binadd(struct mheader *mh)
+{
+	struct mfree *mf;
+	unsigned bin;
+
+	bin = __malloc_binof(M_SIZE(mh));
+	mf = M_FREE(mh);
+	mf->mf_prev = NULL;
+	mf->mf_next = __malloc_bins[bin];
+	if (mf->mf_next != NULL) {
+		M_FREE(mf->mf_next)->mf_prev = mh;
+	}
+	__malloc_bins[bin] = mh;
+	__malloc_binmap[bin/32] |= (uint32_t)1 << (bin%32);
+}
+
+/*
+ * Take a free block off its bin's list. This must be done before
+ * the block's size changes, since the size determines the bin.
+ */
+static
+void
+__malloc_binremove(struct mheader *mh)
+{
+	struct mfree *mf;
+	unsigned bin;
+
+	mf = M_FREE(mh);
+	if (mf->mf_prev != NULL) {
+		M_FREE(mf->mf_prev)->mf_next = mf->mf_next;
+	}
+	else {
+		bin = __malloc_binof(M_SIZE(mh));
+		if (__malloc_bins[bin] != mh) {
+			errx(1, "malloc: Heap corrupt; free block %p "
+			     "not on its list", M_DATA(mh));
+		}
+		__malloc_bins[bin] = mf->mf_next;
+		if (mf->mf_next == NULL) {
+			__malloc_binmap[bin/32] &= ~((uint32_t)1 << (bin%32));
+		}
+	}
+	if (mf->mf_next != NULL) {
+		M_FREE(mf->mf_next)->mf_prev = mf->mf_prev;
+	}
+}
+
+////////////////////////////////////////////////////////////
+
 /*
  * Make a new (free) block from the block passed in, leaving size
  * bytes for data in the current block. size must be a multiple of
- * MBLOCKSIZE.
+ * MBLOCKSIZE. Returns the new block, or NULL if there was no split;
+ * the new block is not put in a bin.
  *
  * Only split if the excess space is at least twice the blocksize -
  * one blocksize to hold a header and one for data.
  */
 static
-void
+struct mheader *
 __malloc_split(struct mheader *mh, size_t size)
 {
 	struct mheader *mhnext, *mhnew;
@@ -320,7 +474,7 @@ __malloc_split(struct mheader *mh, size_t size)
 
 	if (M_SIZE(mh) - size < 2*MBLOCKSIZE) {
 		/* no room */
-		return;
+		return NULL;
 	}
 
 	mhnext = M_NEXT(mh);
@@ -343,20 +497,77 @@ __malloc_split(struct mheader *mh, size_t size)
 	if (mhnext != (struct mheader *) __heaptop) {
 		mhnext->mh_prevblock = mhnew->mh_nextblock;
 	}
+	else {
+		__malloc_top = mhnew;
+	}
+	return mhnew;
 }
 
 /*
- * malloc itself.
+ * Expand the heap to get a free block with at least size bytes of
+ * data. If the top block is free it is grown (and taken out of its
+ * bin); otherwise a new block is made. The block returned is not in
+ * any bin.
  */
-void *
-malloc(size_t size)
+static
+struct mheader *
+__malloc_extend(size_t size)
 {
 	struct mheader *mh;
-	uintptr_t i;
-	size_t rightprevblock;
 	size_t morespace;
 	void *p;
 
+	mh = __malloc_top;
+	if (mh != NULL && !mh->mh_inuse) {
+		/*
+		 * It has to be too small, or it would have been found
+		 * in the bins.
+		 */
+		assert(size > M_SIZE(mh));
+		morespace = size - M_SIZE(mh);
+	}
+	else {
+		mh = NULL;
+		morespace = MBLOCKSIZE + size;
+	}
+
+	/* Round the amount of space we ask for up to a whole page. */
+	morespace = PAGE_SIZE * ((morespace + PAGE_SIZE - 1) / PAGE_SIZE);
+
+	p = __malloc_sbrk(morespace);
+	if (p == NULL) {
+		return NULL;
+	}
+
+	if (mh != NULL) {
+		/* update old header */
+		__malloc_binremove(mh);
+		mh->mh_nextblock = M_MKFIELD(M_NEXTOFF(mh) + morespace);
+	}
+	else {
+		/* fill out new header */
+		mh = p;
+		mh->mh_prevblock =
+			__malloc_top != NULL ? __malloc_top->mh_nextblock : 0;
+		mh->mh_magic1 = MMAGIC;
+		mh->mh_magic2 = MMAGIC;
+		mh->mh_pad = 0;
+		mh->mh_inuse = 0;
+		mh->mh_nextblock = M_MKFIELD(morespace);
+		__malloc_top = mh;
+	}
+	return mh;
+}
+
+/*
+ * malloc itself.
+ */
+void *
+malloc(size_t size)
+{
+	struct mheader *mh, *mhrest;
+	unsigned bin;
+
 	if (__heapbase==0) {
 		__malloc_init();
 	}
@@ -372,105 +583,71 @@ malloc(size_t size)
 	__malloc_dump();
 #endif
 
-	/* Round size up to an integral number of blocks. */
+	/* Requests this big can't be satisfied; don't overflow below. */
+	if (size > (size_t)-1 - PAGE_SIZE - 2*MBLOCKSIZE) {
+		return NULL;
+	}
+
+	/*
+	 * Round size up to an integral number of blocks. Every block
+	 * needs room for the free-list links, so use at least one.
+	 */
 	size = ((size + MBLOCKSIZE - 1) & ~(size_t)(MBLOCKSIZE-1));
+	if (size == 0) {
+		size = MBLOCKSIZE;
+	}
 
 	/*
-	 * First-fit search algorithm for available blocks.
-	 * Check to make sure the next/previous sizes all agree.
+	 * Small bins hold blocks of exactly one size, so the head of
+	 * the request's bin fits if there is one. Large bins hold a
+	 * range of sizes, so search the request's own bin first-fit.
+	 * Failing that, any block in a higher bin is big enough.
 	 */
-	rightprevblock = 0;
 	mh = NULL;
-	for (i=__heapbase; i<__heaptop; i += M_NEXTOFF(mh)) {
-		mh = (struct mheader *) i;
-		if (!M_OK(mh)) {
-			errx(1, "malloc: Heap corrupt; header at 0x%lx"
-			     " has bad magic bits",
-			     (unsigned long) i);
+	bin = __malloc_binof(size);
+	if (bin >= NSMALLBINS) {
+		for (mh = __malloc_bins[bin]; mh != NULL;
+		     mh = M_FREE(mh)->mf_next) {
+			if (M_SIZE(mh) >= size) {
+				break;
+			}
 		}
-		if (mh->mh_prevblock != rightprevblock) {
-			errx(1, "malloc: Heap corrupt; header at 0x%lx"
-			     " has bad previous-block size %lu "
-			     "(should be %lu)",
-			     (unsigned long) i,
-			     (unsigned long) mh->mh_prevblock << MBLOCKSHIFT,
-			     (unsigned long) rightprevblock << MBLOCKSHIFT);
+		if (mh == NULL) {
+			bin++;
 		}
-		rightprevblock = mh->mh_nextblock;
-
-		/* Can't allocate a block that's in use. */
-		if (mh->mh_inuse) {
-			continue;
+	}
+	if (mh == NULL && bin < NBINS) {
+		bin = __malloc_nextbin(bin);
+		if (bin < NBINS) {
+			mh = __malloc_bins[bin];
 		}
+	}
 
-		/* Can't allocate a block that isn't big enough. */
-		if (M_SIZE(mh) < size) {
-			continue;
+	if (mh != NULL) {
+		if (!M_OK(mh) || mh->mh_inuse) {
+			errx(1, "malloc: Heap corrupt; bad free block "
+			     "header at %p", mh);
 		}
-
-		/* Try splitting block. */
-		__malloc_split(mh, size);
-
-		/*
-		 * Now, allocate.
-		 */
-		mh->mh_inuse = 1;
-
-#ifdef MALLOCDEBUG
-		warnx("malloc: allocating at %p", M_DATA(mh));
-		__malloc_dump();
-#endif
-		return M_DATA(mh);
+		__malloc_binremove(mh);
 	}
-	if (i!=__heaptop) {
-		errx(1, "malloc: Heap corrupt; ran off end");
+	else {
+		/* Didn't find anything. Expand the heap. */
+		mh = __malloc_extend(size);
+		if (mh == NULL) {
+			return NULL;
+		}
 	}
 
 	/*
-	 * Didn't find anything. Expand the heap.
-	 *
-	 * If the heap is nonempty and the top block (the one mh is
-	 * left pointing to after the above loop) is free, we can
-	 * expand it. Otherwise we need a new block.
+	 * Split off whatever we don't need, which after page rounding
+	 * in __malloc_extend might be quite a bit, and bin it.
 	 */
-	if (mh != NULL && !mh->mh_inuse) {
-		assert(size > M_SIZE(mh));
-		morespace = size - M_SIZE(mh);
-	}
-	else {
-		morespace = MBLOCKSIZE + size;
+	mhrest = __malloc_split(mh, size);
+	if (mhrest != NULL) {
+		__malloc_binadd(mhrest);
 	}
 
-	/* Round the amount of space we ask for up to a whole page. */
-	morespace = PAGE_SIZE * ((morespace + PAGE_SIZE - 1) / PAGE_SIZE);
-
-	p = __malloc_sbrk(morespace);
-	if (p == NULL) {
-		return NULL;
-	}
-
-	if (mh != NULL && !mh->mh_inuse) {
-		/* update old header */
-		mh->mh_nextblock = M_MKFIELD(M_NEXTOFF(mh) + morespace);
-		mh->mh_inuse = 1;
-	}
-	else {
-		/* fill out new header */
-		mh = p;
-		mh->mh_prevblock = rightprevblock;
-		mh->mh_magic1 = MMAGIC;
-		mh->mh_magic2 = MMAGIC;
-		mh->mh_pad = 0;
-		mh->mh_inuse = 1;
-		mh->mh_nextblock = M_MKFIELD(morespace);
-	}
-
-	/*
-	 * Either way, try splitting the block we got as because of
-	 * the page rounding it might be quite a bit bigger than we
-	 * needed.
-	 */
-	__malloc_split(mh, size);
+	mh->mh_inuse = 1;
 
 #ifdef MALLOCDEBUG
 	warnx("malloc: allocating at %p", M_DATA(mh));
@@ -482,26 +659,12 @@ malloc(size_t size)
 ////////////////////////////////////////////////////////////
 
 /*
- * Clear a range of memory with 0xdeadbeef.
- * ptr must be suitably aligned.
+ * Merge two adjacent free blocks (mh below mhnext). Neither may be
+ * in a bin.
  */
 static
 void
-__malloc_deadbeef(void *ptr, size_t size)
-{
-	uint32_t *x = ptr;
-	size_t i, n = size/sizeof(uint32_t);
-	for (i=0; i<n; i++) {
-		x[i] = 0xdeadbeef;
-	}
-}
-
-/*
- * Attempt to merge two adjacent blocks (mh below mhnext).
- */
-static
-void
-__malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
+__malloc_merge(struct mheader *mh, struct mheader *mhnext)
 {
 	struct mheader *mhnextnext;
 
@@ -509,10 +672,6 @@ __malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
 		errx(1, "free: Heap corrupt (%p and %p inconsistent)",
 		     mh, mhnext);
 	}
-	if (mh->mh_inuse || mhnext->mh_inuse) {
-		/* can't merge */
-		return;
-	}
 
 	mhnextnext = M_NEXT(mhnext);
 
@@ -522,6 +681,9 @@ __malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
 	if (mhnextnext != (struct mheader *)__heaptop) {
 		mhnextnext->mh_prevblock = mh->mh_nextblock;
 	}
+	else {
+		__malloc_top = mh;
+	}
 
 	/* Deadbeef out the memory used by the now-obsolete header */
 	__malloc_deadbeef(mhnext, sizeof(struct mheader));
@@ -569,21 +731,34 @@ free(void *x)
 	/* mark it free */
 	mh->mh_inuse = 0;
 
+#ifdef MALLOCDEBUG
 	/* wipe it */
 	__malloc_deadbeef(M_DATA(mh), M_SIZE(mh));
+#endif
 
-	/* Try merging with the block above (but not if we're at the top) */
+	/* Merge with the block above if it's free (and we're not the top) */
 	mhnext = M_NEXT(mh);
-	if (mhnext != (struct mheader *)__heaptop) {
-		__malloc_trymerge(mh, mhnext);
+	if (mhnext != (struct mheader *)__heaptop && !mhnext->mh_inuse) {
+		__malloc_binremove(mhnext);
+		__malloc_merge(mh, mhnext);
 	}
 
-	/* Try merging with the block below (but not if we're at the bottom) */
+	/* Merge with the block below if it's free (and we're not the bottom) */
 	if (mh != (struct mheader *)__heapbase) {
 		mhprev = M_PREV(mh);
-		__malloc_trymerge(mhprev, mh);
+		if (!M_OK(mhprev)) {
+			errx(1, "free: Heap corrupt; bad header at %p "
+			     "below %p", mhprev, x);
+		}
+		if (!mhprev->mh_inuse) {
+			__malloc_binremove(mhprev);
+			__malloc_merge(mhprev, mh);
+			mh = mhprev;
+		}
 	}
 
+	__malloc_binadd(mh);
+
 #ifdef MALLOCDEBUG
 	warnx("free: freed %p", x);
 	__malloc_dump();
@@ -74,7 +74,12 @@ system(const char *cmd)
 
 	argv[nargs] = NULL;
 
-	pid = fork();
+	/*
+	 * The child only execs, so borrow our address space instead
+	 * of copying it; it must not do anything else before exec
+	 * or _exit.
+	 */
+	pid = vfork();
 	switch (pid) {
 	    case -1:
 		return -1;
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <thread.h>
+
+/*
+ * User threads, on top of the __thread_* system calls.
+ *
+ * Each thread gets a stack of its own from mmap. The threadinfo goes
+ * at the top of it, and the thread starts below that in threadstart,
+ * which calls the function and hands the threadinfo to __thread_exit;
+ * thread_join gets it back from __thread_join, picks up the return
+ * value, and unmaps the stack.
+ *
+ * The mutexes are the three-state futex lock from Drepper's
+ * "Futexes Are Tricky": 0 is free, 1 is locked, and 2 is locked and
+ * maybe wanted by someone asleep in __futex_wait. Unlock calls
+ * __futex_wake only in state 2.
+ */
+
+#define THREADSTACK	(64*1024)
+
+/* Mutex states */
+#define MX_FREE		0
+#define MX_LOCKED	1
+#define MX_WAITERS	2
+
+/* Space the MIPS calling convention has a function's caller leave. */
+#define ARGSAVE		16
+
+struct threadinfo {
+	void *(*ti_func)(void *);
+	void *ti_arg;
+	void *ti_ret;
+	void *ti_stack;
+};
+
+static
+void
+threadstart(void *data)
+{
+	struct threadinfo *ti = data;
+
+	ti->ti_ret = ti->ti_func(ti->ti_arg);
+	__thread_exit(ti);
+}
+
+int
+thread_create(int *tid, void *(*func)(void *), void *arg)
+{
+	struct threadinfo *ti;
+	char *stack;
+	int result, err;
+
+	stack = mmap(NULL, THREADSTACK, PROT_READ|PROT_WRITE,
+		     MAP_PRIVATE|MAP_ANON, -1, 0);
+	if (stack == MAP_FAILED) {
+		return -1;
+	}
+
+	ti = (struct threadinfo *)(stack + THREADSTACK) - 1;
+	ti->ti_func = func;
+	ti->ti_arg = arg;
+	ti->ti_ret = NULL;
+	ti->ti_stack = stack;
+
+	result = __thread_create(threadstart, ti, (char *)ti - ARGSAVE);
+	if (result < 0) {
+		err = errno;
+		munmap(stack, THREADSTACK);
+		errno = err;
+		return -1;
+	}
+	*tid = result;
+	return 0;
+}
+
+int
+thread_join(int tid, void **ret)
+{
+	struct threadinfo *ti;
+	void *value;
+
+	if (__thread_join(tid, &value) < 0) {
+		return -1;
+	}
+	ti = value;
+	if (ret != NULL) {
+		*ret = ti->ti_ret;
+	}
+	munmap(ti->ti_stack, THREADSTACK);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// mutexes
+
+/*
+ * Atomic compare-and-swap: if *P is OLD, make it NEW. Either way,
+ * return what *P was. Uses LL/SC, like the kernel's spinlocks, and
+ * SYNC so it's also a memory barrier.
+ */
+static
+int
+atomic_cas(volatile int *p, int old, int new)
+{
+	int x, y;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set reorder;"		/* let the assembler fill delay slots */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   x = *p */
+		"bne %0, %3, 2f;"	/*   if (x != old) give up */
+		"move %1, %4;"		/*   y = new */
+		"sc %1, 0(%2);"		/*   *p = y; y = success? */
+		"beqz %1, 1b;"		/*   if it failed, try again */
+		"2: sync;"		/*   memory barrier */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (x), "=&r" (y)
+		: "r" (p), "r" (old), "r" (new)
+		: "memory");
+	return x;
+}
+
+/*
+ * Atomic swap: make *P NEW and return what it was.
+ */
+static
+int
+atomic_swap(volatile int *p, int new)
+{
+	int x, y;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set reorder;"		/* let the assembler fill delay slots */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   x = *p */
+		"move %1, %3;"		/*   y = new */
+		"sc %1, 0(%2);"		/*   *p = y; y = success? */
+		"beqz %1, 1b;"		/*   if it failed, try again */
+		"sync;"			/*   memory barrier */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (x), "=&r" (y)
+		: "r" (p), "r" (new)
+		: "memory");
+	return x;
+}
+
+void
+mutex_init(struct mutex *mx)
+{
+	mx->mx_state = MX_FREE;
+}
+
+void
+mutex_lock(struct mutex *mx)
+{
+	int c;
+
+	c = atomic_cas(&mx->mx_state, MX_FREE, MX_LOCKED);
+	if (c == MX_FREE) {
+		return;
+	}
+
+	/*
+	 * Mark it wanted and sleep until it's free. Once we've slept
+	 * we can't know whether anyone else is still waiting, so when
+	 * we do get it, it stays marked.
+	 */
+	if (c != MX_WAITERS) {
+		c = atomic_swap(&mx->mx_state, MX_WAITERS);
+	}
+	while (c != MX_FREE) {
+		/* Fails at once if the state changed; that's fine. */
+		__futex_wait(&mx->mx_state, MX_WAITERS);
+		c = atomic_swap(&mx->mx_state, MX_WAITERS);
+	}
+}
+
+int
+mutex_trylock(struct mutex *mx)
+{
+	if (atomic_cas(&mx->mx_state, MX_FREE, MX_LOCKED) != MX_FREE) {
+		return -1;
+	}
+	return 0;
+}
+
+void
+mutex_unlock(struct mutex *mx)
+{
+	if (atomic_swap(&mx->mx_state, MX_FREE) == MX_WAITERS) {
+		__futex_wake(&mx->mx_state, 1);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * bench.c
+ *
+ * 	Timing support for benchmark programs.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <err.h>
+#include <test/bench.h>
+
+void
+bench_start(struct benchtime *t)
+{
+	if (__time(&t->bt_secs, &t->bt_nsecs) < 0) {
+		err(1, "__time");
+	}
+}
+
+unsigned long
+bench_usecs(const struct benchtime *t)
+{
+	struct benchtime now;
+	time_t secs;
+	unsigned long nsecs;
+
+	bench_start(&now);
+	secs = now.bt_secs - t->bt_secs;
+	if (now.bt_nsecs < t->bt_nsecs) {
+		nsecs = now.bt_nsecs + 1000000000 - t->bt_nsecs;
+		secs--;
+	}
+	else {
+		nsecs = now.bt_nsecs - t->bt_nsecs;
+	}
+	return (unsigned long)secs * 1000000 + nsecs / 1000;
+}
+
+void
+bench_report(const char *label, unsigned count, unsigned long usecs)
+{
+	printf("%s: %u iterations in %lu.%06lu s, %lu us each\n",
+	       label, count, usecs / 1000000, usecs % 1000000,
+	       count > 0 ? usecs / count : 0);
+}
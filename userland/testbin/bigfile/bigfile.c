@@ -42,7 +42,7 @@
 #include <unistd.h>
 #include <err.h>
 
-static char buffer[8192 + 1];
+static char buffer[65536 + 1];
 
 int
 main(int argc, char *argv[])
@@ -52,6 +52,8 @@ main(int argc, char *argv[])
 	size_t i, size, chunksize, offset;
 	ssize_t len;
 	int fd;
+	time_t secs1, secs2;
+	unsigned long nsecs1, nsecs2, msecs;
 
 	if (argc != 3) {
 		warnx("Usage: bigfile <filename> <size>");
@@ -86,6 +88,8 @@ main(int argc, char *argv[])
 		err(1, "%s: create", filename);
 	}
 
+	__time(&secs1, &nsecs1);
+
 	i=0;
 	while (i<size) {
 		snprintf(buffer, sizeof(buffer), "%d\n", i);
@@ -103,5 +107,14 @@ main(int argc, char *argv[])
 
 	close(fd);
 
+	__time(&secs2, &nsecs2);
+	if (nsecs2 < nsecs1) {
+		nsecs2 += 1000000000;
+		secs2--;
+	}
+	msecs = (secs2 - secs1) * 1000 + (nsecs2 - nsecs1) / 1000000;
+	printf("Wrote %d bytes in %lu.%03lu seconds\n",
+	       size, msecs / 1000, msecs % 1000);
+
 	return 0;
 }
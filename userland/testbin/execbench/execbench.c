@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * execbench - exec latency against argument size.
+ *
+ * Times vfork + execv + waitpid of this program with argument blocks
+ * of several sizes, up to nearly ARG_MAX. The child just exits, so
+ * what grows with the size is the cost of getting the arguments
+ * through the kernel and onto the new stack.
+ *
+ * Usage: execbench [-n iterations]
+ *    (execbench -x is the child; it exits at once.)
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define PROG		"/testbin/execbench"
+#define DEFAULT_ITERS	50
+#define ARGLEN		1023		/* each argument, without the NUL */
+#define MAXARGS		(ARG_MAX / (ARGLEN + 1 + sizeof(char *)))
+
+static char argstr[ARGLEN + 1];
+static char *args[MAXARGS + 3];
+
+static
+void
+execloop(unsigned nargs, unsigned iters)
+{
+	struct benchtime start;
+	char label[64];
+	volatile unsigned i;	/* live across vfork */
+	pid_t pid;
+	int status;
+
+	args[0] = (char *)PROG;
+	args[1] = (char *)"-x";
+	for (i=0; i<nargs; i++) {
+		args[i+2] = argstr;
+	}
+	args[nargs+2] = NULL;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		pid = vfork();
+		if (pid < 0) {
+			err(1, "vfork");
+		}
+		if (pid == 0) {
+			execv(PROG, args);
+			_exit(255);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "exec with %u arguments failed", nargs);
+		}
+	}
+	snprintf(label, sizeof(label), "exec, %uK of arguments",
+		 nargs * (ARGLEN + 1) / 1024);
+	bench_report(label, iters, bench_usecs(&start));
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS;
+	unsigned nargs;
+	int i;
+
+	if (argc > 1 && !strcmp(argv[1], "-x")) {
+		return 0;
+	}
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else {
+			errx(1, "Usage: execbench [-n iterations]");
+		}
+	}
+
+	memset(argstr, 'a', ARGLEN);
+	argstr[ARGLEN] = 0;
+
+	for (nargs = 0; nargs < MAXARGS; nargs = nargs ? nargs * 4 : 1) {
+		execloop(nargs, iters);
+	}
+	/* As many as fit with the program name and -x. */
+	execloop(MAXARGS - 1, iters);
+	return 0;
+}
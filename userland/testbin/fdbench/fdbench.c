@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * fdbench - file descriptor system call benchmark.
+ *
+ * Times the cheapest calls that go through the file table: lseek,
+ * small reads and writes on null: and on a file, and dup2/close
+ * pairs. These are mostly descriptor lookup and system call entry,
+ * so they show what that path costs.
+ *
+ * Usage: fdbench [-n iterations] [-f filename]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFAULT_ITERS	10000
+#define CHUNK		512
+
+static char buf[CHUNK];
+
+static
+void
+lseekloop(int fd, unsigned iters)
+{
+	struct benchtime start;
+	unsigned i;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		if (lseek(fd, 0, SEEK_SET) != 0) {
+			err(1, "lseek");
+		}
+	}
+	bench_report("lseek", iters, bench_usecs(&start));
+}
+
+static
+void
+rwloop(const char *label, int fd, size_t len, int reading, int rewind,
+       unsigned iters)
+{
+	struct benchtime start;
+	unsigned i;
+	ssize_t r;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		if (rewind && lseek(fd, 0, SEEK_SET) < 0) {
+			err(1, "%s: lseek", label);
+		}
+		r = reading ? read(fd, buf, len) : write(fd, buf, len);
+		if (r < 0) {
+			err(1, "%s", label);
+		}
+	}
+	bench_report(label, iters, bench_usecs(&start));
+}
+
+static
+void
+duploop(int fd, unsigned iters)
+{
+	struct benchtime start;
+	unsigned i;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		if (dup2(fd, 10) != 10) {
+			err(1, "dup2");
+		}
+		if (close(10) < 0) {
+			err(1, "close");
+		}
+	}
+	bench_report("dup2+close", iters, bench_usecs(&start));
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *filename = "fdbenchfile";
+	unsigned iters = DEFAULT_ITERS;
+	int i, nullfd, fd;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-f") && i+1 < argc) {
+			filename = argv[++i];
+		}
+		else {
+			errx(1, "Usage: fdbench [-n iterations] [-f filename]");
+		}
+	}
+
+	nullfd = open("null:", O_RDWR);
+	if (nullfd < 0) {
+		err(1, "null:");
+	}
+	fd = open(filename, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", filename);
+	}
+	memset(buf, 'x', sizeof(buf));
+	if (write(fd, buf, CHUNK) != CHUNK) {
+		err(1, "%s: write", filename);
+	}
+
+	lseekloop(fd, iters);
+	rwloop("read 1 byte, null:", nullfd, 1, 1, 0, iters);
+	rwloop("write 1 byte, null:", nullfd, 1, 0, 0, iters);
+	rwloop("lseek+read 512, file", fd, CHUNK, 1, 1, iters);
+	rwloop("lseek+write 512, file", fd, CHUNK, 0, 1, iters);
+	duploop(fd, iters);
+
+	close(fd);
+	close(nullfd);
+	remove(filename);
+	return 0;
+}
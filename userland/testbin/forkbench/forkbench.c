@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * forkbench - fork latency benchmark.
+ *
+ * Times fork+exit+waitpid from a small parent, then touches every
+ * page of a large array and times it again from the now large
+ * parent. With copy-on-write fork the two should be close; with
+ * eager copying the second is proportional to the array size.
+ *
+ * Usage: forkbench [-n iterations] [-w]
+ *    -w makes each child write every page of the array before
+ *       exiting, to measure the cost of breaking copy-on-write.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define PAGESIZE	4096
+#define BIGPAGES	512		/* 2M */
+#define DEFAULT_ITERS	50
+
+static char big[BIGPAGES * PAGESIZE];
+static int childwrites;
+
+static
+void
+touchbig(char val)
+{
+	unsigned i;
+
+	for (i=0; i<BIGPAGES; i++) {
+		big[i * PAGESIZE] = val;
+	}
+}
+
+static
+void
+forkloop(const char *label, unsigned iters)
+{
+	struct benchtime start;
+	unsigned i;
+	pid_t pid;
+	int status;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			if (childwrites) {
+				touchbig(2);
+			}
+			_exit(0);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "child %d failed", pid);
+		}
+	}
+	bench_report(label, iters, bench_usecs(&start));
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS;
+	int i;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-w")) {
+			childwrites = 1;
+		}
+		else {
+			errx(1, "Usage: forkbench [-n iterations] [-w]");
+		}
+	}
+
+	forkloop("fork, small parent", iters);
+	touchbig(1);
+	forkloop("fork, 2M parent", iters);
+	return 0;
+}
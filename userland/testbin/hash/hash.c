@@ -36,8 +36,14 @@
  * testing your file system code.
  *
  * This should really be replaced with a real hash, like MD5 or SHA-1.
+ *
+ * The file is mapped with mmap if possible, and read a byte at a time
+ * if not.
  */
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -54,6 +60,9 @@ main(int argc, char *argv[])
 {
 	int fd;
 	char readbuf[1];
+	struct stat st;
+	char *p;
+	off_t i;
 	int j = 0;
 
 #ifdef HOST
@@ -70,9 +79,21 @@ main(int argc, char *argv[])
 		err(1, "%s", argv[1]);
 	}
 
-	for (;;) {
-		if (read(fd, readbuf, 1) <= 0) break;
-		j = ((j*8) + (int) readbuf[0]) % HASHP;
+	p = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	if (p != MAP_FAILED) {
+		for (i=0; i<st.st_size; i++) {
+			j = ((j*8) + (int) p[i]) % HASHP;
+		}
+		munmap(p, st.st_size);
+	}
+	else {
+		for (;;) {
+			if (read(fd, readbuf, 1) <= 0) break;
+			j = ((j*8) + (int) readbuf[0]) % HASHP;
+		}
 	}
 
 	close(fd);
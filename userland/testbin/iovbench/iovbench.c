@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * iovbench - vectored I/O benchmark.
+ *
+ * Writes and then reads back a file of fixed-size records, each a
+ * small header and a body kept in separate arrays, as a program with
+ * record structures would. It does it three ways: with a write or
+ * read for each header and each body, with one writev or readv per
+ * record, and with writev/readv (or pwritev/preadv) on BATCH records
+ * at a time. Each line reports the number of system calls made, which
+ * "syscallstat" in the kernel menu should agree with.
+ *
+ * Usage: iovbench [-n records] [-f filename]
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFAULT_RECS	2048
+#define MAXRECS		8192
+#define HDRSIZE		16
+#define BODYSIZE	112
+#define BATCH		64		/* records per vectored call */
+
+static char hdrs[MAXRECS][HDRSIZE];
+static char bodies[MAXRECS][BODYSIZE];
+static struct iovec iov[2 * BATCH];
+
+enum iomode { IO_PLAIN, IO_RECORD, IO_BATCH, IO_BATCHPOS };
+
+static
+void
+fillrecords(unsigned nrecs)
+{
+	unsigned i;
+
+	for (i=0; i<nrecs; i++) {
+		memset(hdrs[i], 'A' + i % 26, HDRSIZE);
+		memset(bodies[i], 'a' + i % 26, BODYSIZE);
+	}
+}
+
+/*
+ * Point iov at COUNT records starting at FIRST, header then body for
+ * each. Returns the number of iovecs.
+ */
+static
+int
+setiov(unsigned first, unsigned count)
+{
+	unsigned i;
+
+	for (i=0; i<count; i++) {
+		iov[2*i].iov_base = hdrs[first + i];
+		iov[2*i].iov_len = HDRSIZE;
+		iov[2*i+1].iov_base = bodies[first + i];
+		iov[2*i+1].iov_len = BODYSIZE;
+	}
+	return 2 * count;
+}
+
+static
+void
+checkio(const char *what, ssize_t r, size_t len)
+{
+	if (r < 0) {
+		err(1, "%s", what);
+	}
+	if ((size_t)r != len) {
+		errx(1, "%s: short count", what);
+	}
+}
+
+/*
+ * Move NRECS records to or from FD using MODE. Returns the number of
+ * system calls it took.
+ */
+static
+unsigned
+transfer(int fd, unsigned nrecs, enum iomode mode, int writing)
+{
+	unsigned i, count, calls = 0;
+	int n;
+	ssize_t r;
+
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+		err(1, "lseek");
+	}
+	for (i=0; i<nrecs; i += count) {
+		count = 1;
+		switch (mode) {
+		    case IO_PLAIN:
+			r = writing ? write(fd, hdrs[i], HDRSIZE) :
+				read(fd, hdrs[i], HDRSIZE);
+			checkio("header", r, HDRSIZE);
+			r = writing ? write(fd, bodies[i], BODYSIZE) :
+				read(fd, bodies[i], BODYSIZE);
+			checkio("body", r, BODYSIZE);
+			calls += 2;
+			continue;
+		    case IO_RECORD:
+			break;
+		    case IO_BATCH:
+		    case IO_BATCHPOS:
+			count = nrecs - i < BATCH ? nrecs - i : BATCH;
+			break;
+		}
+		n = setiov(i, count);
+		if (mode == IO_BATCHPOS) {
+			off_t pos = (off_t)i * (HDRSIZE + BODYSIZE);
+
+			r = writing ? pwritev(fd, iov, n, pos) :
+				preadv(fd, iov, n, pos);
+		}
+		else {
+			r = writing ? writev(fd, iov, n) : readv(fd, iov, n);
+		}
+		checkio(writing ? "writev" : "readv", r,
+			count * (HDRSIZE + BODYSIZE));
+		calls++;
+	}
+	return calls;
+}
+
+static
+void
+runmode(const char *label, int fd, unsigned nrecs, enum iomode mode)
+{
+	struct benchtime start;
+	char buf[80];
+	unsigned calls;
+
+	bench_start(&start);
+	calls = transfer(fd, nrecs, mode, 1);
+	snprintf(buf, sizeof(buf), "write, %s (%u calls)", label, calls);
+	bench_report(buf, nrecs, bench_usecs(&start));
+
+	memset(hdrs, 0, sizeof(hdrs));
+	memset(bodies, 0, sizeof(bodies));
+
+	bench_start(&start);
+	calls = transfer(fd, nrecs, mode, 0);
+	snprintf(buf, sizeof(buf), "read, %s (%u calls)", label, calls);
+	bench_report(buf, nrecs, bench_usecs(&start));
+
+	if (hdrs[nrecs-1][0] != (char)('A' + (nrecs-1) % 26) ||
+	    bodies[nrecs-1][BODYSIZE-1] != (char)('a' + (nrecs-1) % 26)) {
+		errx(1, "%s: read back the wrong data", label);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *filename = "iovbenchfile";
+	unsigned nrecs = DEFAULT_RECS;
+	int i, fd;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			nrecs = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-f") && i+1 < argc) {
+			filename = argv[++i];
+		}
+		else {
+			errx(1, "Usage: iovbench [-n records] [-f filename]");
+		}
+	}
+	if (nrecs < 1 || nrecs > MAXRECS) {
+		errx(1, "Records must be between 1 and %d", MAXRECS);
+	}
+
+	fd = open(filename, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", filename);
+	}
+
+	fillrecords(nrecs);
+	runmode("read/write per field", fd, nrecs, IO_PLAIN);
+	runmode("readv/writev per record", fd, nrecs, IO_RECORD);
+	runmode("readv/writev per 64 records", fd, nrecs, IO_BATCH);
+	runmode("preadv/pwritev per 64 records", fd, nrecs, IO_BATCHPOS);
+
+	close(fd);
+	remove(filename);
+	return 0;
+}
@@ -36,9 +36,9 @@
  * These tests (subject to restrictions and limitations noted below)
  * should work once the kernel provides sbrk().
  *
- * Note that because the userlevel malloc is extremely dumb,
- * malloctest 3 is extremely slow and on most VM systems will run more
- * or less forever.
+ * Note that malloctest 3 allocates every page the VM system will give
+ * it one small block at a time, so on most VM systems it will run for
+ * a long time.
  */
 
 #include <stdint.h>
@@ -629,6 +629,101 @@ test7(void)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Test 8
+ *
+ * Times malloc and free with many blocks live at once. With a
+ * first-fit allocator that walks the whole heap, each call costs time
+ * proportional to the number of blocks; with bins it should not.
+ */
+
+#define T8_NBLOCKS   4096
+#define T8_ROUNDS    16
+
+static
+void
+test8(void)
+{
+	static void *ptrs[T8_NBLOCKS];
+	static const int sizes[8] = { 8, 24, 40, 72, 136, 264, 520, 1032 };
+	time_t secs1, secs2;
+	unsigned long nsecs1, nsecs2, usecs;
+	unsigned long ops = 0;
+	int i, r, failed = 0;
+
+	printf("Beginning malloc test 8\n");
+
+	srandom(0);
+	for (i=0; i<T8_NBLOCKS; i++) {
+		ptrs[i] = NULL;
+	}
+
+	__time(&secs1, &nsecs1);
+
+	/* Fill the heap with live blocks. */
+	for (i=0; i<T8_NBLOCKS; i++) {
+		ptrs[i] = malloc(sizes[i%8]);
+		if (ptrs[i] == NULL) {
+			printf("malloc %d failed\n", sizes[i%8]);
+			failed = 1;
+			goto out;
+		}
+		ops++;
+	}
+
+	/*
+	 * Then repeatedly free a random half of them and reallocate,
+	 * so there are lots of holes of assorted sizes.
+	 */
+	for (r=0; r<T8_ROUNDS; r++) {
+		for (i=0; i<T8_NBLOCKS; i++) {
+			if (random() % 2) {
+				free(ptrs[i]);
+				ptrs[i] = NULL;
+				ops++;
+			}
+		}
+		for (i=0; i<T8_NBLOCKS; i++) {
+			if (ptrs[i] == NULL) {
+				ptrs[i] = malloc(sizes[random()%8]);
+				if (ptrs[i] == NULL) {
+					printf("malloc failed in round %d\n", r);
+					failed = 1;
+					goto out;
+				}
+				ops++;
+			}
+		}
+		printf(".");
+	}
+	printf("\n");
+
+ out:
+	__time(&secs2, &nsecs2);
+
+	for (i=0; i<T8_NBLOCKS; i++) {
+		free(ptrs[i]);
+	}
+
+	if (failed) {
+		printf("FAILED malloc test 8\n");
+		return;
+	}
+
+	if (nsecs2 < nsecs1) {
+		nsecs2 += 1000000000;
+		secs2--;
+	}
+	usecs = (secs2 - secs1) * 1000000 + (nsecs2 - nsecs1) / 1000;
+	printf("%lu operations in %lu.%06lu seconds", ops,
+	       usecs / 1000000, usecs % 1000000);
+	/* ops is at least T8_NBLOCKS here; microseconds per 1000 = ns */
+	printf(" (%lu ns each)\n", usecs / (ops / 1000));
+	printf("Passed malloc test 8\n");
+}
+
+////////////////////////////////////////////////////////////
+
 static struct {
 	int num;
 	const char *desc;
@@ -641,6 +736,7 @@ static struct {
 	{ 5, "Stress test", test5 },
 	{ 6, "Randomized stress test", test6 },
 	{ 7, "Stress test with particular seed", test7 },
+	{ 8, "Many-block benchmark", test8 },
 	{ -1, NULL, NULL }
 };
 
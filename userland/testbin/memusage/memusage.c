@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * memusage - check the memory figures getrusage reports.
+ *
+ * Usage: memusage [npages]
+ *
+ * Touches NPAGES (default 256) pages of bss and checks that the
+ * resident set grew and that there was a fault (or a page mapped
+ * ahead) for each page, printing what getrusage reports before and
+ * after. Run it with a small RAM to see
+ * the swap figures move too.
+ */
+
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+
+#define MU_PAGESIZE	4096
+#define MU_MAXPAGES	1024
+
+static char pages[MU_MAXPAGES][MU_PAGESIZE];
+
+static
+void
+getusage(struct rusage *ru)
+{
+	if (getrusage(RUSAGE_SELF, ru) < 0) {
+		err(1, "getrusage");
+	}
+}
+
+static
+void
+printusage(const struct rusage *ru)
+{
+	printf("  rss %u K, max rss %u K\n",
+	       (unsigned)ru->ru_rss, (unsigned)ru->ru_maxrss);
+	printf("  %llu minor faults, %llu major faults\n",
+	       ru->ru_minflt, ru->ru_majflt);
+	printf("  %llu pages copied on write, %llu swapped in, "
+	       "%llu mapped ahead\n",
+	       ru->ru_ncow, ru->ru_nswapin, ru->ru_nprefault);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct rusage before, after;
+	unsigned npages, i;
+
+	npages = 256;
+	if (argc > 1) {
+		npages = atoi(argv[1]);
+	}
+	if (npages == 0 || npages > MU_MAXPAGES) {
+		errx(1, "npages must be from 1 to %u", MU_MAXPAGES);
+	}
+
+	if (getrusage(RUSAGE_SELF + 42, &before) == 0 || errno != EINVAL) {
+		errx(1, "getrusage with a bad who code didn't fail with EINVAL");
+	}
+	if (getrusage(RUSAGE_CHILDREN, &before) < 0) {
+		err(1, "getrusage RUSAGE_CHILDREN");
+	}
+
+	getusage(&before);
+	printf("Before touching %u pages:\n", npages);
+	printusage(&before);
+
+	for (i=0; i<npages; i++) {
+		pages[i][0] = i;
+	}
+
+	getusage(&after);
+	printf("After:\n");
+	printusage(&after);
+
+	/* Some may have been paged out again, so rss needn't show them all. */
+	if (after.ru_maxrss <= before.ru_maxrss) {
+		errx(1, "max rss didn't grow");
+	}
+	if (after.ru_maxrss < after.ru_rss) {
+		errx(1, "max rss is below rss");
+	}
+	if (after.ru_minflt + after.ru_majflt + after.ru_nprefault <
+	    before.ru_minflt + before.ru_majflt + before.ru_nprefault
+	    + npages) {
+		errx(1, "fewer faults than pages touched");
+	}
+
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * mmaptest - test mmap, munmap, and msync.
+ *
+ * First maps anonymous memory and checks that it starts out zero,
+ * holds what is written to it, and can be unmapped a piece at a
+ * time. Then writes a file, maps it privately and checks it reads
+ * the same and that writes to the mapping don't reach the file, and
+ * maps it shared and checks that writes do reach the file, after
+ * msync and after munmap. Last, checks that a shared mapping stays
+ * shared with a forked child: the parent sees what the child writes.
+ *
+ * Usage: mmaptest [filename]
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+
+#define PAGESIZE	4096
+#define NPAGES		8
+/* Not a whole number of pages, so the last page is partly file. */
+#define FILESIZE	(5 * PAGESIZE + 123)
+
+static char buf[FILESIZE];
+
+static
+char
+pattern(unsigned pos, unsigned seed)
+{
+	return (char)((pos * 7 + seed) % 251 + 1);
+}
+
+static
+void
+anontest(void)
+{
+	char *p;
+	unsigned i;
+
+	printf("Anonymous mapping...\n");
+
+	p = mmap(NULL, NPAGES * PAGESIZE, PROT_READ|PROT_WRITE,
+		 MAP_PRIVATE|MAP_ANON, -1, 0);
+	if (p == MAP_FAILED) {
+		err(1, "mmap anonymous");
+	}
+	for (i=0; i<NPAGES * PAGESIZE; i++) {
+		if (p[i] != 0) {
+			errx(1, "anonymous page not zero at %u", i);
+		}
+		p[i] = pattern(i, 1);
+	}
+
+	/* Punch a hole in the middle. */
+	if (munmap(p + 2 * PAGESIZE, 3 * PAGESIZE)) {
+		err(1, "munmap middle");
+	}
+	for (i=0; i<NPAGES * PAGESIZE; i++) {
+		if (i >= 2 * PAGESIZE && i < 5 * PAGESIZE) {
+			continue;
+		}
+		if (p[i] != pattern(i, 1)) {
+			errx(1, "anonymous page changed at %u after munmap",
+			     i);
+		}
+	}
+
+	/* Unmapping what isn't mapped any more should fail. */
+	if (munmap(p, NPAGES * PAGESIZE) == 0) {
+		errx(1, "munmap across a hole succeeded");
+	}
+	if (errno != EINVAL) {
+		err(1, "munmap across a hole: wrong error");
+	}
+
+	if (munmap(p, 2 * PAGESIZE) || munmap(p + 5 * PAGESIZE,
+					     (NPAGES - 5) * PAGESIZE)) {
+		err(1, "munmap");
+	}
+	printf("Passed.\n");
+}
+
+static
+void
+writefile(const char *file)
+{
+	int fd;
+	unsigned i;
+
+	for (i=0; i<FILESIZE; i++) {
+		buf[i] = pattern(i, 2);
+	}
+	fd = open(file, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s: open for write", file);
+	}
+	if (write(fd, buf, FILESIZE) != FILESIZE) {
+		err(1, "%s: write", file);
+	}
+	close(fd);
+}
+
+/*
+ * Read the file back and check byte I is PATTERN(I, SEED), except
+ * for [CHGSTART, CHGEND), which should be PATTERN(I, CHGSEED).
+ */
+static
+void
+checkfile(const char *file, unsigned seed,
+	  unsigned chgstart, unsigned chgend, unsigned chgseed)
+{
+	int fd;
+	unsigned i;
+	char want;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s: open for read", file);
+	}
+	if (read(fd, buf, FILESIZE) != FILESIZE) {
+		err(1, "%s: read", file);
+	}
+	close(fd);
+	for (i=0; i<FILESIZE; i++) {
+		want = pattern(i, i >= chgstart && i < chgend ? chgseed : seed);
+		if (buf[i] != want) {
+			errx(1, "%s: wrong data in file at %u", file, i);
+		}
+	}
+}
+
+static
+void
+filetest(const char *file)
+{
+	char *p;
+	unsigned i;
+	int fd;
+
+	printf("Private file mapping...\n");
+	writefile(file);
+	fd = open(file, O_RDWR);
+	if (fd < 0) {
+		err(1, "%s: open", file);
+	}
+	p = mmap(NULL, NPAGES * PAGESIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+		 fd, 0);
+	if (p == MAP_FAILED) {
+		err(1, "%s: mmap private", file);
+	}
+	for (i=0; i<NPAGES * PAGESIZE; i++) {
+		if (p[i] != (i < FILESIZE ? pattern(i, 2) : 0)) {
+			errx(1, "private mapping wrong at %u", i);
+		}
+	}
+	for (i=0; i<FILESIZE; i++) {
+		p[i] = pattern(i, 3);
+	}
+	if (munmap(p, NPAGES * PAGESIZE)) {
+		err(1, "munmap private");
+	}
+	checkfile(file, 2, 0, 0, 0);
+	printf("Passed.\n");
+
+	printf("Shared file mapping...\n");
+	p = mmap(NULL, FILESIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		err(1, "%s: mmap shared", file);
+	}
+	/* Change pages 1 and 2 and sync. */
+	for (i=PAGESIZE; i<3 * PAGESIZE; i++) {
+		p[i] = pattern(i, 4);
+	}
+	if (msync(p, FILESIZE, MS_SYNC)) {
+		err(1, "msync");
+	}
+	checkfile(file, 2, PAGESIZE, 3 * PAGESIZE, 4);
+
+	/* Then change everything and unmap. */
+	for (i=0; i<FILESIZE; i++) {
+		p[i] = pattern(i, 5);
+	}
+	if (munmap(p, FILESIZE)) {
+		err(1, "munmap shared");
+	}
+	checkfile(file, 5, 0, 0, 0);
+	close(fd);
+	printf("Passed.\n");
+}
+
+static
+void
+forktest(const char *file)
+{
+	char *p;
+	unsigned i;
+	int fd, status;
+	pid_t pid;
+
+	printf("Shared file mapping across fork...\n");
+	writefile(file);
+	fd = open(file, O_RDWR);
+	if (fd < 0) {
+		err(1, "%s: open", file);
+	}
+	p = mmap(NULL, FILESIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		err(1, "%s: mmap shared", file);
+	}
+	/* Have every page in core (and one written) before forking. */
+	for (i=0; i<FILESIZE; i++) {
+		if (p[i] != pattern(i, 2)) {
+			errx(1, "shared mapping wrong at %u", i);
+		}
+	}
+	p[0] = pattern(0, 2);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		for (i=0; i<FILESIZE; i++) {
+			p[i] = pattern(i, 6);
+		}
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed");
+	}
+	for (i=0; i<FILESIZE; i++) {
+		if (p[i] != pattern(i, 6)) {
+			errx(1, "child's write not seen at %u", i);
+		}
+	}
+	if (munmap(p, FILESIZE)) {
+		err(1, "munmap shared");
+	}
+	checkfile(file, 6, 0, 0, 0);
+	close(fd);
+	printf("Passed.\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file;
+
+	if (argc > 2) {
+		errx(1, "Usage: mmaptest [filename]");
+	}
+	file = argc == 2 ? argv[1] : "mmaptest.tmp";
+
+	anontest();
+	filetest(file);
+	forktest(file);
+	remove(file);
+	printf("mmaptest done.\n");
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * mutexbench - user-level lock benchmark.
+ *
+ * Compares the futex-based mutex in libc with using a semfs
+ * semaphore as a lock, the way usemtest does: opening "sem:" and
+ * doing a one-byte read for P and a one-byte write for V, which is a
+ * pair of system calls through the VFS for every lock and unlock.
+ *
+ * Each test has some threads take turns incrementing a shared
+ * counter under the lock and checks the total at the end. With one
+ * thread the mutex never enters the kernel at all; with several, it
+ * does only when a thread actually has to wait.
+ *
+ * Usage: mutexbench [-n iterations] [-t maxthreads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <thread.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFAULT_ITERS	10000
+#define MAXTHREADS	8
+#define SEMNAME		"sem:mutexbench"
+
+static struct mutex mx = MUTEX_INITIALIZER;
+static int semfd;
+static volatile unsigned counter;
+static unsigned iters;
+
+static
+void *
+mutexloop(void *arg)
+{
+	unsigned i;
+
+	(void)arg;
+	for (i=0; i<iters; i++) {
+		mutex_lock(&mx);
+		counter++;
+		mutex_unlock(&mx);
+	}
+	return NULL;
+}
+
+static
+void *
+semloop(void *arg)
+{
+	unsigned i;
+	char c = 0;
+
+	(void)arg;
+	for (i=0; i<iters; i++) {
+		if (read(semfd, &c, 1) != 1) {
+			err(1, "%s: P", SEMNAME);
+		}
+		counter++;
+		if (write(semfd, &c, 1) != 1) {
+			err(1, "%s: V", SEMNAME);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Run LOOP in NTHREADS threads, counting the one we started with,
+ * and report the time per lock/unlock pair.
+ */
+static
+void
+run(const char *what, void *(*loop)(void *), unsigned nthreads)
+{
+	int tids[MAXTHREADS];
+	struct benchtime start;
+	char label[64];
+	unsigned t;
+
+	counter = 0;
+	bench_start(&start);
+	for (t = 1; t < nthreads; t++) {
+		if (thread_create(&tids[t], loop, NULL)) {
+			err(1, "thread_create");
+		}
+	}
+	loop(NULL);
+	for (t = 1; t < nthreads; t++) {
+		if (thread_join(tids[t], NULL)) {
+			err(1, "thread_join");
+		}
+	}
+	snprintf(label, sizeof(label), "%s, %u thread%s", what,
+		 nthreads, nthreads == 1 ? "" : "s");
+	bench_report(label, nthreads * iters, bench_usecs(&start));
+
+	if (counter != nthreads * iters) {
+		errx(1, "%s: counter is %u, should be %u", label,
+		     counter, nthreads * iters);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned maxthreads = MAXTHREADS, n;
+	int i;
+	char c = 0;
+
+	iters = DEFAULT_ITERS;
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-t") && i+1 < argc) {
+			maxthreads = atoi(argv[++i]);
+		}
+		else {
+			errx(1, "Usage: mutexbench [-n iterations] "
+			     "[-t maxthreads]");
+		}
+	}
+	if (maxthreads < 1 || maxthreads > MAXTHREADS) {
+		errx(1, "maxthreads must be from 1 to %d", MAXTHREADS);
+	}
+
+	/* A new semaphore starts at 0; V it once to make it a lock. */
+	semfd = open(SEMNAME, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (semfd < 0) {
+		err(1, "%s", SEMNAME);
+	}
+	if (write(semfd, &c, 1) != 1) {
+		err(1, "%s: V", SEMNAME);
+	}
+
+	for (n = 1; n <= maxthreads; n *= 2) {
+		run("mutex", mutexloop, n);
+		run("semfs", semloop, n);
+	}
+
+	close(semfd);
+	remove(SEMNAME);
+	printf("Passed.\n");
+	return 0;
+}
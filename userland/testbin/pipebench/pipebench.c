@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * pipebench - pipe throughput benchmark.
+ *
+ * Times a "cat file | tac" style pipeline: a child copies a file into
+ * a pipe, and the parent reads it all, reverses the order of the
+ * lines, and writes the result to null:. The child copies with read
+ * and write through a small buffer, through a page-sized buffer, and
+ * with splice, which has the file system read straight into the
+ * pipe's buffer. Then the same again with the child writing the pipe
+ * out to a file with splice, as in "cat file | cat > copy".
+ *
+ * Usage: pipebench [-n iterations] [-f filename]
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFAULT_ITERS	5
+#define FILESIZE	(128*1024)
+#define SMALLBUF	128
+#define BIGBUF		4096
+
+static char data[FILESIZE];		/* what comes out of the pipe */
+static char out[FILESIZE];		/* the lines reversed */
+static char buf[BIGBUF];
+
+enum copymode { COPY_SMALL, COPY_BIG, COPY_SPLICE };
+
+/*
+ * Make the input file: FILESIZE bytes of lines of assorted lengths.
+ */
+static
+void
+makefile(const char *filename)
+{
+	unsigned pos, len;
+	int fd;
+
+	for (pos = 0; pos < FILESIZE; pos++) {
+		data[pos] = 'a' + pos % 26;
+	}
+	len = 1;
+	for (pos = 0; pos < FILESIZE; pos += len) {
+		len = len * 7 % 97 + 1;
+		if (pos + len - 1 < FILESIZE) {
+			data[pos + len - 1] = '\n';
+		}
+	}
+	data[FILESIZE - 1] = '\n';
+
+	fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", filename);
+	}
+	if (write(fd, data, FILESIZE) != FILESIZE) {
+		err(1, "%s: write", filename);
+	}
+	close(fd);
+}
+
+/*
+ * The cat half, run in the child: copy file FD to pipe end PFD.
+ */
+static
+void
+cat(int fd, int pfd, enum copymode mode)
+{
+	size_t bufsize = mode == COPY_SMALL ? SMALLBUF : BIGBUF;
+	ssize_t r;
+
+	while (1) {
+		if (mode == COPY_SPLICE) {
+			r = splice(fd, pfd, FILESIZE);
+			if (r < 0) {
+				err(1, "splice");
+			}
+		}
+		else {
+			r = read(fd, buf, bufsize);
+			if (r < 0) {
+				err(1, "read");
+			}
+			if (r > 0 && write(pfd, buf, r) != r) {
+				err(1, "write");
+			}
+		}
+		if (r == 0) {
+			break;
+		}
+	}
+}
+
+/*
+ * The tac half: read everything from pipe end PFD, then write the
+ * lines out in reverse order to OUTFD.
+ */
+static
+void
+tac(int pfd, int outfd)
+{
+	size_t total, pos, end, len;
+	ssize_t r;
+
+	total = 0;
+	while (total < FILESIZE) {
+		r = read(pfd, data + total, FILESIZE - total);
+		if (r < 0) {
+			err(1, "read");
+		}
+		if (r == 0) {
+			break;
+		}
+		total += r;
+	}
+	if (total != FILESIZE) {
+		errx(1, "tac: got %lu bytes, expected %lu",
+		     (unsigned long)total, (unsigned long)FILESIZE);
+	}
+
+	pos = 0;
+	end = total;
+	while (end > 0) {
+		/* find the start of the line that ends at end-1 */
+		len = 1;
+		while (len < end && data[end - len - 1] != '\n') {
+			len++;
+		}
+		memcpy(out + pos, data + end - len, len);
+		pos += len;
+		end -= len;
+	}
+	if (write(outfd, out, pos) != (ssize_t)pos) {
+		err(1, "tac: write");
+	}
+}
+
+/*
+ * The whole pipeline, ITERS times over. If TOFILE is set, the child
+ * is the reader instead, splicing the pipe out to that file.
+ */
+static
+void
+pipeline(const char *label, const char *filename, const char *tofile,
+	 enum copymode mode, unsigned iters)
+{
+	struct benchtime start;
+	unsigned i;
+	int p[2], fd, outfd, status;
+	ssize_t r;
+	pid_t pid;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		if (pipe(p) < 0) {
+			err(1, "pipe");
+		}
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			if (tofile == NULL) {
+				close(p[0]);
+				fd = open(filename, O_RDONLY);
+				if (fd < 0) {
+					err(1, "%s", filename);
+				}
+				cat(fd, p[1], mode);
+			}
+			else {
+				close(p[1]);
+				fd = open(tofile, O_WRONLY|O_CREAT|O_TRUNC,
+					  0664);
+				if (fd < 0) {
+					err(1, "%s", tofile);
+				}
+				do {
+					r = splice(p[0], fd, FILESIZE);
+					if (r < 0) {
+						err(1, "splice");
+					}
+				} while (r > 0);
+			}
+			_exit(0);
+		}
+
+		if (tofile == NULL) {
+			close(p[1]);
+			outfd = open("null:", O_WRONLY);
+			if (outfd < 0) {
+				err(1, "null:");
+			}
+			tac(p[0], outfd);
+			close(outfd);
+			close(p[0]);
+		}
+		else {
+			close(p[0]);
+			fd = open(filename, O_RDONLY);
+			if (fd < 0) {
+				err(1, "%s", filename);
+			}
+			cat(fd, p[1], mode);
+			close(fd);
+			close(p[1]);
+		}
+
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "%s: child failed", label);
+		}
+	}
+	bench_report(label, iters, bench_usecs(&start));
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *filename = "pipebenchfile";
+	const char *copyname = "pipebenchcopy";
+	unsigned iters = DEFAULT_ITERS;
+	int i;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-f") && i+1 < argc) {
+			filename = argv[++i];
+		}
+		else {
+			errx(1, "Usage: pipebench [-n iterations] "
+			     "[-f filename]");
+		}
+	}
+
+	makefile(filename);
+	pipeline("cat|tac, 128-byte read/write", filename, NULL,
+		 COPY_SMALL, iters);
+	pipeline("cat|tac, 4K read/write", filename, NULL,
+		 COPY_BIG, iters);
+	pipeline("cat|tac, splice", filename, NULL,
+		 COPY_SPLICE, iters);
+	pipeline("cat|cat>file, 4K write, splice out", filename, copyname,
+		 COPY_BIG, iters);
+	pipeline("cat|cat>file, splice both ends", filename, copyname,
+		 COPY_SPLICE, iters);
+
+	remove(copyname);
+	remove(filename);
+	return 0;
+}
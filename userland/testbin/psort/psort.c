@@ -39,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -113,6 +114,13 @@ static int numkeys = 128*1024;
 /* Per-process work buffer */
 static int workspace[WORKNUM];
 
+/*
+ * Keys going into each bin, and coming out of each bin when merging,
+ * are buffered BINBUF at a time instead of moved with a system call
+ * apiece.
+ */
+#define BINBUF       256
+
 /* Random seed for generating the data */
 static long randomseed = 15432753;
 
@@ -412,6 +420,70 @@ dowrite(const char *path, int fd, const void *buf, size_t len)
 	}
 }
 
+static
+void
+dopwrite(const char *path, int fd, const void *buf, size_t len, off_t pos)
+{
+	int result;
+
+	result = pwrite(fd, buf, len, pos);
+	if (result < 0) {
+		complain("%s: pwrite", path);
+		exit(1);
+	}
+	if ((size_t) result != len) {
+		complainx("%s: pwrite: short count", path);
+		exit(1);
+	}
+}
+
+static
+size_t
+iovtotal(const struct iovec *iov, int iovcnt)
+{
+	size_t total = 0;
+	int i;
+
+	for (i=0; i<iovcnt; i++) {
+		total += iov[i].iov_len;
+	}
+	return total;
+}
+
+static
+void
+doexactreadv(const char *path, int fd, const struct iovec *iov, int iovcnt)
+{
+	int result;
+
+	result = readv(fd, iov, iovcnt);
+	if (result < 0) {
+		complain("%s: readv", path);
+		exit(1);
+	}
+	if ((size_t) result != iovtotal(iov, iovcnt)) {
+		complainx("%s: readv: short count", path);
+		exit(1);
+	}
+}
+
+static
+void
+dowritev(const char *path, int fd, const struct iovec *iov, int iovcnt)
+{
+	int result;
+
+	result = writev(fd, iov, iovcnt);
+	if (result < 0) {
+		complain("%s: writev", path);
+		exit(1);
+	}
+	if ((size_t) result != iovtotal(iov, iovcnt)) {
+		complainx("%s: writev: short count", path);
+		exit(1);
+	}
+}
+
 static
 void
 dolseek(const char *name, int fd, off_t offset, int whence)
@@ -672,6 +744,7 @@ void
 bin(void)
 {
 	int infd, outfds[numprocs];
+	int binbuf[numprocs][BINBUF], binfill[numprocs];
 	const char *name;
 	int i, mykeys, keys_done, keys_to_do;
 	int key, pivot, binnum;
@@ -684,6 +757,7 @@ bin(void)
 	for (i=0; i<numprocs; i++) {
 		name = binname(me, i);
 		outfds[i] = doopen(name, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+		binfill[i] = 0;
 	}
 
 	pivot = (RANDOM_MAX / numprocs);
@@ -708,7 +782,12 @@ bin(void)
 			}
 			assert(binnum >= 0);
 			assert(binnum < numprocs);
-			dowrite("bin", outfds[binnum], &key, sizeof(key));
+			binbuf[binnum][binfill[binnum]++] = key;
+			if (binfill[binnum] == BINBUF) {
+				dowrite("bin", outfds[binnum], binbuf[binnum],
+					sizeof(binbuf[binnum]));
+				binfill[binnum] = 0;
+			}
 		}
 
 		keys_done += keys_to_do;
@@ -716,6 +795,7 @@ bin(void)
 	doclose(PATH_KEYS, infd);
 
 	for (i=0; i<numprocs; i++) {
+		dowrite("bin", outfds[i], binbuf[i], binfill[i] * sizeof(int));
 		doclose(binname(me, i), outfds[i]);
 	}
 }
@@ -746,8 +826,7 @@ sortbins(void)
 
 		sortints(workspace, binsize/sizeof(int));
 
-		dolseek(name, fd, 0, SEEK_SET);
-		dowrite(name, fd, workspace, binsize);
+		dopwrite(name, fd, workspace, binsize, 0);
 		doclose(name, fd);
 	}
 }
@@ -758,6 +837,7 @@ mergebins(void)
 {
 	int infds[numprocs], outfd;
 	int values[numprocs], ready[numprocs];
+	int inbuf[numprocs][BINBUF], inpos[numprocs], incount[numprocs];
 	const char *name, *outname;
 	int i, result;
 	int numready, place, val, worknum;
@@ -770,6 +850,8 @@ mergebins(void)
 		infds[i] = doopen(name, O_RDONLY, 0);
 		values[i] = 0;
 		ready[i] = 0;
+		inpos[i] = 0;
+		incount[i] = 0;
 	}
 
 	worknum = 0;
@@ -781,20 +863,24 @@ mergebins(void)
 				continue;
 			}
 
-			if (!ready[i]) {
+			if (!ready[i] && inpos[i] == incount[i]) {
 				result = doread("bin", infds[i],
-						&val, sizeof(int));
+						inbuf[i], sizeof(inbuf[i]));
 				if (result == 0) {
 					doclose("bin", infds[i]);
 					infds[i] = -1;
 					continue;
 				}
-				if ((size_t) result != sizeof(int)) {
+				if ((size_t) result % sizeof(int) != 0) {
 					complainx("%s: read: short count",
 						  binname(i, me));
 					exit(1);
 				}
-				values[i] = val;
+				inpos[i] = 0;
+				incount[i] = result / sizeof(int);
+			}
+			if (!ready[i]) {
+				values[i] = inbuf[i][inpos[i]++];
 				ready[i] = 1;
 			}
 			numready++;
@@ -809,12 +895,12 @@ mergebins(void)
 			if (!ready[i]) {
 				continue;
 			}
-			if (place < 0 || values[i] < val) {
-				val = values[i];
+			if (place < 0 || values[i] < values[place]) {
 				place = i;
 			}
 		}
 		assert(place >= 0);
+		val = values[place];
 
 		workspace[worknum++] = val;
 		if (worknum >= WORKNUM) {
@@ -1002,6 +1088,7 @@ dovalidate(void)
 	const char *name;
 	int fd, i, mykeys, keys_done, keys_to_do;
 	int key, smallest, largest;
+	struct iovec iov[2];
 
 	name = PATH_SORTED;
 	fd = doopen(name, O_RDONLY, 0);
@@ -1051,8 +1138,11 @@ dovalidate(void)
 
 	name = validname(me);
 	fd = doopen(name, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-	dowrite(name, fd, &smallest, sizeof(smallest));
-	dowrite(name, fd, &largest, sizeof(largest));
+	iov[0].iov_base = &smallest;
+	iov[0].iov_len = sizeof(smallest);
+	iov[1].iov_base = &largest;
+	iov[1].iov_len = sizeof(largest);
+	dowritev(name, fd, iov, 2);
 	doclose(name, fd);
 }
 
@@ -1063,6 +1153,7 @@ validate(void)
 	int smallest, largest, prev_largest;
 	int i, fd;
 	const char *name;
+	struct iovec iov[2];
 
 	complainx("Validating the sorted data using %d procs", numprocs);
 	doforkall("Validation", dovalidate);
@@ -1074,8 +1165,11 @@ validate(void)
 		name = validname(i);
 		fd = doopen(name, O_RDONLY, 0);
 
-		doexactread(name, fd, &smallest, sizeof(int));
-		doexactread(name, fd, &largest, sizeof(int));
+		iov[0].iov_base = &smallest;
+		iov[0].iov_len = sizeof(smallest);
+		iov[1].iov_base = &largest;
+		iov[1].iov_len = sizeof(largest);
+		doexactreadv(name, fd, iov, 2);
 
 		if (smallest < 1) {
 			complainx("Validation: block %d: bad SMALLEST", i);
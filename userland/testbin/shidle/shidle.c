@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * shidle - how much CPU an idle shell takes.
+ *
+ * getrusage doesn't keep CPU times, so this measures it the other
+ * way around: it counts how many times it can go around an empty
+ * loop in a few seconds, first on its own, then with a shell sitting
+ * at its prompt, and then with the shell sitting at its prompt while
+ * it has a background job. The background job is this program again,
+ * just sleeping in poll. Whatever the shell burns comes out of the
+ * loop count. (Run it on one CPU; otherwise the shell gets a CPU of
+ * its own and the count doesn't show it.)
+ *
+ * The shell reads commands from a pipe and writes to null:.
+ *
+ * Usage: shidle [-s seconds]
+ *    (shidle -z msecs is the background job; it sleeps and exits.)
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define PROG		"/testbin/shidle"
+#define SHELL		"/bin/sh"
+#define DEFAULT_SECS	10
+#define CHECKEVERY	10000		/* loop iterations per clock check */
+
+/*
+ * Go around the loop for SECS seconds and return how many times.
+ */
+static
+unsigned long
+spin(unsigned secs)
+{
+	struct benchtime start;
+	volatile unsigned long count;
+	unsigned long limit;
+	unsigned i;
+
+	limit = secs * 1000000UL;
+	count = 0;
+	bench_start(&start);
+	do {
+		for (i=0; i<CHECKEVERY; i++) {
+			count++;
+		}
+	} while (bench_usecs(&start) < limit);
+	return count;
+}
+
+/*
+ * Start a shell reading from a pipe; return the write end in *cmdfd.
+ */
+static
+pid_t
+startshell(int *cmdfd)
+{
+	char *args[2];
+	int fds[2], nullfd;
+	pid_t pid;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		nullfd = open("null:", O_WRONLY);
+		if (nullfd < 0) {
+			err(1, "null:");
+		}
+		if (dup2(fds[0], STDIN_FILENO) < 0 ||
+		    dup2(nullfd, STDOUT_FILENO) < 0 ||
+		    dup2(nullfd, STDERR_FILENO) < 0) {
+			_exit(255);
+		}
+		close(fds[0]);
+		close(fds[1]);
+		close(nullfd);
+		args[0] = (char *)"sh";
+		args[1] = NULL;
+		execv(SHELL, args);
+		_exit(255);
+	}
+	close(fds[0]);
+	*cmdfd = fds[1];
+	return pid;
+}
+
+static
+void
+sendcmd(int cmdfd, const char *cmd)
+{
+	size_t len;
+
+	len = strlen(cmd);
+	if (write(cmdfd, cmd, len) != (ssize_t)len) {
+		err(1, "write to shell");
+	}
+}
+
+/*
+ * Spin with a shell idle at its prompt, with or without a background
+ * job that outlasts the spin.
+ */
+static
+unsigned long
+spinwithshell(unsigned secs, int withjob)
+{
+	char cmd[64];
+	unsigned long count;
+	int cmdfd, status;
+	pid_t pid;
+
+	pid = startshell(&cmdfd);
+	if (withjob) {
+		snprintf(cmd, sizeof(cmd), "%s -z %u &\n", PROG,
+			 (secs + 2) * 1000);
+		sendcmd(cmdfd, cmd);
+	}
+	/* give the shell (and the job) time to start and settle */
+	poll(NULL, 0, 1000);
+
+	count = spin(secs);
+
+	sendcmd(cmdfd, "wait\nexit\n");
+	close(cmdfd);
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "shell failed");
+	}
+	return count;
+}
+
+static
+void
+report(const char *label, unsigned long count, unsigned long base)
+{
+	printf("%-32s %10lu loops  %3lu%% of alone\n", label, count,
+	       base ? (unsigned long)(count * 100ULL / base) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned secs = DEFAULT_SECS;
+	unsigned long alone, idle, withjob;
+	int i;
+
+	if (argc == 3 && !strcmp(argv[1], "-z")) {
+		poll(NULL, 0, atoi(argv[2]));
+		return 0;
+	}
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-s") && i+1 < argc) {
+			secs = atoi(argv[++i]);
+		}
+		else {
+			errx(1, "Usage: shidle [-s seconds]");
+		}
+	}
+
+	alone = spin(secs);
+	idle = spinwithshell(secs, 0);
+	withjob = spinwithshell(secs, 1);
+
+	report("alone", alone, alone);
+	report("shell at the prompt", idle, alone);
+	report("shell with a background job", withjob, alone);
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * spawnbench - command launch benchmark.
+ *
+ * Times starting a trivial program and waiting for it, the way sh
+ * runs a command, with fork and with vfork, first from a small parent
+ * and then after touching every page of a 2M array. fork has to copy
+ * the parent's memory (or with copy-on-write, at least map it) only
+ * for exec to throw the copy away; vfork lends the child the parent's
+ * address space until it execs, so it should cost the same either
+ * way.
+ *
+ * Usage: spawnbench [-n iterations] [program]
+ *    The program defaults to /bin/true.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define PAGESIZE	4096
+#define BIGPAGES	512		/* 2M */
+#define DEFAULT_ITERS	50
+
+static char big[BIGPAGES * PAGESIZE];
+
+static
+void
+touchbig(void)
+{
+	unsigned i;
+
+	for (i=0; i<BIGPAGES; i++) {
+		big[i * PAGESIZE] = 1;
+	}
+}
+
+static
+void
+spawnloop(const char *label, int usevfork, unsigned iters, char **args)
+{
+	struct benchtime start;
+	volatile unsigned i;	/* live across vfork */
+	pid_t pid;
+	int status;
+
+	bench_start(&start);
+	for (i=0; i<iters; i++) {
+		pid = usevfork ? vfork() : fork();
+		if (pid < 0) {
+			err(1, "%s", usevfork ? "vfork" : "fork");
+		}
+		if (pid == 0) {
+			execv(args[0], args);
+			_exit(255);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "%s failed", args[0]);
+		}
+	}
+	bench_report(label, iters, bench_usecs(&start));
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS;
+	char *args[2];
+	int i;
+
+	args[0] = (char *)"/bin/true";
+	args[1] = NULL;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else if (argv[i][0] != '-') {
+			args[0] = argv[i];
+		}
+		else {
+			errx(1, "Usage: spawnbench [-n iterations] [program]");
+		}
+	}
+
+	spawnloop("fork+exec, small parent", 0, iters, args);
+	spawnloop("vfork+exec, small parent", 1, iters, args);
+	touchbig();
+	spawnloop("fork+exec, 2M parent", 0, iters, args);
+	spawnloop("vfork+exec, 2M parent", 1, iters, args);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * switchbench - context switch TLB benchmark.
+ *
+ * Runs several processes at once, each repeatedly sweeping a small
+ * array, so they are switched between by the timer all the time.
+ * The arrays together fit in the TLB; if it survives context
+ * switches (because entries are tagged with address space IDs)
+ * each process only takes TLB misses when it first touches its
+ * pages, and otherwise after every switch.
+ *
+ * Compare the "vm" kernel menu command's TLB miss counts before
+ * and after a run.
+ *
+ * Usage: switchbench [-p procs] [-n sweeps] [-s pages]
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define PAGESIZE	4096
+#define MAXPAGES	32
+#define MAXPROCS	8
+#define DEFAULT_PROCS	2
+#define DEFAULT_SWEEPS	20000
+#define DEFAULT_PAGES	12
+
+static volatile char pages[MAXPAGES * PAGESIZE];
+
+static
+void
+sweep(unsigned npages, unsigned nsweeps)
+{
+	unsigned i, j;
+
+	for (i=0; i<nsweeps; i++) {
+		for (j=0; j<npages; j++) {
+			pages[j * PAGESIZE]++;
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned nprocs = DEFAULT_PROCS;
+	unsigned nsweeps = DEFAULT_SWEEPS;
+	unsigned npages = DEFAULT_PAGES;
+	struct benchtime start;
+	pid_t pids[MAXPROCS];
+	int i, status, failed = 0;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-p") && i+1 < argc) {
+			nprocs = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			nsweeps = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-s") && i+1 < argc) {
+			npages = atoi(argv[++i]);
+		}
+		else {
+			errx(1, "Usage: switchbench [-p procs] [-n sweeps] "
+			     "[-s pages]");
+		}
+	}
+	if (nprocs < 1 || nprocs > MAXPROCS) {
+		errx(1, "Between 1 and %d processes, please", MAXPROCS);
+	}
+	if (npages < 1 || npages > MAXPAGES) {
+		errx(1, "Between 1 and %d pages, please", MAXPAGES);
+	}
+
+	bench_start(&start);
+	for (i=0; i<(int)nprocs; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			sweep(npages, nsweeps);
+			_exit(0);
+		}
+	}
+	for (i=0; i<(int)nprocs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			warnx("child %d failed", pids[i]);
+			failed = 1;
+		}
+	}
+	bench_report("sweep", nprocs * nsweeps, bench_usecs(&start));
+	return failed;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * threadmat - matmult split across threads.
+ *
+ * Multiplies the same matrices as matmult, with the rows of the
+ * result divided evenly among 1, 2, 4, and 8 threads, and reports
+ * how long each takes. On a multiprocessor the time should fall as
+ * threads are added until there's one per CPU. The answer is checked
+ * every time.
+ *
+ * Usage: threadmat [-n iterations] [-t maxthreads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define Dim		72
+#define RIGHT		8772192		/* correct answer (see matmult) */
+#define DEFAULT_ITERS	5
+#define MAXTHREADS	8
+
+static int A[Dim][Dim];
+static int B[Dim][Dim];
+static int C[Dim][Dim];
+
+struct work {
+	unsigned w_first;	/* first row of C */
+	unsigned w_last;	/* one past the last */
+};
+
+static
+void *
+multiply(void *data)
+{
+	const struct work *w = data;
+	unsigned i, j, k;
+	int sum;
+
+	for (i = w->w_first; i < w->w_last; i++) {
+		for (j = 0; j < Dim; j++) {
+			sum = 0;
+			for (k = 0; k < Dim; k++) {
+				sum += A[i][k] * B[k][j];
+			}
+			C[i][j] = sum;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Multiply ITERS times with NTHREADS threads, including the one we
+ * started with, and check the result.
+ */
+static
+void
+run(unsigned nthreads, unsigned iters)
+{
+	struct work work[MAXTHREADS];
+	int tids[MAXTHREADS];
+	struct benchtime start;
+	char label[64];
+	unsigned i, t;
+	int r;
+
+	bench_start(&start);
+	for (i = 0; i < iters; i++) {
+		for (t = 0; t < nthreads; t++) {
+			work[t].w_first = Dim * t / nthreads;
+			work[t].w_last = Dim * (t + 1) / nthreads;
+		}
+		for (t = 1; t < nthreads; t++) {
+			if (thread_create(&tids[t], multiply, &work[t])) {
+				err(1, "thread_create");
+			}
+		}
+		multiply(&work[0]);
+		for (t = 1; t < nthreads; t++) {
+			if (thread_join(tids[t], NULL)) {
+				err(1, "thread_join");
+			}
+		}
+
+		r = 0;
+		for (t = 0; t < Dim; t++) {
+			r += C[t][t];
+		}
+		if (r != RIGHT) {
+			errx(1, "%u threads: answer is %d (should be %d)",
+			     nthreads, r, RIGHT);
+		}
+		memset(C, 0, sizeof(C));
+	}
+	snprintf(label, sizeof(label), "matmult, %u thread%s",
+		 nthreads, nthreads == 1 ? "" : "s");
+	bench_report(label, iters, bench_usecs(&start));
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS, maxthreads = MAXTHREADS, n;
+	int i, j;
+
+	for (i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			iters = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-t") && i+1 < argc) {
+			maxthreads = atoi(argv[++i]);
+		}
+		else {
+			errx(1, "Usage: threadmat [-n iterations] "
+			     "[-t maxthreads]");
+		}
+	}
+	if (maxthreads < 1 || maxthreads > MAXTHREADS) {
+		errx(1, "maxthreads must be from 1 to %d", MAXTHREADS);
+	}
+
+	for (i = 0; i < Dim; i++) {
+		for (j = 0; j < Dim; j++) {
+			A[i][j] = i;
+			B[i][j] = j;
+		}
+	}
+
+	for (n = 1; n <= maxthreads; n *= 2) {
+		run(n, iters);
+	}
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * xfer - time large reads and writes.
+ *
+ * Usage: xfer [filename [size]]
+ *
+ * Writes a file of SIZE bytes (default 1M) and reads it back, in
+ * chunks of various sizes, with the buffer page-aligned and not, and
+ * prints the rate for each. The data is checked on the way back in.
+ * Big aligned chunks are where copyin/copyout's page-at-a-time path
+ * should show; the 512-byte runs are for comparison.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#define XFER_PAGESIZE	4096
+
+static const struct {
+	size_t chunk;
+	size_t misalign;
+} runs[] = {
+	{ 512, 0 },
+	{ 4096, 0 },
+	{ 4096, 1 },
+	{ 65536, 0 },
+	{ 65536, 3 },
+	{ 0, 0 },		/* whole file at once */
+};
+
+static
+unsigned long
+elapsed_ms(time_t secs1, unsigned long nsecs1,
+	   time_t secs2, unsigned long nsecs2)
+{
+	if (nsecs2 < nsecs1) {
+		nsecs2 += 1000000000;
+		secs2--;
+	}
+	return (secs2 - secs1) * 1000 + (nsecs2 - nsecs1) / 1000000;
+}
+
+static
+unsigned long
+rate_kbs(size_t bytes, unsigned long ms)
+{
+	if (ms == 0) {
+		ms = 1;
+	}
+	return (bytes / 1024) * 1000 / ms;
+}
+
+static
+unsigned long
+dopass(const char *filename, char *buf, size_t size, size_t chunk,
+       int rw)
+{
+	time_t secs1, secs2;
+	unsigned long nsecs1, nsecs2;
+	size_t pos, n;
+	ssize_t len;
+	int fd;
+
+	if (rw == O_WRONLY) {
+		fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	}
+	else {
+		fd = open(filename, O_RDONLY);
+	}
+	if (fd < 0) {
+		err(1, "%s", filename);
+	}
+
+	__time(&secs1, &nsecs1);
+	for (pos = 0; pos < size; pos += len) {
+		n = size - pos < chunk ? size - pos : chunk;
+		if (rw == O_WRONLY) {
+			len = write(fd, buf + pos, n);
+		}
+		else {
+			len = read(fd, buf + pos, n);
+		}
+		if (len < 0) {
+			err(1, "%s: %s", filename,
+			    rw == O_WRONLY ? "write" : "read");
+		}
+		if (len == 0) {
+			errx(1, "%s: Unexpected EOF at %lu", filename,
+			     (unsigned long)pos);
+		}
+	}
+	__time(&secs2, &nsecs2);
+
+	close(fd);
+	return elapsed_ms(secs1, nsecs1, secs2, nsecs2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *filename = "xferfile";
+	size_t size = 1024*1024;
+	char *space, *buf;
+	size_t chunk, i;
+	unsigned r;
+	unsigned long wms, rms;
+
+	if (argc > 1) {
+		filename = argv[1];
+	}
+	if (argc > 2) {
+		size = atoi(argv[2]);
+	}
+	if (argc > 3 || size == 0) {
+		errx(1, "Usage: xfer [filename [size]]");
+	}
+
+	space = malloc(size + 2*XFER_PAGESIZE);
+	if (space == NULL) {
+		errx(1, "malloc of %lu bytes failed", (unsigned long)size);
+	}
+
+	for (r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+		chunk = runs[r].chunk != 0 ? runs[r].chunk : size;
+		buf = (char *)(((uintptr_t)space + XFER_PAGESIZE - 1)
+			       & ~(uintptr_t)(XFER_PAGESIZE - 1));
+		buf += runs[r].misalign;
+
+		for (i = 0; i < size; i++) {
+			buf[i] = (char)(i * 7 + r);
+		}
+		wms = dopass(filename, buf, size, chunk, O_WRONLY);
+
+		memset(buf, 0, size);
+		rms = dopass(filename, buf, size, chunk, O_RDONLY);
+
+		for (i = 0; i < size; i++) {
+			if (buf[i] != (char)(i * 7 + r)) {
+				errx(1, "%s: Wrong data at offset %lu "
+				     "(chunk %lu)", filename,
+				     (unsigned long)i, (unsigned long)chunk);
+			}
+		}
+
+		printf("chunk %7lu align %lu: write %6lu KB/s, "
+		       "read %6lu KB/s\n",
+		       (unsigned long)chunk, (unsigned long)runs[r].misalign,
+		       rate_kbs(size, wms), rate_kbs(size, rms));
+	}
+
+	remove(filename);
+	free(space);
+	printf("xfer: Complete.\n");
+	return 0;
+}